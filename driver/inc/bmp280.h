@@ -51,6 +51,19 @@
 #define BMP280_ADRESS_T3_COMP_LSB 0X8C
 #define BMP280_ADRESS_T3_COMP_MSB 0X8D
 
+/*Bloques que se leen en una sola transacción, el sensor incrementa la dirección*/
+#define BMP280_ADRESS_CALIB_START BMP280_ADRESS_T1_COMP_LSB
+#define BMP280_CALIB_SIZE 24 /*dig_T1..dig_T3 y dig_P1..dig_P9, 0x88 a 0x9F*/
+#define BMP280_ADRESS_DATA_START BMP280_ADRESS_PRESS_MSB
+#define BMP280_DATA_SIZE 6 /*press_msb..press_xlsb y temp_msb..temp_xlsb, 0xF7 a 0xFC*/
+
+#define BMP280_STATUS_MEASURING 0x08 /*Hay una conversión en curso*/
+#define BMP280_STATUS_IM_UPDATE 0x01 /*Se está copiando la calibración de la NVM*/
+
+#define BMP280_STARTUP_US 2000 /*Arranque típico tras el soft reset, antes no responde*/
+#define BMP280_STARTUP_TIMEOUT_US 10000 /*Espera máxima tras el soft reset (el arranque típico es 2 ms)*/
+#define BMP280_POLL_US 200 /*Intervalo entre lecturas del registro status*/
+
 #define BMP280_CHIP_ID 0x58
 #define BMP280_RESET_VALUE 0xB6
 
@@ -133,15 +146,28 @@ typedef uint32_t bmp280_humidity;
 int bmp280_get_temperature(int *temperature);
 
 /**
- * @brief Función para inicializar el BMP280
+ * @brief Función para inicializar el BMP280, se llama una vez en el probe
  *          - Realiza un soft reset
- *          - 
+ *          - Lee la calibración
+ *          - Configura el filtro IIR y el tiempo de standby
+ *        El chip queda en modo sleep hasta bmp280_start
  * @return int 
  */
 int bmp280_init(void);
 
 /**
- * @brief Función para poner al BMP280 en modo sleep
+ * @brief Función para pasar el BMP280 a modo normal, mide continuamente
+ * @return int 0 si no hubo error
+ */
+int bmp280_start(void);
+
+/**
+ * @brief Función para poner al BMP280 en modo sleep, conserva la calibración
+ */
+void bmp280_stop(void);
+
+/**
+ * @brief Función para poner al BMP280 en modo sleep y olvidar la calibración, al remover el driver
  */
 void bmp280_deinit(void);
 
@@ -170,6 +196,15 @@ int bmp280_ctrl_meas(bmp280_mode_t mode, bmp280_oversampling_t orst_t, bmp280_ov
  */
 int bmp280_config( bmp280_standby_duration_t t_sb, bmp280_filter_coefficient_t filter);
 
+/**
+ * @brief Espera a que se limpien bits del registro status
+ * 
+ * @param mask BMP280_STATUS_MEASURING y/o BMP280_STATUS_IM_UPDATE
+ * @param timeout_us Espera máxima
+ * @return int 0 si se limpiaron, -ETIMEDOUT si no
+ */
+int bmp280_wait_status(uint8_t mask, unsigned int timeout_us);
+
 /**
  * @brief Realiza un soft reset del BMP280
  * @return int 1 si hubo un error, 0 si no
@@ -21,12 +21,43 @@
 #include <linux/string.h>
 #include <linux/slab.h>
 #include <linux/ioctl.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+#include <linux/list.h>
+#include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #define MINOR_NUMBER 0
 #define NUMBER_OF_DEVICES 1
 #define DEVICE_CLASS_NAME "temp"
 #define DEVICE_NAME "bmp280_sitara"
 
+#define BMP280_SAMPLING_PERIOD_MS 100 /*Período del muestreo por defecto, parámetro sampling_period_ms*/
+#define BMP280_SAMPLING_PERIOD_MIN_MS 14 /*ODR del chip como lo configura bmp280_start, más rápido se repiten muestras*/
+#define BMP280_FIFO_DEPTH 64 /*Muestras que puede atrasarse un lector sin perder ninguna, potencia de 2 (kfifo)*/
+#define BMP280_READ_CHUNK 16 /*Muestras que se sacan de la cola por vez en el read, van en el stack*/
+#define BMP280_LINE_MAX 33 /*Línea "tiempo_ns temperatura\n" más larga con su '\0', el read pide al menos esto*/
+
+/**
+ * @brief Una muestra del sampler
+ */
+struct bmp280_sample
+{
+    s64 time_ns;        /*CLOCK_MONOTONIC al empezar la lectura, la misma base que clock_gettime en userspace*/
+    int temperature;    /*Centésimas de °C*/
+};
+
+/**
+ * @brief Estado de cada archivo abierto: su propia cola, así un lector no le saca muestras a otro
+ */
+struct bmp280_reader
+{
+    struct list_head list;
+    DECLARE_KFIFO(samples, struct bmp280_sample, BMP280_FIFO_DEPTH);
+};
+
 int char_device_create_bmp280(void);
 void char_device_remove(void);
 
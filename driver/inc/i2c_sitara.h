@@ -80,6 +80,13 @@
 
 #define I2C_SITARA_BUF_RXFIFO_CLR 0x1<<14
 #define I2C_SITARA_BUF_TXFIFO_CLR 0x1<<6
+#define I2C_SITARA_BUF_RXTRSH_SHIFT 8 /*Umbral de la FIFO de recepción menos uno, bits 13:8*/
+
+#define I2C_SITARA_BUFSTAT_RXSTAT_SHIFT 8 /*Bytes en la FIFO de recepción, bits 13:8*/
+#define I2C_SITARA_BUFSTAT_RXSTAT_MASK 0x3F
+
+#define I2C_SITARA_FIFO_SIZE 32 /*Profundidad de las FIFO del módulo I2C del AM335x*/
+#define I2C_SITARA_BLOCK_MAX I2C_SITARA_FIFO_SIZE /*Bytes como máximo de una lectura en bloque*/
 
 #define I2C_SITARA_SYSC_SRST 0x2
 
@@ -106,6 +113,7 @@
 #define I2C_SITARA_PSC 0xB0
 #define I2C_SITARA_SCLL 0xB4
 #define I2C_SITARA_SCLH 0xB8
+#define I2C_SITARA_BUFSTAT 0xC0
 
 /*Funciones principales*/
 
@@ -134,6 +142,21 @@ int i2c_sitara_exit(void);
  */
 int i2c_sitara_read(const uint8_t slave_address, const uint8_t slave_register, uint8_t *data);
 
+/**
+ * @brief Lee registros consecutivos de un esclavo I2C en una sola transacción
+ * 
+ * Envía la dirección del primer registro y, con un start repetido, lee len
+ * bytes que el esclavo entrega incrementando la dirección (BMP280). Los bytes
+ * se juntan en la FIFO de recepción y se leen con una sola interrupción.
+ * 
+ * @param slave_address 
+ * @param start_register Dirección del primer registro
+ * @param data Destino de los len bytes, data[0] es start_register
+ * @param len Desde 1 hasta I2C_SITARA_BLOCK_MAX
+ * @return int 0 si se leyó, negativo si hubo un error
+ */
+int i2c_sitara_read_block(const uint8_t slave_address, const uint8_t start_register, uint8_t *data, const size_t len);
+
 /**
  * @brief Escribe un registro de un esclavo I2C
  * 
@@ -16,21 +16,27 @@
 #include "bmp280_cdevice.h"
 #include "utils.h"
 
-#define READ_DELAY 5
+#include <linux/ktime.h>
+
 /* Static variables */
 
 static unsigned short dig_T1=0;
 static short dig_T2=0;
 static short dig_T3=0;
 
+/// @brief Duración máxima de una conversión con el oversampling configurado
+static unsigned int measure_time_us = 0;
+
+/// @brief Momento en que termina la primera conversión en modo normal, antes los registros tienen el valor de reset
+static ktime_t first_measure_ready;
+
 /*Funciónes del módulo*/
 
 /* Functions */
 
 int bmp280_init(void)
 {
-    uint8_t aux1 = 0;
-    uint8_t aux2 = 0;
+    uint8_t calib[BMP280_CALIB_SIZE];
 
     printk(KERN_INFO "bmp280_init: Inicializando el BMP280\n");
 
@@ -46,45 +52,66 @@ int bmp280_init(void)
         return -1;
     }
     
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T1_COMP_MSB, &aux1);
-
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T1_COMP_LSB, &aux2);
+    // La calibración se puede leer cuando el chip terminó de copiarla de la NVM
+    usleep_range(BMP280_STARTUP_US, BMP280_STARTUP_US + BMP280_POLL_US);
+    if(bmp280_wait_status(BMP280_STATUS_IM_UPDATE, BMP280_STARTUP_TIMEOUT_US) != 0)
+    {
+        printk(KERN_ERR "bmp280_init: El BMP280 no terminó de arrancar\n");
+        return -1;
+    }
 
-    dig_T1 = ((unsigned short)aux1 << 8) | (unsigned short)aux2;
+    // Toda la calibración en una sola lectura, cada palabra es little endian
+    if(i2c_sitara_read_block(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_CALIB_START, calib, BMP280_CALIB_SIZE) != 0)
+    {
+        printk(KERN_ERR "bmp280_init: Error al leer la calibración\n");
+        return -1;
+    }
 
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T2_COMP_MSB, &aux1);
+    dig_T1 = ((unsigned short)calib[1] << 8) | (unsigned short)calib[0];
+    dig_T2 = (short)(((unsigned short)calib[3] << 8) | (unsigned short)calib[2]);
+    dig_T3 = (short)(((unsigned short)calib[5] << 8) | (unsigned short)calib[4]);
 
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T2_COMP_LSB, &aux2);
+    // Tras el reset queda en modo sleep, config se escribe antes de pasar a modo normal
+    if(bmp280_config(BMP280_STANDBY_TIME_1_MS, BMP280_FILTER_COEFF_16) != 0)
+    {
+        printk(KERN_ERR "bmp280_init: Error al configurar el BMP280\n");
+        return -1;
+    }
 
-    dig_T2 = ((short)aux1 << 8) | (unsigned short)aux2;
+    printk(KERN_INFO "bmp280_init: dig_T1 = %u\n", dig_T1);
+    printk(KERN_INFO "bmp280_init: dig_T2 = %i\n", dig_T2);
+    printk(KERN_INFO "bmp280_init: dig_T3 = %i\n", dig_T3);
 
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T3_COMP_MSB, &aux1);
+    printk(KERN_INFO "bmp280_init: BMP280 configurado correctamente\n");
+    return 0;
 
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_T3_COMP_LSB, &aux2);
+}
 
-    dig_T3 = ((short)aux1 << 8) | (unsigned short)aux2;
+int bmp280_start(void)
+{
+    if(bmp280_ctrl_meas(BMP280_NORMAL_MODE, BMP280_OVERSAMPLING_1X, BMP280_OVERSAMPLING_4X) != 0)
+    {
+        printk(KERN_ERR "bmp280_start: Error al pasar a modo normal\n");
+        return -1;
+    }
 
-    bmp280_ctrl_meas(BMP280_NORMAL_MODE, BMP280_OVERSAMPLING_1X, BMP280_OVERSAMPLING_4X);
-    bmp280_config(BMP280_STANDBY_TIME_1_MS, BMP280_FILTER_COEFF_16);
+    first_measure_ready = ktime_add_us(ktime_get(), measure_time_us);
 
-    printk(KERN_INFO "bmp280_init: dig_T1 = %u\n", dig_T1);
-    printk(KERN_INFO "bmp280_init: dig_T2 = %i\n", dig_T2);
-    printk(KERN_INFO "bmp280_init: dig_T3 = %i\n", dig_T3);
+    printk(KERN_INFO "bmp280_start: BMP280 en modo normal\n");
 
-    printk(KERN_INFO "bmp280_init: BMP280 configurado correctamente\n");
     return 0;
+}
 
+void bmp280_stop(void)
+{
+    bmp280_ctrl_meas(BMP280_SLEEP_MODE, BMP280_OVERSAMPLING_1X, BMP280_OVERSAMPLING_1X);
+
+    printk(KERN_INFO "bmp280_stop: BMP280 en modo sleep\n");
 }
 
 void bmp280_deinit(void)
 {
-    bmp280_ctrl_meas(BMP280_SLEEP_MODE, BMP280_OVERSAMPLING_1X, BMP280_OVERSAMPLING_1X);
+    bmp280_stop();
     
     dig_T1 = 0;
     dig_T2 = 0;
@@ -131,6 +158,17 @@ int bmp280_ctrl_meas(bmp280_mode_t mode, bmp280_oversampling_t orst_t, bmp280_ov
         return -1;
     }
 
+    // Datasheet 3.8.1: t_measure,max = 1.25 + 2.3 * osrs_t + (2.3 * osrs_p + 0.575) ms
+    measure_time_us = 1250;
+    if(orst_t != BMP280_NO_OVERSAMPLING)
+    {
+        measure_time_us += 2300 * (1 << (orst_t - 1));
+    }
+    if(orst_p != BMP280_NO_OVERSAMPLING)
+    {
+        measure_time_us += 2300 * (1 << (orst_p - 1)) + 575;
+    }
+
     return 0;
 }
 
@@ -158,12 +196,14 @@ int bmp280_config( bmp280_standby_duration_t t_sb, bmp280_filter_coefficient_t f
 
 int bmp280_get_temperature(int *temperature)
 {
-    int8_t temp_msb;
+    uint8_t data[BMP280_DATA_SIZE];
+    uint8_t temp_msb;
     uint8_t temp_lsb;
     uint8_t temp_xlsb;
     int32_t raw_temp;
     int32_t var1, var2;
     int32_t t_fine;
+    s64 wait_us;
 
     if(temperature == NULL)
     {
@@ -172,13 +212,25 @@ int bmp280_get_temperature(int *temperature)
         return -1;
     }
 
-    // Read temp_msb, temp_lsb and temp_xlsb
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_TEMP_MSB, &temp_msb);
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_TEMP_LSB, &temp_lsb);
-    msleep(READ_DELAY);
-    i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_TEMP_XLSB, &temp_xlsb);
+    // En modo normal los registros de datos siempre tienen la última conversión completa:
+    // solo hay que esperar si todavía no terminó la primera
+    wait_us = ktime_us_delta(first_measure_ready, ktime_get());
+    if(wait_us > 0)
+    {
+        usleep_range(wait_us, wait_us + BMP280_POLL_US);
+    }
+
+    // Presión y temperatura en una sola lectura, los seis bytes son de la misma conversión
+    if(i2c_sitara_read_block(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_DATA_START, data, BMP280_DATA_SIZE) != 0)
+    {
+        printk(KERN_ERR "bmp280_get_temperature: Error al leer los datos\n");
+
+        return -1;
+    }
+
+    temp_msb = data[BMP280_ADRESS_TEMP_MSB - BMP280_ADRESS_DATA_START];
+    temp_lsb = data[BMP280_ADRESS_TEMP_LSB - BMP280_ADRESS_DATA_START];
+    temp_xlsb = data[BMP280_ADRESS_TEMP_XLSB - BMP280_ADRESS_DATA_START];
 
     // Convert the data to 20-bits
 
@@ -192,15 +244,15 @@ int bmp280_get_temperature(int *temperature)
 
     *temperature = ((t_fine * 5 + 128) >> 8);
 
-    //print all the values
-    printk(KERN_INFO "bmp280_get_temperature: raw_temp = %d\n", raw_temp);
-    printk(KERN_INFO "bmp280_get_temperature: var1 = %d\n", var1);
-    printk(KERN_INFO "bmp280_get_temperature: var2 = %d\n", var2);
-    printk(KERN_INFO "bmp280_get_temperature: t_fine = %d\n", t_fine);
-    printk(KERN_INFO "bmp280_get_temperature: temperature = %d\n", *temperature);
-    printk(KERN_INFO "bmp280_get_temperature: temp_msb = %d\n", temp_msb);
-    printk(KERN_INFO "bmp280_get_temperature: temp_lsb = %d\n", temp_lsb);
-    printk(KERN_INFO "bmp280_get_temperature: temp_xlsb = %d\n", temp_xlsb);
+    //print all the values (solo con dynamic debug: por consola cada línea tarda más que la lectura)
+    pr_debug("bmp280_get_temperature: raw_temp = %d\n", raw_temp);
+    pr_debug("bmp280_get_temperature: var1 = %d\n", var1);
+    pr_debug("bmp280_get_temperature: var2 = %d\n", var2);
+    pr_debug("bmp280_get_temperature: t_fine = %d\n", t_fine);
+    pr_debug("bmp280_get_temperature: temperature = %d\n", *temperature);
+    pr_debug("bmp280_get_temperature: temp_msb = %d\n", temp_msb);
+    pr_debug("bmp280_get_temperature: temp_lsb = %d\n", temp_lsb);
+    pr_debug("bmp280_get_temperature: temp_xlsb = %d\n", temp_xlsb);
 
     return 0;
 }
@@ -214,4 +266,27 @@ int bmp280_soft_reset(void)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int bmp280_wait_status(uint8_t mask, unsigned int timeout_us)
+{
+    ktime_t limit = ktime_add_us(ktime_get(), timeout_us);
+    uint8_t status = 0;
+
+    while(1)
+    {
+        // Mientras arranca el chip puede no responder, cuenta como ocupado
+        if(i2c_sitara_read(BMP280_SLAVE_ADDRESS, BMP280_ADRESS_STATUS, &status) == 0 && (status & mask) == 0)
+        {
+            return 0;
+        }
+
+        if(ktime_after(ktime_get(), limit))
+        {
+            printk(KERN_ERR "bmp280_wait_status: status = 0x%x\n", status);
+            return -ETIMEDOUT;
+        }
+
+        usleep_range(BMP280_POLL_US, 2 * BMP280_POLL_US);
+    }
+}
@@ -7,12 +7,38 @@ static int char_bmp280_read(struct file *file, char __user *buf, size_t len, lof
 static int char_bmp280_write(struct file *file, const char __user *buf, size_t len, loff_t *offset);
 static int char_bmp280_open(struct inode *inode, struct file *file);
 static int char_bmp280_close(struct inode *inode, struct file *file);
+static __poll_t char_bmp280_poll(struct file *file, poll_table *wait);
 
 static struct class *device_class = NULL;
 static dev_t device_number;
 static struct cdev char_device;
 static char *device_name = NULL;
 
+/// @brief Archivos abiertos, el chip mide en modo normal mientras haya alguno
+static unsigned int open_count = 0;
+static DEFINE_MUTEX(open_lock);
+
+/* Sampler */
+
+static unsigned int sampling_period_ms = BMP280_SAMPLING_PERIOD_MS;
+module_param(sampling_period_ms, uint, 0444);
+MODULE_PARM_DESC(sampling_period_ms, "Periodo de muestreo del BMP280 en ms");
+
+/// @brief Lectores abiertos y sus colas, los protege samples_lock (el sampler escribe, cada read saca)
+static LIST_HEAD(readers);
+static DEFINE_SPINLOCK(samples_lock);
+static DECLARE_WAIT_QUEUE_HEAD(samples_wait);
+
+static enum hrtimer_restart sampler_timer_callback(struct hrtimer *timer);
+static void sampler_work_handler(struct work_struct *work);
+static void sampler_start(void);
+static void sampler_stop(void);
+
+/// @brief El timer no tiene inicializador estático, se inicializa en char_device_create_bmp280 antes del cdev_add
+static struct hrtimer sampler_timer;
+static DECLARE_WORK(sampler_work, sampler_work_handler);
+static ktime_t sampler_period;
+
 /* File operations */
 
 static const struct file_operations bmp280_fops =
@@ -22,6 +48,7 @@ static const struct file_operations bmp280_fops =
     .release = char_bmp280_close,
     .read = char_bmp280_read,
     .write = char_bmp280_write,
+    .poll = char_bmp280_poll,
     /*.unlocked_ioctl = bmp280_ioctl*/
 };
 
@@ -36,6 +63,10 @@ int char_device_create_bmp280(void)
 
     printk(KERN_INFO "char_device_create_bmp280: Creando el char device\n");
 
+    // Antes del cdev_add: desde ahí un open puede arrancar el sampler
+    hrtimer_init(&sampler_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    sampler_timer.function = sampler_timer_callback;
+
     if ((device_name = kmalloc(strlen(DEVICE_NAME) + 1, GFP_KERNEL)) == NULL) 
     {
         printk(KERN_ERR "char_device_create_bmp280: Error al reservar memoria para el nombre del device\n");
@@ -128,66 +159,158 @@ void char_device_remove(void)
 
 static int char_bmp280_open(struct inode *inode, struct file *file)
 {
-    int retval = -1;
+    struct bmp280_reader *reader;
+
+    pr_debug("char_bmp280_open: Abriendo el archivo\n");
 
-    printk(KERN_INFO "char_bmp280_open: Abriendo el archivo\n");
+    if((reader = kmalloc(sizeof(*reader), GFP_KERNEL)) == NULL)
+    {
+        printk(KERN_ERR "char_bmp280_open: Error al reservar memoria para el lector\n");
+        return -ENOMEM;
+    }
+
+    INIT_KFIFO(reader->samples);
+    file->private_data = reader;
 
-    if((retval = bmp280_init()) < 0)
+    // Se agrega antes de arrancar el sampler así recibe la primera muestra
+    spin_lock(&samples_lock);
+    list_add_tail(&reader->list, &readers);
+    spin_unlock(&samples_lock);
+
+    // La calibración ya se cargó en el probe, solo el primero pone a medir el chip
+    mutex_lock(&open_lock);
+
+    if(open_count == 0)
     {
-        printk(KERN_ERR "char_bmp280_open: Error al inicializar el bmp280\n");
-        return -1;
+        if(bmp280_start() < 0)
+        {
+            printk(KERN_ERR "char_bmp280_open: Error al iniciar el bmp280\n");
+            mutex_unlock(&open_lock);
+
+            spin_lock(&samples_lock);
+            list_del(&reader->list);
+            spin_unlock(&samples_lock);
+            kfree(reader);
+
+            return -EIO;
+        }
+
+        sampler_start();
     }
-    printk(KERN_INFO "char_bmp280_open: bmp280_init() OK!\n");
+
+    open_count++;
+
+    mutex_unlock(&open_lock);
 
     return 0;
 }
 
 static int char_bmp280_close(struct inode *inode, struct file *file)
 {
-    printk(KERN_INFO "char_bmp280_close: Cerrando el archivo\n");
+    struct bmp280_reader *reader = file->private_data;
+
+    pr_debug("char_bmp280_close: Cerrando el archivo\n");
+
+    spin_lock(&samples_lock);
+    list_del(&reader->list);
+    spin_unlock(&samples_lock);
+
+    // El último en cerrar lo pone a dormir, el filtro IIR sigue mientras haya lectores
+    mutex_lock(&open_lock);
+
+    if(--open_count == 0)
+    {
+        sampler_stop();
+        bmp280_stop();
+    }
 
-    bmp280_deinit();
+    mutex_unlock(&open_lock);
 
-    printk(KERN_INFO "char_bmp280_close: Archivo cerrado\n");
+    kfree(reader);
 
     return 0;
 }
 
+/**
+ * @brief Devuelve las muestras encoladas desde el último read, una línea "tiempo_ns temperatura\n" por muestra
+ * 
+ * No hay I/O con el bus: si no hay muestras espera a la próxima (o -EAGAIN con
+ * O_NONBLOCK) y después copia todas las que entren en len sin volver a esperar.
+ */
 static int char_bmp280_read(struct file *file, char __user *buf, size_t len, loff_t *offset)
 {
+    struct bmp280_reader *reader = file->private_data;
+    struct bmp280_sample samples[BMP280_READ_CHUNK];
+    char line[BMP280_LINE_MAX];
+    unsigned int n, i;
+    size_t copied = 0;
+    int line_len;
 
-    int temperatura;
-    char string_temperatura[10];
-    int string_temperatura_len = 0;
-
-    printk(KERN_INFO "char_bmp280_read: Leyendo el archivo\n");
+    pr_debug("char_bmp280_read: Leyendo el archivo\n");
 
-    if((bmp280_get_temperature(&temperatura)) != 0)
+    if(len < BMP280_LINE_MAX)
     {
-        printk(KERN_ERR "char_bmp280_read: Error al obtener la temperatura\n");
-
-        return -1;
+        return -EINVAL;
     }
 
-    sprintf(string_temperatura, "%i\n", temperatura);
-
-    string_temperatura_len = strlen(string_temperatura);
-
-    if(copy_to_user(buf, string_temperatura, string_temperatura_len) != 0)
+    while(copied == 0)
     {
-        printk(KERN_ERR "char_bmp280_read: Error al copiar la temperatura al usuario\n");
-
-        return -1;
+        if(kfifo_is_empty(&reader->samples))
+        {
+            if(file->f_flags & O_NONBLOCK)
+            {
+                return -EAGAIN;
+            }
+
+            if(wait_event_interruptible(samples_wait, !kfifo_is_empty(&reader->samples)))
+            {
+                return -ERESTARTSYS;
+            }
+        }
+
+        while(len - copied >= BMP280_LINE_MAX)
+        {
+            spin_lock(&samples_lock);
+            n = kfifo_out(&reader->samples, samples, min_t(size_t, (len - copied) / BMP280_LINE_MAX, BMP280_READ_CHUNK));
+            spin_unlock(&samples_lock);
+
+            if(n == 0)
+            {
+                break;
+            }
+
+            for(i = 0; i < n; i++)
+            {
+                line_len = snprintf(line, sizeof(line), "%lld %i\n", (long long)samples[i].time_ns, samples[i].temperature);
+
+                if(copy_to_user(buf + copied, line, line_len) != 0)
+                {
+                    printk(KERN_ERR "char_bmp280_read: Error al copiar la temperatura al usuario\n");
+                    return -EFAULT;
+                }
+
+                copied += line_len;
+            }
+        }
     }
 
-    // Change the offset
+    *offset += copied;
 
-    *offset += string_temperatura_len;
+    pr_debug("char_bmp280_read: %zu bytes copiados al usuario\n", copied);
 
-    printk(KERN_INFO "char_bmp280_read: Temperatura = %s\n", string_temperatura);
-    printk(KERN_INFO "char_bmp280_read: Temperatura copiada al usuario\n");
+    return copied;
+}
 
-    return string_temperatura_len;
+/**
+ * @brief Legible mientras la cola del lector tenga muestras, el sampler despierta a los que esperan
+ */
+static __poll_t char_bmp280_poll(struct file *file, poll_table *wait)
+{
+    struct bmp280_reader *reader = file->private_data;
+
+    poll_wait(file, &samples_wait, wait);
+
+    return kfifo_is_empty(&reader->samples) ? 0 : (EPOLLIN | EPOLLRDNORM);
 }
 
 static int char_bmp280_write(struct file *file, const char __user *buf, size_t len, loff_t *offset)
@@ -197,4 +320,76 @@ static int char_bmp280_write(struct file *file, const char __user *buf, size_t l
     printk(KERN_INFO "char_bmp280_write: Operación no realizable\n");
 
     return 0;
-}
\ No newline at end of file
+}
+
+/* Sampler */
+
+/**
+ * @brief Vence cada sampling_period_ms: la lectura usa el bus y duerme, la hace el workqueue
+ */
+static enum hrtimer_restart sampler_timer_callback(struct hrtimer *timer)
+{
+    // Si la lectura anterior todavía no terminó no se encola otra
+    queue_work(system_highpri_wq, &sampler_work);
+
+    hrtimer_forward_now(timer, sampler_period);
+
+    return HRTIMER_RESTART;
+}
+
+/**
+ * @brief Lee la temperatura compensada y la encola para cada lector
+ */
+static void sampler_work_handler(struct work_struct *work)
+{
+    struct bmp280_sample sample;
+    struct bmp280_reader *reader;
+
+    sample.time_ns = ktime_get_ns();
+
+    if(bmp280_get_temperature(&sample.temperature) != 0)
+    {
+        printk_ratelimited(KERN_ERR "sampler_work_handler: Error al obtener la temperatura\n");
+        return;
+    }
+
+    spin_lock(&samples_lock);
+
+    list_for_each_entry(reader, &readers, list)
+    {
+        // Un lector atrasado más que la cola pierde las más viejas, nunca las nuevas
+        if(kfifo_is_full(&reader->samples))
+        {
+            kfifo_skip(&reader->samples);
+        }
+
+        kfifo_put(&reader->samples, sample);
+    }
+
+    spin_unlock(&samples_lock);
+
+    // Despierta a los read bloqueados y a los poll/select/epoll del dispositivo
+    wake_up_interruptible_poll(&samples_wait, EPOLLIN | EPOLLRDNORM);
+}
+
+/**
+ * @brief Arranca el muestreo con una lectura inmediata, con open_lock tomado
+ */
+static void sampler_start(void)
+{
+    sampler_period = ms_to_ktime(max_t(unsigned int, sampling_period_ms, BMP280_SAMPLING_PERIOD_MIN_MS));
+
+    queue_work(system_highpri_wq, &sampler_work);
+    hrtimer_start(&sampler_timer, sampler_period, HRTIMER_MODE_REL);
+
+    pr_debug("sampler_start: Muestreo cada %lld ms\n", ktime_to_ms(sampler_period));
+}
+
+/**
+ * @brief Detiene el muestreo, con open_lock tomado: primero el timer para que no encole más
+ */
+static void sampler_stop(void)
+{
+    hrtimer_cancel(&sampler_timer);
+    cancel_work_sync(&sampler_work);
+}
@@ -74,19 +74,11 @@ static int driver_bmp280_probe( struct platform_device *pdev )
 
     printk(KERN_INFO "\n\n\n\n\n    driver_bmp280_probe: Probe del driver    \n\n\n\n\n");
 
-
-    if((retval = char_device_create_bmp280()) < 0)
-    {
-        printk(KERN_ERR "driver_bmp280_probe: Error al crear el char device\n");
-        return -1;
-    }
-
     /*Configuro los pines del I2C2*/
     
     if((retval = i2c_sitara_config_pinmux()) != 0)
     {
         printk( KERN_ERR "Error al configurar los pines del I2C2\n");
-        char_device_remove();
         return retval;
     }
 
@@ -96,7 +88,6 @@ static int driver_bmp280_probe( struct platform_device *pdev )
     if((retval = i2c_sitara_turn_on_peripheral()) != 0)
     {
         printk( KERN_ERR "Error al configurar el periferico del I2C2\n");
-        char_device_remove();
         return retval;
     }
     
@@ -105,7 +96,6 @@ static int driver_bmp280_probe( struct platform_device *pdev )
     if((retval = i2c_sitara_config_interrupts(pdev)) != 0)
     {
         printk( KERN_ERR "Error al configurar las interrupciones del I2C2\n");
-        char_device_remove();
         return retval;
     }
 
@@ -115,12 +105,32 @@ static int driver_bmp280_probe( struct platform_device *pdev )
     {
         printk( KERN_ERR "Error al inicializar el I2C2\n");
         i2c_sitara_free_interrupts();
-        char_device_remove();
         return -1;
     }
 
     printk(KERN_INFO "i2_sitara_init: i2c_sitara_config_interrupts() OK!\n" );
 
+    // Reset y calibración una sola vez, los open solo lo ponen a medir
+
+    if(bmp280_init() != 0)
+    {
+        printk( KERN_ERR "Error al inicializar el BMP280\n");
+        i2c_sitara_exit();
+        i2c_sitara_free_interrupts();
+        return -1;
+    }
+
+    // El char device al final: desde que existe se puede abrir, y el open ya usa el chip calibrado
+
+    if((retval = char_device_create_bmp280()) < 0)
+    {
+        printk(KERN_ERR "driver_bmp280_probe: Error al crear el char device\n");
+        bmp280_deinit();
+        i2c_sitara_exit();
+        i2c_sitara_free_interrupts();
+        return -1;
+    }
+
     printk(KERN_INFO "driver_bmp280_probe: char_device_create_bmp280() OK!\n");
 
     printk(KERN_INFO "\n\n\n\n\n    driver_bmp280_probe: Probe del driver finalizado      \n\n\n\n\n");
@@ -132,11 +142,14 @@ static int driver_bmp280_remove( struct platform_device *pdev )
 {
     printk(KERN_INFO "driver_bmp280_remove: Removiendo el driver bmp280\n");
 
+    // Primero el char device, así nadie más lo abre mientras se apaga el chip y el I2C
+    char_device_remove();
+
+    bmp280_deinit();
+
     i2c_sitara_exit();
 
     i2c_sitara_free_interrupts();
-
-    char_device_remove();    
     
     printk(KERN_INFO "driver_bmp280_remove: Driver removido correctamente\n");
 
@@ -39,6 +39,11 @@ volatile int trx_count = 0;
 uint32_t * rx;
 volatile int rx_count = 0;
 
+/// @brief Destino de la lectura en bloque en curso, NULL si no hay
+static uint8_t * block_rx = NULL;
+static volatile size_t block_len = 0;
+static volatile size_t block_count = 0;
+
 DEFINE_MUTEX(lock_bus);
 DECLARE_COMPLETION(ardy);
 DECLARE_COMPLETION(rrdy);
@@ -220,6 +225,7 @@ int i2c_sitara_read(const uint8_t slave_address, const uint8_t slave_register, u
 
         //print raw status
         printk(KERN_INFO "i2c_sitara_read: raw status = 0x%x\n", ioread32(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW));
+        mutex_unlock(&lock_bus);
         return -1;
     }
 
@@ -234,6 +240,7 @@ int i2c_sitara_read(const uint8_t slave_address, const uint8_t slave_register, u
         printk(KERN_ERR "i2c_sitara_read: Timeout\n");
 
         printk(KERN_INFO "i2c_sitara_read: raw status = 0x%x\n", ioread32(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW));
+        mutex_unlock(&lock_bus);
 
         return -1;
     }
@@ -245,11 +252,112 @@ int i2c_sitara_read(const uint8_t slave_address, const uint8_t slave_register, u
     //Liberamos el bus
     mutex_unlock(&lock_bus);
 
-    printk(KERN_INFO "i2c_sitara_read: slave_address = 0x%x slave_register = 0x%x data = 0x%x\n", slave_address, slave_register, *data);
+    pr_debug("i2c_sitara_read: slave_address = 0x%x slave_register = 0x%x data = 0x%x\n", slave_address, slave_register, *data);
    
     return 0;
 }
 
+/**
+ * @brief Esta función lee registros consecutivos de un esclavo i2c en una sola transacción, usando el bus i2c2 del Sitara
+ * 
+ * Primero se envía la dirección del registro sin condición de stop; cuando el
+ * módulo queda libre (ARDY) se arranca la recepción con un start repetido y
+ * stop al final de los len bytes. El umbral de la FIFO de recepción es len,
+ * así la interrupción RRDY llega una sola vez con todos los bytes.
+ * 
+ * @param slave_address Dirección del esclavo
+ * @param start_register Dirección del primer registro a leer
+ * @param data Puntero al vector donde se guardarán los datos
+ * @param len Cantidad de registros a leer, hasta I2C_SITARA_BLOCK_MAX
+ * @return int 0 si se leyó, negativo si hubo un error
+ */
+int i2c_sitara_read_block(const uint8_t slave_address, const uint8_t start_register, uint8_t *data, const size_t len)
+{
+    int ret_val = 0;
+
+    if(data == NULL)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: data = NULL\n");
+        return -ENOMEM;
+    }
+
+    if(len == 0 || len > I2C_SITARA_BLOCK_MAX)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: len = %zu fuera de rango\n", len);
+        return -EINVAL;
+    }
+
+    if(i2c2_registers==NULL)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: Registros no mapeados en memoria, iniciar el bus\n");
+        return -ENOMEM;
+    }
+
+    // pool bus
+    ret_val = pool_register(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW, I2C_SITARA_BB, 0, 1000);
+    if(ret_val != 0)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: Error al esperar la interrupción de bus libre\n");
+        return ret_val;
+    }
+
+    //Loquear el bus
+    mutex_lock(&lock_bus);
+
+    //Descarto avisos que hayan quedado de transacciones anteriores
+    reinit_completion(&xrdy);
+    reinit_completion(&ardy);
+    reinit_completion(&rrdy);
+
+    //Reset FIFOs, la de recepción avisa recién con len bytes
+    iowrite32(I2C_SITARA_BUF_RXFIFO_CLR | I2C_SITARA_BUF_TXFIFO_CLR | ((len - 1) << I2C_SITARA_BUF_RXTRSH_SHIFT), i2c2_registers+I2C_SITARA_BUF);
+
+    // Set slave address
+    iowrite32(slave_address, i2c2_registers+I2C_SITARA_SA);
+
+    trx[0] = start_register;
+    trx_count = 1;
+    block_rx = data;
+    block_count = 0;
+    block_len = len;
+
+    //Fase de escritura: solo la dirección del registro, sin stop
+    iowrite32(1, i2c2_registers+I2C_SITARA_CNT);
+    iowrite32(I2C_SITARA_CON_MST | I2C_SITARA_CON_EN | I2C_SITARA_CON_TRX | I2C_SITARA_CON_STT, i2c2_registers+I2C_SITARA_CON);
+
+    if(wait_for_completion_interruptible_timeout(&ardy, msecs_to_jiffies(100)) <= 0)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: Timeout al enviar la dirección del registro\n");
+        printk(KERN_INFO "i2c_sitara_read_block: raw status = 0x%x\n", ioread32(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW));
+        ret_val = -ETIMEDOUT;
+        goto terminar;
+    }
+
+    //Fase de lectura: start repetido y stop después del último byte
+    iowrite32(len, i2c2_registers+I2C_SITARA_CNT);
+    iowrite32(I2C_SITARA_CON_MST | I2C_SITARA_CON_EN | I2C_SITARA_CON_STT | I2C_SITARA_CON_STP, i2c2_registers+I2C_SITARA_CON);
+
+    if(wait_for_completion_interruptible_timeout(&rrdy, msecs_to_jiffies(100)) <= 0)
+    {
+        printk(KERN_ERR "i2c_sitara_read_block: Timeout al recibir %zu de %zu bytes\n", block_count, len);
+        printk(KERN_INFO "i2c_sitara_read_block: raw status = 0x%x\n", ioread32(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW));
+        ret_val = -ETIMEDOUT;
+        goto terminar;
+    }
+
+terminar:
+    block_len = 0;
+    block_rx = NULL;
+
+    //Vuelvo el umbral de recepción a un byte para i2c_sitara_read
+    iowrite32(I2C_SITARA_BUF_RXFIFO_CLR | I2C_SITARA_BUF_TXFIFO_CLR, i2c2_registers+I2C_SITARA_BUF);
+
+    //Liberamos el bus
+    mutex_unlock(&lock_bus);
+
+    return ret_val;
+}
+
 /**
  * @brief Esta función escribe un registro de un esclavo i2c, usando el bus i2c2, del Sitara
  * @param slave_address Dirección del esclavo
@@ -308,13 +416,14 @@ int i2c_sitara_write(const uint8_t slave_address, const uint8_t slave_register,
         printk(KERN_ERR "i2c_sitara_read: Timeout\n");
 
         printk(KERN_INFO "i2c_sitara_read: raw status = 0x%x\n", ioread32(i2c2_registers+I2C_SITARA_IRQSTATUS_RAW));
+        mutex_unlock(&lock_bus);
 
         return -1;
     }
 
     mutex_unlock(&lock_bus);
 
-    printk(KERN_INFO "i2c_sitara_write: slave_address = 0x%x slave_register = 0x%x data = 0x%x\n", slave_address, slave_register, data);
+    pr_debug("i2c_sitara_write: slave_address = 0x%x slave_register = 0x%x data = 0x%x\n", slave_address, slave_register, data);
 
     return 0;
 }
@@ -375,7 +484,24 @@ static irqreturn_t  i2c_sitara_irq_handler (int irq, void *dev_id)
             //write data
             complete(&ardy);
         }
-        if(irq_status_raw & I2C_SITARA_RRDY)
+        if((irq_status_raw & I2C_SITARA_RRDY) && block_len > 0)
+        {
+            //Lectura en bloque: se vacía la FIFO de una vez
+            unsigned int disponibles = (ioread32(i2c2_registers+I2C_SITARA_BUFSTAT) >> I2C_SITARA_BUFSTAT_RXSTAT_SHIFT) & I2C_SITARA_BUFSTAT_RXSTAT_MASK;
+
+            while(disponibles > 0 && block_count < block_len)
+            {
+                block_rx[block_count++] = ioread32(i2c2_registers+I2C_SITARA_DATA);
+                disponibles--;
+            }
+
+            if(block_count == block_len)
+            {
+                block_len = 0;
+                complete(&rrdy);
+            }
+        }
+        else if(irq_status_raw & I2C_SITARA_RRDY)
         {
             //printk(KERN_INFO "i2c_sitara_irq_handler: I2C_SITARA_IRQSTATUS_RRDY\n");
             //printk(KERN_INFO "i2c_sitara_irq_handler: Dato listo para leer\n");
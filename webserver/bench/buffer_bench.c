@@ -0,0 +1,201 @@
+/**
+ * @file buffer_bench.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Contención entre el proceso que carga el buffer y muchos procesos lectores
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Compara una lectura completa de la página como era antes (buffer_avg y
+ * 2 x BUFFER_SIZE lecturas, cada una con su sem_wait/sem_post sobre un
+ * FIFO que se desplaza) con una sola llamada a buffer_snapshot. El escritor
+ * carga muestras sin pausa para que la contención sea máxima.
+ *
+ * Uso: bin/buffer_bench [lectores...] (por defecto 1 4 16)
+ */
+
+#include "../inc/buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define DURACION_US 1000000 //Duración de cada prueba
+#define LECTORES_MAX 64
+
+/**
+ * @brief Buffer como estaba antes del anillo, para comparar
+ */
+typedef struct buffer_anterior
+{
+    float temp_celsius[BUFFER_SIZE];
+    float time[BUFFER_SIZE];
+    sem_t sem;
+} buffer_anterior;
+
+/**
+ * @brief Memoria compartida entre el proceso que mide y los que carga con fork
+ */
+typedef struct prueba
+{
+    _Atomic int detener;
+    _Atomic unsigned long escrituras;
+    _Atomic unsigned long lecturas;
+    buffer_anterior anterior;
+    shared_buffer anillo;
+} prueba;
+
+/*Funciones privadas*/
+
+static void escribir_anterior(buffer_anterior *buffer, float dato)
+{
+    sem_wait(&buffer->sem);
+
+    for (int i = 0; i < BUFFER_SIZE - 1; i++)
+    {
+        buffer->temp_celsius[i] = buffer->temp_celsius[i + 1];
+        buffer->time[i] = buffer->time[i + 1];
+    }
+
+    buffer->temp_celsius[BUFFER_SIZE - 1] = dato;
+    buffer->time[BUFFER_SIZE - 1] = dato;
+
+    sem_post(&buffer->sem);
+}
+
+/**
+ * @brief Lo que hacía ProcesarCliente: el promedio y después cada valor por separado
+ */
+static void leer_anterior(buffer_anterior *buffer, float *temp, float *time, float *promedio)
+{
+    float suma = 0;
+
+    sem_wait(&buffer->sem);
+    for (int i = 0; i < BUFFER_SIZE; i++)
+    {
+        suma += buffer->temp_celsius[i];
+    }
+    sem_post(&buffer->sem);
+
+    for (int i = 0; i < BUFFER_SIZE; i++)
+    {
+        sem_wait(&buffer->sem);
+        time[i] = buffer->time[i];
+        sem_post(&buffer->sem);
+    }
+
+    for (int i = 0; i < BUFFER_SIZE; i++)
+    {
+        sem_wait(&buffer->sem);
+        temp[i] = buffer->temp_celsius[i];
+        sem_post(&buffer->sem);
+    }
+
+    *promedio = suma / BUFFER_SIZE;
+}
+
+static void medir(prueba *p, int snapshot, int lectores)
+{
+    pid_t hijos[LECTORES_MAX + 1];
+    float temp[BUFFER_SIZE];
+    float time[BUFFER_SIZE];
+    int64_t tiempo_ns[BUFFER_SIZE];
+    float promedio;
+    uint32_t secuencia;
+
+    p->detener = 0;
+    p->escrituras = 0;
+    p->lecturas = 0;
+
+    for (int i = 0; i <= lectores; i++)
+    {
+        if ((hijos[i] = fork()) != 0)
+        {
+            continue;
+        }
+
+        // El primer hijo es el escritor, el resto lectores
+        while (!p->detener)
+        {
+            if (i == 0)
+            {
+                if (snapshot)
+                {
+                    buffer_put(&p->anillo, buffer_ahora_ns(), (float)p->escrituras);
+                }
+                else
+                {
+                    escribir_anterior(&p->anterior, (float)p->escrituras);
+                }
+                p->escrituras++;
+            }
+            else
+            {
+                if (snapshot)
+                {
+                    buffer_snapshot(&p->anillo, BUFFER_SIZE, temp, tiempo_ns, NULL, &secuencia);
+                }
+                else
+                {
+                    leer_anterior(&p->anterior, temp, time, &promedio);
+                }
+                p->lecturas++;
+            }
+        }
+
+        _exit(0);
+    }
+
+    usleep(DURACION_US);
+    p->detener = 1;
+
+    for (int i = 0; i <= lectores; i++)
+    {
+        waitpid(hijos[i], NULL, 0);
+    }
+
+    printf("%-10s %8d %16.0f %16.0f\n", snapshot ? "snapshot" : "semaforo", lectores,
+           p->escrituras * 1e6 / DURACION_US, p->lecturas * 1e6 / DURACION_US);
+}
+
+/*Programa*/
+
+int main(int argc, char *argv[])
+{
+    static const int por_defecto[] = {1, 4, 16};
+    int n_pruebas = (argc > 1) ? argc - 1 : (int)(sizeof(por_defecto) / sizeof(por_defecto[0]));
+    prueba *p;
+
+    p = mmap(NULL, sizeof(prueba), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED || sem_init(&p->anterior.sem, 1, 1) < 0)
+    {
+        perror("Error al preparar la memoria compartida");
+        return 1;
+    }
+
+    printf("%-10s %8s %16s %16s\n", "lectura", "lectores", "escrituras/s", "lecturas/s");
+
+    for (int i = 0; i < n_pruebas; i++)
+    {
+        int lectores = (argc > 1) ? atoi(argv[i + 1]) : por_defecto[i];
+
+        if (lectores < 1 || lectores > LECTORES_MAX)
+        {
+            fprintf(stderr, "Entre 1 y %d lectores\n", LECTORES_MAX);
+            return 1;
+        }
+
+        medir(p, 0, lectores);
+        medir(p, 1, lectores);
+    }
+
+    sem_destroy(&p->anterior.sem);
+    munmap(p, sizeof(prueba));
+
+    return 0;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file cuantiles_bench.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Compara los cuantiles de cuantiles_digest con los exactos (copia y qsort)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Uso: bin/cuantiles_bench [muestras...] (por defecto 60 3600 86400 1000000)
+ *
+ * Para cada tamaño mide el error de rango de p50, p95 y p99 (qué fracción
+ * de las muestras queda por debajo del valor estimado, menos q) y el tiempo
+ * de obtener los tres cuantiles: ordenando una copia o con el resumen que
+ * se mantiene muestra a muestra. También une resúmenes de 3600 muestras,
+ * como los de las horas del historial, y mide el error del resultado.
+ */
+
+#include "../inc/cuantiles.h"
+#include "../inc/buffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIEMPO_MINIMO_NS 200000000LL //Cada medición se repite al menos este tiempo
+#define MUESTRAS_HORA 3600 //Muestras de cada resumen que se une
+
+/*Variables privadas*/
+
+static const double cuantiles[] = {0.50, 0.95, 0.99};
+
+#define N_CUANTILES (sizeof(cuantiles) / sizeof(cuantiles[0]))
+
+/*Funciones privadas*/
+
+static int comparar(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Cuantil exacto de un vector ordenado, interpolando entre vecinos
+ */
+static float cuantil_exacto(const float *ordenadas, int n, double q)
+{
+    double posicion = q * (n - 1);
+    int i = (int)posicion;
+
+    if (i + 1 >= n)
+    {
+        return ordenadas[n - 1];
+    }
+
+    return ordenadas[i] + (ordenadas[i + 1] - ordenadas[i]) * (float)(posicion - i);
+}
+
+/**
+ * @brief Error de rango de un valor: fracción de muestras menores o iguales, menos q
+ */
+static double error_rango(const float *ordenadas, int n, float valor, double q)
+{
+    int izquierda = 0;
+    int derecha = n;
+
+    while (izquierda < derecha)
+    {
+        int medio = (izquierda + derecha) / 2;
+
+        if (ordenadas[medio] <= valor)
+        {
+            izquierda = medio + 1;
+        }
+        else
+        {
+            derecha = medio;
+        }
+    }
+
+    return fabs((double)izquierda / n - q);
+}
+
+/**
+ * @brief Temperaturas como las del sensor: deriva lenta, ciclo diario,
+ * ruido y algún pico, con la resolución de 1/16 °C
+ */
+static void generar(float *muestras, int n)
+{
+    double deriva = 0;
+
+    srand(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        double ruido = ((rand() % 2001) - 1000) / 4000.0;
+
+        deriva += ((rand() % 2001) - 1000) / 100000.0;
+
+        muestras[i] = roundf((22.0 + 4.0 * sin(i * 2 * M_PI / 86400) + deriva + ruido +
+                              ((rand() % 1000 == 0) ? 15.0 : 0)) * 16) / 16;
+    }
+}
+
+/**
+ * @brief Nanosegundos para obtener los tres cuantiles ordenando una copia
+ */
+static double medir_exacto(const float *muestras, float *copia, int n)
+{
+    long long inicio = buffer_ahora_ns();
+    long long transcurrido;
+    long long repeticiones = 0;
+    volatile float resultado;
+
+    do
+    {
+        memcpy(copia, muestras, n * sizeof(float));
+        qsort(copia, n, sizeof(float), comparar);
+
+        for (size_t j = 0; j < N_CUANTILES; j++)
+        {
+            resultado = cuantil_exacto(copia, n, cuantiles[j]);
+        }
+
+        repeticiones++;
+        transcurrido = buffer_ahora_ns() - inicio;
+    } while (transcurrido < TIEMPO_MINIMO_NS);
+
+    (void)resultado;
+
+    return (double)transcurrido / repeticiones;
+}
+
+/**
+ * @brief Nanosegundos para obtener los tres cuantiles de un resumen ya armado
+ * (se copia para que cada repetición compacte las pendientes)
+ */
+static double medir_resumen(const cuantiles_digest *digest)
+{
+    cuantiles_digest copia;
+    long long inicio = buffer_ahora_ns();
+    long long transcurrido;
+    long long repeticiones = 0;
+    volatile float resultado;
+
+    do
+    {
+        copia = *digest;
+
+        for (size_t j = 0; j < N_CUANTILES; j++)
+        {
+            resultado = cuantiles_valor(&copia, cuantiles[j]);
+        }
+
+        repeticiones++;
+        transcurrido = buffer_ahora_ns() - inicio;
+    } while (transcurrido < TIEMPO_MINIMO_NS);
+
+    (void)resultado;
+
+    return (double)transcurrido / repeticiones;
+}
+
+static void imprimir_errores(const char *nombre, int n, cuantiles_digest *digest, const float *ordenadas)
+{
+    printf("%10d %-10s", n, nombre);
+
+    for (size_t j = 0; j < N_CUANTILES; j++)
+    {
+        float estimado = cuantiles_valor(digest, cuantiles[j]);
+
+        printf(" p%02.0f %7.3f (%.2e, %+.3f°C)", cuantiles[j] * 100, estimado,
+               error_rango(ordenadas, n, estimado, cuantiles[j]),
+               estimado - cuantil_exacto(ordenadas, n, cuantiles[j]));
+    }
+
+    printf("\n");
+}
+
+/*Programa*/
+
+int main(int argc, char *argv[])
+{
+    static const int por_defecto[] = {60, 3600, 86400, 1000000};
+    int n_pruebas = (argc > 1) ? argc - 1 : (int)(sizeof(por_defecto) / sizeof(por_defecto[0]));
+
+    printf("Resumen de %zu bytes; entre paréntesis: error de rango y diferencia con el cuantil exacto\n\n",
+           sizeof(cuantiles_digest));
+
+    for (int p = 0; p < n_pruebas; p++)
+    {
+        int n = (argc > 1) ? atoi(argv[p + 1]) : por_defecto[p];
+        float *muestras = malloc(n * sizeof(float));
+        float *ordenadas = malloc(n * sizeof(float));
+        cuantiles_digest digest;
+        cuantiles_digest parcial;
+        cuantiles_digest unido;
+        long long inicio;
+        double ns_agregar;
+        double ns_exacto;
+        double ns_resumen;
+
+        if (n <= 0 || muestras == NULL || ordenadas == NULL)
+        {
+            fprintf(stderr, "Error con %d muestras\n", n);
+            return 1;
+        }
+
+        generar(muestras, n);
+        memcpy(ordenadas, muestras, n * sizeof(float));
+        qsort(ordenadas, n, sizeof(float), comparar);
+
+        // Muestra a muestra, como lo hace el proceso que lee el sensor
+        cuantiles_iniciar(&digest);
+        inicio = buffer_ahora_ns();
+        for (int i = 0; i < n; i++)
+        {
+            cuantiles_agregar(&digest, muestras[i]);
+        }
+        ns_agregar = (double)(buffer_ahora_ns() - inicio) / n;
+
+        // Uniendo resúmenes de una hora, como una consulta sobre los agregados
+        cuantiles_iniciar(&unido);
+        for (int i = 0; i < n; i += MUESTRAS_HORA)
+        {
+            cuantiles_iniciar(&parcial);
+
+            for (int k = i; k < n && k < i + MUESTRAS_HORA; k++)
+            {
+                cuantiles_agregar(&parcial, muestras[k]);
+            }
+
+            cuantiles_unir(&unido, &parcial);
+        }
+
+        ns_exacto = medir_exacto(muestras, ordenadas, n);
+        ns_resumen = medir_resumen(&digest);
+
+        imprimir_errores("agregando", n, &digest, ordenadas);
+        imprimir_errores("uniendo", n, &unido, ordenadas);
+        printf("%10s %-10s qsort %.0f ns, resumen %.0f ns (%.0fx), %.1f ns por muestra agregada\n\n", "", "tiempo",
+               ns_exacto, ns_resumen, ns_exacto / ns_resumen, ns_agregar);
+
+        free(muestras);
+        free(ordenadas);
+    }
+
+    return 0;
+}
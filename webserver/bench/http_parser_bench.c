@@ -0,0 +1,357 @@
+/**
+ * @file http_parser_bench.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Velocidad y fuzzing del analizador de pedidos HTTP
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Uso: bin/http_parser_bench [pruebas] (por defecto 1000000)
+ *
+ * Primero mide cuántos pedidos por segundo analiza de una vez cada pedido de
+ * la tabla. Después lo vuelve a analizar cortado en segmentos al azar, como
+ * llegan por TCP, y exige el mismo resultado que de una vez; también un POST
+ * cuyo cuerpo parece un pedido, seguido de otro pedido en la misma conexión,
+ * donde el siguiente tiene que empezar después del cuerpo. Por último
+ * analiza pedidos mutados (bytes cambiados, insertados, borrados o cortados),
+ * cada uno en un buffer del tamaño justo para que valgrind o -fsanitize=address
+ * vean cualquier lectura de más, y verifica que los segmentos queden dentro
+ * del pedido. Termina con 1 si alguna verificación falla.
+ */
+
+#include "../inc/http_parser.h"
+#include "../inc/buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRUEBAS_DEFECTO 1000000
+#define TIEMPO_MINIMO_NS 200000000LL //Cada pedido se repite al menos este tiempo
+#define MUTACIONES_MAX 8 //Cambios como máximo en cada pedido mutado
+#define PEDIDO_MAX 1024 //Longitud máxima de un pedido mutado
+
+/*Variables privadas*/
+
+/// @brief Pedidos como los que manda el navegador o curl, con y sin query, 1.0 y 1.1
+static const char *const pedidos[] = {
+    "GET / HTTP/1.1\r\nHost: beaglebone:8080\r\n\r\n",
+    "GET /GetData?from=1700000000&to=1700086400&step=3600&q=50,99 HTTP/1.1\r\n"
+    "Host: beaglebone:8080\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n",
+    "GET /image/logo-utn-frba.png HTTP/1.1\r\n"
+    "Host: 192.168.7.2:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:120.0) Gecko/20100101 Firefox/120.0\r\n"
+    "Accept: image/avif,image/webp,*/*\r\n"
+    "Accept-Language: es-AR,es;q=0.8,en-US;q=0.5,en;q=0.3\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://192.168.7.2:8080/\r\n"
+    "If-None-Match: \"1a2b-65730c00\"\r\n"
+    "Sec-Fetch-Dest: image\r\nSec-Fetch-Mode: no-cors\r\nSec-Fetch-Site: same-origin\r\n\r\n",
+    "GET /stats HTTP/1.0\r\n\r\n",
+    "GET http://beaglebone:8080/metrics HTTP/1.1\r\nHost: beaglebone:8080\r\nConnection: close\r\n\r\n",
+    "GET /ws HTTP/1.1\nHost: beaglebone\nUpgrade: websocket\nConnection: Upgrade\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\nSec-WebSocket-Version: 13\n\n",
+    "POST /GetData HTTP/1.1\r\nHost: beaglebone:8080\r\nContent-Length: 29\r\n\r\n"
+    "GET /nonexistent HTTP/1.1\r\n\r\n",
+};
+
+/// @brief El POST de la tabla, con un pedido en el cuerpo, y después otro pedido en la misma conexión
+static const char encadenados[] = "POST /GetData HTTP/1.1\r\nHost: beaglebone:8080\r\nContent-Length: 29\r\n\r\n"
+                                  "GET /nonexistent HTTP/1.1\r\n\r\n"
+                                  "GET /stats HTTP/1.1\r\nHost: beaglebone:8080\r\n\r\n";
+
+#define N_PEDIDOS (sizeof(pedidos) / sizeof(pedidos[0]))
+
+/// @brief Bytes que más cambian el camino del analizador
+static const char especiales[] = {'\r', '\n', ' ', ':', '?', '/', '\t', '\0', 'H', '1', '.', '\x80'};
+
+/*Funciones privadas*/
+
+/**
+ * @brief Analiza de una vez
+ */
+static http_resultado analizar(http_pedido *pedido, const char *datos, size_t longitud)
+{
+    http_parser_iniciar(pedido);
+
+    return http_parser_analizar(pedido, datos, longitud);
+}
+
+/**
+ * @brief Analiza los datos como si llegaran de a segmentos de longitud al azar
+ */
+static http_resultado analizar_cortado(http_pedido *pedido, const char *datos, size_t longitud)
+{
+    http_resultado resultado = HTTP_PARSER_INCOMPLETO;
+    size_t recibido = 0;
+
+    http_parser_iniciar(pedido);
+
+    while (recibido < longitud && resultado == HTTP_PARSER_INCOMPLETO)
+    {
+        recibido += 1 + rand() % ((rand() % 4 == 0) ? longitud - recibido : 16);
+
+        if (recibido > longitud)
+        {
+            recibido = longitud;
+        }
+
+        resultado = http_parser_analizar(pedido, datos, recibido);
+    }
+
+    return resultado;
+}
+
+static int segmentos_iguales(http_segmento a, http_segmento b)
+{
+    return a.inicio == b.inicio && a.longitud == b.longitud;
+}
+
+/**
+ * @brief Compara lo que registraron dos análisis del mismo pedido
+ */
+static int pedidos_iguales(const http_pedido *a, const http_pedido *b)
+{
+    if (a->longitud != b->longitud || a->version_menor != b->version_menor || a->n_cabeceras != b->n_cabeceras ||
+        !segmentos_iguales(a->metodo, b->metodo) || !segmentos_iguales(a->ruta, b->ruta) ||
+        !segmentos_iguales(a->query, b->query))
+    {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < a->n_cabeceras; i++)
+    {
+        if (!segmentos_iguales(a->cabeceras[i].nombre, b->cabeceras[i].nombre) ||
+            !segmentos_iguales(a->cabeceras[i].valor, b->cabeceras[i].valor))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static int segmento_dentro(http_segmento segmento, size_t longitud)
+{
+    return (size_t)segmento.inicio + segmento.longitud <= longitud;
+}
+
+/**
+ * @brief Un pedido completo solo puede apuntar a bytes del propio pedido
+ */
+static int pedido_valido(const http_pedido *pedido, size_t recibido)
+{
+    if (pedido->longitud > recibido || pedido->n_cabeceras > HTTP_MAX_CABECERAS ||
+        !segmento_dentro(pedido->metodo, pedido->longitud) || !segmento_dentro(pedido->ruta, pedido->longitud) ||
+        !segmento_dentro(pedido->query, pedido->longitud))
+    {
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < pedido->n_cabeceras; i++)
+    {
+        if (!segmento_dentro(pedido->cabeceras[i].nombre, pedido->longitud) ||
+            !segmento_dentro(pedido->cabeceras[i].valor, pedido->longitud))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Analiza los pedidos encadenados como el servidor: el segundo empieza donde termina el primero
+ *
+ * @return int 1 si el cuerpo del POST se salteó y el segundo es GET /stats, 0 si no
+ */
+static int encadenados_validos(void)
+{
+    http_pedido pedido;
+    size_t longitud = sizeof(encadenados) - 1;
+    const char *siguiente;
+
+    if (analizar_cortado(&pedido, encadenados, longitud) != HTTP_PARSER_COMPLETO || pedido.cuerpo != 29 ||
+        !http_segmento_igual(encadenados, pedido.metodo, "POST"))
+    {
+        return 0;
+    }
+
+    siguiente = encadenados + pedido.longitud;
+    longitud -= pedido.longitud;
+
+    return analizar_cortado(&pedido, siguiente, longitud) == HTTP_PARSER_COMPLETO && pedido.longitud == longitud &&
+           http_segmento_igual(siguiente, pedido.ruta, "/stats");
+}
+
+/**
+ * @brief Copia un pedido de la tabla con algunos bytes cambiados, insertados, borrados o cortado
+ *
+ * @return size_t Longitud del pedido mutado
+ */
+static size_t mutar(char *destino, const char *original)
+{
+    size_t longitud = strlen(original);
+    int cambios = 1 + rand() % MUTACIONES_MAX;
+
+    memcpy(destino, original, longitud);
+
+    for (int i = 0; i < cambios && longitud > 0; i++)
+    {
+        size_t posicion = rand() % longitud;
+        char byte = (rand() % 2) ? especiales[rand() % sizeof(especiales)] : (char)rand();
+
+        switch (rand() % 4)
+        {
+        case 0:
+            destino[posicion] = byte;
+            break;
+        case 1:
+            if (longitud < PEDIDO_MAX)
+            {
+                memmove(&destino[posicion + 1], &destino[posicion], longitud - posicion);
+                destino[posicion] = byte;
+                longitud++;
+            }
+            break;
+        case 2:
+            memmove(&destino[posicion], &destino[posicion + 1], longitud - posicion - 1);
+            longitud--;
+            break;
+        default:
+            longitud = posicion;
+            break;
+        }
+    }
+
+    return longitud;
+}
+
+/**
+ * @brief Nanosegundos por pedido analizado de una vez, repitiendo hasta TIEMPO_MINIMO_NS
+ */
+static double medir(const char *datos, size_t longitud)
+{
+    http_pedido pedido;
+    long long inicio = buffer_ahora_ns();
+    long long transcurrido;
+    long long repeticiones = 0;
+    long long completos = 0;
+
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            completos += analizar(&pedido, datos, longitud) == HTTP_PARSER_COMPLETO;
+        }
+
+        repeticiones += 1000;
+        transcurrido = buffer_ahora_ns() - inicio;
+    } while (transcurrido < TIEMPO_MINIMO_NS);
+
+    return (completos == repeticiones) ? (double)transcurrido / repeticiones : -1;
+}
+
+/*Programa*/
+
+int main(int argc, char *argv[])
+{
+    long pruebas = (argc > 1) ? atol(argv[1]) : PRUEBAS_DEFECTO;
+    long resultados[3] = {0, 0, 0};
+    long fallas = 0;
+    http_pedido pedido;
+    http_pedido cortado;
+    char mutado[PEDIDO_MAX];
+
+    if (pruebas <= 0)
+    {
+        fprintf(stderr, "Uso: %s [pruebas]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+
+    // Velocidad: cada pedido de la tabla analizado de una vez
+    printf("%-40s %7s %10s %14s %10s\n", "pedido", "bytes", "ns", "pedidos/s", "MB/s");
+
+    for (size_t p = 0; p < N_PEDIDOS; p++)
+    {
+        size_t longitud = strlen(pedidos[p]);
+        double ns = medir(pedidos[p], longitud);
+        char nombre[41];
+
+        snprintf(nombre, sizeof(nombre), "%.*s", (int)strcspn(pedidos[p], "\r\n"), pedidos[p]);
+
+        if (ns < 0)
+        {
+            printf("%-40.40s NO se analiza completo\n", nombre);
+            fallas++;
+            continue;
+        }
+
+        printf("%-40.40s %7zu %10.1f %14.0f %10.1f\n", nombre, longitud, ns, 1e9 / ns, longitud * 1e3 / ns);
+    }
+
+    // Segmentación: cortado al azar tiene que dar lo mismo que de una vez
+    for (long i = 0; i < pruebas; i++)
+    {
+        const char *datos = pedidos[i % N_PEDIDOS];
+        size_t longitud = strlen(datos);
+
+        if (analizar(&pedido, datos, longitud) != HTTP_PARSER_COMPLETO ||
+            analizar_cortado(&cortado, datos, longitud) != HTTP_PARSER_COMPLETO || !pedidos_iguales(&pedido, &cortado) ||
+            !encadenados_validos())
+        {
+            fallas++;
+        }
+    }
+
+    printf("\nsegmentados: %ld pedidos, %ld fallas\n", pruebas, fallas);
+
+    // Fuzzing: pedidos mutados en un buffer del tamaño justo
+    for (long i = 0; i < pruebas; i++)
+    {
+        size_t longitud = mutar(mutado, pedidos[rand() % N_PEDIDOS]);
+        char *datos = malloc(longitud > 0 ? longitud : 1);
+        http_resultado entero;
+        http_resultado segmentos;
+
+        if (datos == NULL)
+        {
+            perror("malloc");
+            return 1;
+        }
+
+        memcpy(datos, mutado, longitud);
+
+        entero = analizar(&pedido, datos, longitud);
+        segmentos = analizar_cortado(&cortado, datos, longitud);
+        resultados[entero + 1]++;
+
+        if (entero != segmentos || (entero == HTTP_PARSER_COMPLETO &&
+                                    (!pedido_valido(&pedido, longitud) || !pedidos_iguales(&pedido, &cortado))))
+        {
+            fprintf(stderr, "Falla con el pedido mutado: %.*s\n", (int)longitud, datos);
+            fallas++;
+        }
+
+        if (entero == HTTP_PARSER_COMPLETO)
+        {
+            // Las consultas sobre el pedido tampoco pueden salirse del buffer
+            http_segmento valor;
+
+            http_pedido_cabecera(&pedido, datos, "Connection");
+            http_query_parametro(datos, pedido.query, "from", &valor);
+        }
+
+        free(datos);
+    }
+
+    printf("mutados: %ld pedidos (%ld completos, %ld incompletos, %ld errores), %ld fallas en total\n", pruebas,
+           resultados[HTTP_PARSER_COMPLETO + 1], resultados[HTTP_PARSER_INCOMPLETO + 1],
+           resultados[HTTP_PARSER_ERROR + 1], fallas);
+
+    return fallas > 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file json_bench.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Compara json_writer_muestras con el generate_json anterior (sprintf + strcat)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Uso: bin/json_bench [muestras...] (por defecto 20 1000 10000 100000)
+ */
+
+#include "../inc/json_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TIEMPO_MINIMO_NS 200000000LL //Cada función se repite al menos este tiempo
+
+/*Funciones privadas*/
+
+static long long ahora_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief generate_json tal como estaba en server_client.c, como referencia
+ * (los tiempos ahora van con milisegundos)
+ */
+static void generate_json(char *json, float * temp_data, double * time_data, int size)
+{
+    char temp[256], time[256];
+
+    strcpy(json, "{\"temp\":[");
+
+    for (int i = 0; i < size; i++) {
+        sprintf(temp, "%.2f", temp_data[i]);
+        strcat(json, temp);
+        if (i < size - 1) {
+            strcat(json, ",");
+        }
+    }
+
+    strcat(json, "],\"time\":[");
+    for (int i = 0; i < size; i++) {
+        sprintf(time, "%.3f", time_data[i]);
+        strcat(json, time);
+        if (i < size - 1) {
+            strcat(json, ",");
+        }
+    }
+
+    strcat(json, "]}");
+}
+
+/**
+ * @brief Nanosegundos por llamada, repitiendo hasta TIEMPO_MINIMO_NS
+ */
+static double medir(int anterior, char *json, size_t capacidad, float *temp, double *time, int64_t *tiempo_ns, int n)
+{
+    long long inicio = ahora_ns();
+    long long transcurrido;
+    long long repeticiones = 0;
+
+    do
+    {
+        if (anterior)
+        {
+            generate_json(json, temp, time, n);
+        }
+        else
+        {
+            json_writer_muestras(json, capacidad, temp, tiempo_ns, n);
+        }
+
+        repeticiones++;
+        transcurrido = ahora_ns() - inicio;
+    } while (transcurrido < TIEMPO_MINIMO_NS);
+
+    return (double)transcurrido / repeticiones;
+}
+
+/*Programa*/
+
+int main(int argc, char *argv[])
+{
+    static const int por_defecto[] = {20, 1000, 10000, 100000};
+    int n_pruebas = (argc > 1) ? argc - 1 : (int)(sizeof(por_defecto) / sizeof(por_defecto[0]));
+
+    printf("%10s %16s %16s %10s %s\n", "muestras", "generate_json", "json_writer", "mejora", "iguales");
+
+    for (int p = 0; p < n_pruebas; p++)
+    {
+        int n = (argc > 1) ? atoi(argv[p + 1]) : por_defecto[p];
+        size_t capacidad = JSON_MUESTRAS_SIZE(n);
+        float *temp = malloc(n * sizeof(float));
+        double *time = malloc(n * sizeof(double));
+        int64_t *tiempo_ns = malloc(n * sizeof(int64_t));
+        char *anterior = malloc(capacidad);
+        char *nuevo = malloc(capacidad);
+        double ns_anterior;
+        double ns_nuevo;
+
+        if (n <= 0 || temp == NULL || time == NULL || tiempo_ns == NULL || anterior == NULL || nuevo == NULL)
+        {
+            fprintf(stderr, "Error con %d muestras\n", n);
+            return 1;
+        }
+
+        // Temperaturas y tiempos como los del sensor, con negativos y empates al redondear
+        srand(n);
+        for (int i = 0; i < n; i++)
+        {
+            temp[i] = -20.0f + (rand() % 80000) / 1000.0f;
+            tiempo_ns[i] = i * 1000500000LL + 200000;
+            time[i] = tiempo_ns[i] / 1e9;
+        }
+        temp[0] = 0.125f;
+        temp[n - 1] = -0.001f;
+
+        generate_json(anterior, temp, time, n);
+        json_writer_muestras(nuevo, capacidad, temp, tiempo_ns, n);
+
+        ns_anterior = medir(1, anterior, capacidad, temp, time, tiempo_ns, n);
+        ns_nuevo = medir(0, nuevo, capacidad, temp, time, tiempo_ns, n);
+
+        printf("%10d %13.0f ns %13.0f ns %9.1fx %s\n", n, ns_anterior, ns_nuevo,
+               ns_anterior / ns_nuevo, strcmp(anterior, nuevo) == 0 ? "si" : "NO");
+
+        free(temp);
+        free(time);
+        free(tiempo_ns);
+        free(anterior);
+        free(nuevo);
+    }
+
+    return 0;
+}
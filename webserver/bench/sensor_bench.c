@@ -0,0 +1,166 @@
+/**
+ * @file sensor_bench.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Distribución de la latencia de las lecturas de /dev/bmp280_sitara
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ * Uso: bin/sensor_bench [lecturas] [dispositivo] (por defecto 200 y SENSOR_ARCHIVO)
+ *
+ * Mide cada lectura de dos maneras: con el descriptor abierto (pread) y
+ * abriendo y cerrando el dispositivo en cada lectura, como un cat. Imprime
+ * mínimo, percentiles y máximo en microsegundos; para comparar dos versiones
+ * del driver se corre con cada una cargada. Con el muestreo en el driver el
+ * read bloquea hasta la próxima muestra, así que "abierto" mide el período
+ * del driver y no el costo de la lectura.
+ */
+
+#include "../inc/buffer.h"
+#include "../inc/server_temp.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LECTURAS_DEFECTO 200
+
+/*Funciones privadas*/
+
+static int comparar(const void *a, const void *b)
+{
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Percentil de un vector ordenado, el vecino más cercano
+ */
+static double percentil_us(const long long *ordenados, int n, double q)
+{
+    int i = (int)(q * (n - 1) + 0.5);
+
+    return ordenados[i] / 1000.0;
+}
+
+static void imprimir(const char *nombre, long long *duraciones, int n, int errores)
+{
+    double p50;
+
+    qsort(duraciones, n, sizeof(long long), comparar);
+    p50 = percentil_us(duraciones, n, 0.5);
+
+    printf("%-12s %6d %7d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", nombre, n, errores,
+           percentil_us(duraciones, n, 0), p50, percentil_us(duraciones, n, 0.9),
+           percentil_us(duraciones, n, 0.99), percentil_us(duraciones, n, 1), p50 > 0 ? 1e6 / p50 : 0);
+}
+
+/**
+ * @brief Lee n veces del mismo descriptor, como sensor_muestrear
+ *
+ * @return int Lecturas fallidas, -1 si no se pudo abrir
+ */
+static int medir_abierto(const char *ruta, long long *duraciones, int n)
+{
+    char linea[SENSOR_LECTURA_SIZE];
+    int errores = 0;
+    int fd = open(ruta, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror(ruta);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        long long inicio = buffer_ahora_ns();
+
+        if (pread(fd, linea, sizeof(linea) - 1, 0) <= 0)
+        {
+            errores++;
+        }
+
+        duraciones[i] = buffer_ahora_ns() - inicio;
+    }
+
+    close(fd);
+
+    return errores;
+}
+
+/**
+ * @brief Abre, lee y cierra n veces, como un cat del dispositivo
+ *
+ * @return int Lecturas fallidas, -1 si no se pudo abrir
+ */
+static int medir_reabriendo(const char *ruta, long long *duraciones, int n)
+{
+    char linea[SENSOR_LECTURA_SIZE];
+    int errores = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        long long inicio = buffer_ahora_ns();
+        int fd = open(ruta, O_RDONLY);
+
+        if (fd < 0)
+        {
+            perror(ruta);
+            return -1;
+        }
+
+        if (read(fd, linea, sizeof(linea) - 1) <= 0)
+        {
+            errores++;
+        }
+
+        close(fd);
+
+        duraciones[i] = buffer_ahora_ns() - inicio;
+    }
+
+    return errores;
+}
+
+/*Programa*/
+
+int main(int argc, char *argv[])
+{
+    int n = (argc > 1) ? atoi(argv[1]) : LECTURAS_DEFECTO;
+    const char *ruta = (argc > 2) ? argv[2] : SENSOR_ARCHIVO;
+    long long *duraciones = malloc((n > 0 ? n : 1) * sizeof(long long));
+    int errores;
+
+    if (n <= 0 || duraciones == NULL)
+    {
+        fprintf(stderr, "Uso: %s [lecturas] [dispositivo]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d lecturas de %s, tiempos en us\n\n", n, ruta);
+    printf("%-12s %6s %7s %10s %10s %10s %10s %10s %10s\n", "modo", "n", "errores", "min", "p50", "p90", "p99", "max", "Hz (p50)");
+
+    if ((errores = medir_abierto(ruta, duraciones, n)) < 0)
+    {
+        free(duraciones);
+        return 1;
+    }
+    imprimir("abierto", duraciones, n, errores);
+
+    if ((errores = medir_reabriendo(ruta, duraciones, n)) < 0)
+    {
+        free(duraciones);
+        return 1;
+    }
+    imprimir("reabriendo", duraciones, n, errores);
+
+    free(duraciones);
+
+    return 0;
+}
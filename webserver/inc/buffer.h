@@ -2,24 +2,131 @@
 #define BUFFER_H
 
 #include <stdint.h>
-#include <semaphore.h>
+#include <stdatomic.h>
 
-#define BUFFER_SIZE 20
+#define BUFFER_SIZE 20 //Muestras de la ventana que se muestra en la página
+#define BUFFER_CAPACIDAD_BITS 16
+#define BUFFER_CAPACIDAD (1u << BUFFER_CAPACIDAD_BITS) //Muestras que guarda el anillo, potencia de 2
+#define BUFFER_MASCARA (BUFFER_CAPACIDAD - 1)
+#define BUFFER_SNAPSHOT_MAX (BUFFER_CAPACIDAD / 2) //Muestras como máximo en una copia con buffer_snapshot
 #define SHI_MEM_KEY 0x123
+#define BUFFER_EWMA_ALFA 0.1f //Peso de la muestra nueva en el promedio exponencial, se cambia con buffer_set_ewma_alfa
 
+/*
+ * Muestra del anillo. La hora es CLOCK_MONOTONIC en ns: no salta con los
+ * cambios de hora del sistema y en 64 bits no pierde resolución a ninguna
+ * frecuencia de muestreo. Con el ancla de shared_buffer se pasa a la hora
+ * real o a tiempo desde el inicio en cualquier proceso.
+ */
+typedef struct buffer_muestra
+{
+    int64_t tiempo_ns;
+    float temp_celsius;
+    uint32_t reservado;
+} buffer_muestra;
+
+/*
+ * Estadísticas de la ventana (las últimas BUFFER_SIZE muestras), las
+ * actualiza buffer_put en O(1) con cada muestra.
+ */
+typedef struct buffer_estadisticas
+{
+    uint32_t secuencia; // Última muestra incluida
+    uint32_t cantidad; // Muestras en la ventana, hasta BUFFER_SIZE
+    float media;
+    float minimo;
+    float maximo;
+    float desvio; // Desvío estándar de la ventana (poblacional)
+    float p50; // Percentiles de la ventana, interpolando entre muestras vecinas
+    float p95;
+    float p99;
+    float ewma; // Promedio exponencial de todas las muestras
+    float ewma_alfa;
+} buffer_estadisticas;
+
+/*
+ * Estadísticas del muestreo desde el inicio, las publica el proceso que lee
+ * el sensor. El retraso es cuánto después del vencimiento del timer empezó
+ * cada lectura (jitter de la cadencia).
+ */
+typedef struct buffer_muestreo
+{
+    uint32_t periodo_us;
+    uint32_t muestras;
+    uint32_t perdidas; // Vencimientos sin muestra porque la anterior tardó más de un período (sin timer, muestras del driver salteadas)
+    uint32_t errores; // Lecturas fallidas
+    float retraso_medio_us;
+    float retraso_max_us;
+    float retraso_desvio_us;
+    float lectura_media_us; // Duración de la lectura del dispositivo
+    float lectura_max_us;
+} buffer_muestreo;
+
+/*
+ * Cola de números de muestra con valores monótonos, el frente es el mínimo
+ * (o el máximo) de la ventana.
+ */
+typedef struct buffer_deque
+{
+    uint32_t numeros[BUFFER_SIZE];
+    uint32_t cabeza;
+    uint32_t largo;
+} buffer_deque;
+
+/*
+ * Estado que usa el escritor para actualizar las estadísticas sin recorrer
+ * la ventana: media y suma de cuadrados de las diferencias (Welford), las
+ * colas monótonas del mínimo y el máximo y la ventana ordenada para los
+ * percentiles (con BUFFER_SIZE muestras insertar ordenado cuesta menos que
+ * mantener un resumen, que además no permite sacar la muestra que sale).
+ */
+typedef struct buffer_acumulado
+{
+    double media;
+    double m2;
+    double ewma;
+    buffer_deque minimos;
+    buffer_deque maximos;
+    float ordenadas[BUFFER_SIZE];
+} buffer_acumulado;
+
+/*
+ * Anillo de muestras en memoria compartida con un único escritor (el proceso
+ * que lee el sensor) y muchos lectores. La muestra número n se guarda en
+ * muestras[n & BUFFER_MASCARA]; escribir es O(1) y nadie toma un lock:
+ * los lectores copian y después verifican con la secuencia que el escritor
+ * no haya pisado lo que copiaron.
+ */
 typedef struct shared_buffer
 {
-    float temp_celsius[BUFFER_SIZE];
-    float time[BUFFER_SIZE];
-    sem_t * sem;
+    _Atomic uint32_t secuencia; // Muestras escritas desde el inicio, la última es la número secuencia
+    uint32_t arranque; // Hora de inicio, distingue la secuencia entre ejecuciones
+    int64_t ancla_monotonica_ns; // CLOCK_MONOTONIC al iniciar el buffer, el tiempo 0 de las muestras
+    int64_t ancla_real_ns; // CLOCK_REALTIME en el mismo instante
+    _Atomic uint32_t version_estadisticas; // Impar mientras el escritor actualiza las estadísticas
+    buffer_estadisticas estadisticas;
+    buffer_acumulado acumulado; // Solo lo usa el escritor
+    _Atomic uint32_t version_muestreo; // Impar mientras el escritor actualiza el muestreo
+    buffer_muestreo muestreo;
+    buffer_muestra muestras[BUFFER_CAPACIDAD];
 } shared_buffer;
 
 int buffer_init(struct shared_buffer **buffer, int *shmid);
-int buffer_put(struct shared_buffer *buffer, float data);
+int buffer_put(struct shared_buffer *buffer, int64_t tiempo_ns, float data);
 int buffer_avg(struct shared_buffer *buffer, float *data);
 void buffer_destroy(struct shared_buffer **buffer, int shmid);
 void print_buffer(struct shared_buffer *buffer);
 int buffer_get_temp(struct shared_buffer *buffer , unsigned int position, float *data);
-int buffer_get_time(struct shared_buffer *buffer , unsigned int position, float *data);
+int buffer_get_time(struct shared_buffer *buffer , unsigned int position, int64_t *tiempo_ns);
+int buffer_get_secuencia(struct shared_buffer *buffer, uint32_t *arranque, uint32_t *secuencia);
+int buffer_snapshot(struct shared_buffer *buffer, unsigned int n, float *temp, int64_t *tiempo_ns, uint32_t *arranque, uint32_t *secuencia);
+int64_t buffer_ahora_ns(void);
+int64_t buffer_desde_inicio_ns(const struct shared_buffer *buffer, int64_t tiempo_ns);
+int64_t buffer_tiempo_real_ns(const struct shared_buffer *buffer, int64_t tiempo_ns);
+int buffer_aviso_fd(void);
+int buffer_get_estadisticas(struct shared_buffer *buffer, buffer_estadisticas *estadisticas);
+int buffer_set_ewma_alfa(struct shared_buffer *buffer, float alfa);
+int buffer_get_muestreo(struct shared_buffer *buffer, buffer_muestreo *muestreo);
+int buffer_set_muestreo(struct shared_buffer *buffer, const buffer_muestreo *muestreo);
 
 #endif /* BUFFER_H */ // Add comment here
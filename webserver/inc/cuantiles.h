@@ -0,0 +1,86 @@
+/**
+ * @file cuantiles.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Estimación de cuantiles en línea con un t-digest de tamaño fijo
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef CUANTILES_H
+#define CUANTILES_H
+
+#include <stdint.h>
+
+#define CUANTILES_CENTROIDES 48 //Centroides como máximo, fija la precisión y el tamaño
+#define CUANTILES_PENDIENTES 24 //Muestras que se juntan antes de compactar
+
+/**
+ * @brief Grupo de muestras vecinas resumido por su media y cuántas son
+ */
+typedef struct cuantiles_centroide
+{
+    float media;
+    uint32_t peso;
+} cuantiles_centroide;
+
+/**
+ * @brief Resumen de una distribución para estimar sus cuantiles (t-digest)
+ *
+ * Los centroides están ordenados por media. Cerca de los extremos solo se
+ * juntan pocas muestras por centroide y en el medio muchas, así p99 tiene un
+ * error de rango mucho menor que p50. Ocupa siempre lo mismo y no tiene
+ * punteros: se puede guardar en memoria compartida o en un archivo y dos
+ * resúmenes se unen sin volver a las muestras.
+ */
+typedef struct cuantiles_digest
+{
+    uint32_t total; // Muestras resumidas, incluidas las pendientes
+    uint32_t n_centroides;
+    uint32_t n_pendientes;
+    float minimo;
+    float maximo;
+    cuantiles_centroide centroides[CUANTILES_CENTROIDES];
+    float pendientes[CUANTILES_PENDIENTES]; // Muestras todavía sin compactar
+} cuantiles_digest;
+
+/**
+ * @brief Deja el resumen vacío
+ *
+ * @param digest
+ */
+void cuantiles_iniciar(cuantiles_digest *digest);
+
+/**
+ * @brief Agrega una muestra, O(1) amortizado
+ *
+ * Cada CUANTILES_PENDIENTES muestras se compactan con los centroides.
+ *
+ * @param digest
+ * @param valor
+ */
+void cuantiles_agregar(cuantiles_digest *digest, float valor);
+
+/**
+ * @brief Agrega a destino todas las muestras resumidas en origen
+ *
+ * @param destino
+ * @param origen
+ */
+void cuantiles_unir(cuantiles_digest *destino, const cuantiles_digest *origen);
+
+/**
+ * @brief Estima el cuantil q
+ *
+ * Compacta las muestras pendientes e interpola entre las medias de los
+ * centroides vecinos, y con el mínimo y el máximo en los extremos.
+ *
+ * @param digest
+ * @param q Entre 0 y 1, ej: 0.95 para p95
+ * @return float NAN si el resumen está vacío
+ */
+float cuantiles_valor(cuantiles_digest *digest, double q);
+
+#endif // CUANTILES_H
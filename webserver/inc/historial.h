@@ -0,0 +1,276 @@
+/**
+ * @file historial.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Historial de temperaturas persistente en un archivo mapeado en memoria
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef HISTORIAL_H
+#define HISTORIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "../inc/cuantiles.h"
+
+#define HISTORIAL_ARCHIVO "historial.dat" //Archivo del historial, relativo al directorio del servidor
+#define HISTORIAL_VERSION 5
+#define HISTORIAL_BLOQUE_SIZE 4096 //Bytes de cada bloque, una página
+#define HISTORIAL_MUESTRAS_BLOQUE 504 //Muestras por bloque, lo que entra después de la cabecera
+#define HISTORIAL_MAX_BLOQUES 32768 //Bloques como máximo (128 MiB, ~190 días a 1 Hz), después se reciclan
+#define HISTORIAL_CRECIMIENTO 256 //Bloques que se agregan al archivo cada vez que se llena
+#define HISTORIAL_MAGIA_BLOQUE 0x51424854 //"THBQ", marca los bloques inicializados
+#define HISTORIAL_VACIA 0xFFFFFFFFu //delta_ms de las posiciones sin muestra
+#define HISTORIAL_PUNTOS_MAX 10000 //Puntos como máximo en una consulta
+#define HISTORIAL_CUANTILES_MUESTRAS_MAX 262144 //Muestras que una consulta con cuantiles puede recorrer (~3 días a 1 Hz)
+#define HISTORIAL_MINUTOS 262144 //Agregados de 1 min que se guardan (~182 días)
+#define HISTORIAL_HORAS 65536 //Agregados de 1 h (~7 años)
+#define HISTORIAL_DIAS 4096 //Agregados de 1 día (~11 años)
+
+/**
+ * @brief Muestra del historial, la hora es relativa al inicio del bloque
+ */
+typedef struct historial_muestra
+{
+    uint32_t delta_ms; // Milisegundos desde inicio_ms del bloque, HISTORIAL_VACIA si no hay muestra
+    float valor;
+} historial_muestra;
+
+/**
+ * @brief Resumen del bloque, va al principio de cada bloque
+ *
+ * minimo, maximo, suma y fin_ms son definitivos cuando el bloque se llena;
+ * mientras es la cola pueden ir adelantados respecto de cantidad, así que
+ * para la cola conviene recorrer sus muestras.
+ */
+typedef struct historial_resumen
+{
+    uint32_t magia; // HISTORIAL_MAGIA_BLOQUE si el bloque está inicializado
+    uint32_t numero; // Número del bloque desde que se creó el archivo
+    int64_t inicio_ms; // Hora de la primera muestra (ms desde 1970)
+    int64_t fin_ms; // Hora de la última muestra
+    _Atomic uint32_t cantidad; // Muestras válidas, se publica después de escribir cada una
+    float minimo;
+    float maximo;
+    uint32_t reservado;
+    double suma;
+    double suma_cuadrados;
+    uint8_t relleno[8];
+} historial_resumen;
+
+typedef struct historial_bloque
+{
+    historial_resumen resumen;
+    historial_muestra muestras[HISTORIAL_MUESTRAS_BLOQUE];
+} historial_bloque;
+
+/**
+ * @brief Resumen de un bloque completo en el índice
+ *
+ * El índice es un vector contiguo con una entrada por bloque, así una
+ * consulta larga lee unos pocos KiB de resúmenes sin tocar las muestras.
+ */
+typedef struct historial_indice
+{
+    int64_t inicio_ms;
+    int64_t fin_ms;
+    double suma;
+    double suma_cuadrados;
+    float minimo;
+    float maximo;
+    uint32_t cantidad;
+    _Atomic uint32_t bloque; // Número del bloque resumido más uno, 0 mientras la entrada no es válida
+} historial_indice;
+
+/**
+ * @brief Niveles de agregados, cada uno en su propio anillo
+ */
+typedef enum historial_nivel
+{
+    HISTORIAL_MINUTO,
+    HISTORIAL_HORA,
+    HISTORIAL_DIA,
+    HISTORIAL_NIVELES
+} historial_nivel;
+
+/**
+ * @brief Agregado de un intervalo fijo de un nivel (minuto, hora o día UTC)
+ *
+ * El proceso que lee el sensor lo actualiza con cada muestra; el intervalo
+ * número n de un nivel va en la posición n % capacidad de su anillo.
+ */
+typedef struct historial_agregado
+{
+    double suma;
+    double suma_cuadrados;
+    float minimo;
+    float maximo;
+    uint32_t cantidad;
+    _Atomic uint32_t periodo; // Número del intervalo (ms desde 1970 / ancho) más uno, 0 si está vacío
+    _Atomic uint32_t version; // Impar mientras se escribe, crece con cada escritura
+} historial_agregado;
+
+/**
+ * @brief Resumen de cuantiles de un período de una hora o un día
+ *
+ * Los minutos no tienen: con pocas muestras por período ocuparía más que
+ * las muestras mismas. Se actualiza igual que historial_agregado.
+ */
+typedef struct historial_cuantiles
+{
+    cuantiles_digest digest;
+    _Atomic uint32_t periodo; // Igual que en historial_agregado
+    _Atomic uint32_t version; // Igual que en historial_agregado
+} historial_cuantiles;
+
+/**
+ * @brief Agregado de las muestras de un intervalo de una consulta
+ */
+typedef struct historial_punto
+{
+    double suma;
+    double suma_cuadrados;
+    float minimo;
+    float maximo;
+    uint32_t cantidad; // 0 si el intervalo no tiene muestras
+} historial_punto;
+
+/**
+ * @brief Cabecera del archivo, ocupa el primer bloque
+ *
+ * Le siguen el índice (HISTORIAL_MAX_BLOQUES entradas), los anillos de
+ * agregados de cada nivel, los de cuantiles de las horas y los días y
+ * después los bloques.
+ */
+typedef struct historial_cabecera
+{
+    char magia[8]; // "BTHIST01"
+    uint32_t version;
+    uint32_t bloque_size;
+    uint32_t muestras_bloque;
+    uint32_t max_bloques;
+    _Atomic uint32_t bloques; // Bloques empezados desde la creación, el último es la cola
+    uint8_t relleno[HISTORIAL_BLOQUE_SIZE - 28];
+} historial_cabecera;
+
+/**
+ * @brief Historial abierto
+ *
+ * Se abre antes del fork: el proceso que lee el sensor agrega muestras y los
+ * que atienden clientes leen los bloques directamente del mismo mapeo.
+ */
+typedef struct historial
+{
+    int fd;
+    historial_cabecera *cabecera; // Inicio del mapeo, reservado para HISTORIAL_MAX_BLOQUES
+    historial_indice *indice; // Resumen del bloque número n en indice[n % HISTORIAL_MAX_BLOQUES]
+    historial_agregado *agregados[HISTORIAL_NIVELES]; // Anillo de cada nivel
+    historial_cuantiles *cuantiles[HISTORIAL_NIVELES]; // Anillo de cuantiles de cada nivel, NULL en los minutos
+    historial_bloque *bloques; // Bloque número n en bloques[n % HISTORIAL_MAX_BLOQUES]
+    uint32_t archivo_bloques; // Bloques que tiene hoy el archivo
+} historial;
+
+/**
+ * @brief Abre el historial, o lo crea si no existe, y recupera la cola
+ *
+ * Si el sistema se cortó mientras se escribía, se descartan las muestras a
+ * medio escribir del último bloque y se recalcula su resumen. Los agregados
+ * desde el día anterior a la última muestra se vuelven a calcular de las
+ * muestras, por si alguna página no llegó al disco.
+ *
+ * @param h
+ * @param ruta
+ * @return int 0 si se abrió, -1 si hubo un error
+ */
+int historial_abrir(historial *h, const char *ruta);
+
+/**
+ * @brief Agrega una muestra al final (solo el proceso que lee el sensor)
+ *
+ * También actualiza el agregado del minuto, la hora y el día de la muestra y
+ * los cuantiles de la hora y el día.
+ *
+ * @param h
+ * @param tiempo_ms Hora de la muestra en ms desde 1970, si es anterior a la última se usa la última
+ * @param valor
+ * @return int 0 si se agregó, -1 si hubo un error
+ */
+int historial_agregar(historial *h, int64_t tiempo_ms, float valor);
+
+/**
+ * @brief Número del primer bloque disponible y cantidad de bloques empezados
+ *
+ * Los bloques disponibles son los números [primero, total), el último es la cola.
+ *
+ * @param h
+ * @param primero
+ * @return uint32_t total
+ */
+uint32_t historial_bloques(const historial *h, uint32_t *primero);
+
+/**
+ * @brief Acceso sin copias a un bloque
+ *
+ * El bloque se puede reciclar mientras se lee si el historial da la vuelta:
+ * después de usarlo hay que confirmar con historial_bloque_vigente.
+ *
+ * @param h
+ * @param numero Número del bloque
+ * @return const historial_bloque* NULL si el bloque no existe o ya se recicló
+ */
+const historial_bloque *historial_bloque_leer(const historial *h, uint32_t numero);
+
+/**
+ * @brief Confirma que un bloque leído no se recicló mientras se usaba
+ *
+ * @return int 1 si sigue siendo el bloque numero, 0 si no
+ */
+int historial_bloque_vigente(const historial_bloque *bloque, uint32_t numero);
+
+/**
+ * @brief Agrega las muestras de [desde_ms, hasta_ms) en intervalos de paso_ms
+ *
+ * Si el paso es al menos cuatro veces el ancho de un nivel de agregados se
+ * usa el más grueso de esos niveles, y los bloques solo para los extremos
+ * del rango que no completan un intervalo del nivel: la consulta lee unos
+ * pocos agregados por punto sin importar cuántas muestras abarca.
+ *
+ * Los bloques completos que caen dentro de un intervalo se suman con su
+ * entrada del índice, sin leer sus muestras. Si un bloque abarca el límite
+ * entre dos intervalos pero dura menos de un cuarto del paso, se suma entero
+ * al intervalo de su punto medio. Solo se recorren las muestras de la cola y
+ * de los bloques en los extremos del rango o más largos que eso.
+ *
+ * Con digestos también se arma un resumen de cuantiles por intervalo. En ese
+ * caso solo sirven los niveles con cuantiles (horas y días), alcanza con que
+ * el paso sea de al menos un período, y los bloques se recorren muestra por
+ * muestra porque el índice no tiene cuantiles. Si eso supera
+ * HISTORIAL_CUANTILES_MUESTRAS_MAX muestras la consulta no se hace.
+ *
+ * No bloquea al proceso que agrega muestras.
+ *
+ * @param h
+ * @param desde_ms Desde 0
+ * @param hasta_ms
+ * @param paso_ms Mayor que 0
+ * @param puntos Un punto por intervalo, el k empieza en desde_ms + k * paso_ms
+ * @param digestos Un resumen por intervalo, NULL si no se piden cuantiles
+ * @param n_puntos Intervalos, hasta HISTORIAL_PUNTOS_MAX
+ * @return int 0 si se pudo consultar, -1 si los parámetros no son válidos o hay demasiadas muestras que recorrer
+ */
+int historial_consultar(const historial *h, int64_t desde_ms, int64_t hasta_ms, int64_t paso_ms,
+                        historial_punto *puntos, cuantiles_digest *digestos, unsigned int n_puntos);
+
+/**
+ * @brief Cierra el historial
+ *
+ * @param h
+ */
+void historial_cerrar(historial *h);
+
+#endif // HISTORIAL_H
@@ -0,0 +1,168 @@
+/**
+ * @file http_parser.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Analizador incremental de pedidos HTTP/1.x
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_MAX_CABECERAS 32 //Cabeceras que se registran por pedido
+#define HTTP_CUERPO_MAX 8192 //Cuerpo más largo que se acepta (y se saltea), tiene que entrar en el buffer de recepción
+
+/**
+ * @brief Resultado de http_parser_analizar
+ */
+typedef enum http_resultado
+{
+    HTTP_PARSER_INCOMPLETO = 0,
+    HTTP_PARSER_COMPLETO = 1,
+    HTTP_PARSER_ERROR = -1
+} http_resultado;
+
+typedef enum http_estado_parser
+{
+    HTTP_PARSER_LINEA,
+    HTTP_PARSER_CABECERAS,
+    HTTP_PARSER_FIN
+} http_estado_parser;
+
+/**
+ * @brief Porción del buffer de recepción (desplazamiento y longitud)
+ *
+ * El analizador no copia datos, solo guarda dónde está cada parte del pedido.
+ */
+typedef struct http_segmento
+{
+    uint32_t inicio;
+    uint32_t longitud;
+} http_segmento;
+
+typedef struct http_cabecera
+{
+    http_segmento nombre;
+    http_segmento valor;
+} http_cabecera;
+
+typedef struct http_pedido
+{
+    http_estado_parser estado;
+    size_t posicion; // Próximo byte sin analizar
+    size_t longitud; // Longitud total del pedido, válida al completarse
+
+    http_segmento metodo;
+    http_segmento ruta; // Sin la query
+    http_segmento query; // Sin el '?'
+    int version_menor; // 0 para HTTP/1.0, 1 para HTTP/1.1
+
+    http_cabecera cabeceras[HTTP_MAX_CABECERAS];
+    unsigned int n_cabeceras;
+
+    size_t cuerpo; // Bytes del cuerpo según Content-Length, incluidos en longitud
+    int cuerpo_declarado; // 1 si ya apareció un Content-Length
+    unsigned int codigo_error; // Con HTTP_PARSER_ERROR, el estado a responder: 400, 413 o 501
+} http_pedido;
+
+/**
+ * @brief Prepara el analizador para un nuevo pedido
+ *
+ * @param pedido
+ */
+void http_parser_iniciar(http_pedido *pedido);
+
+/**
+ * @brief Analiza los datos recibidos hasta el momento
+ *
+ * Se puede llamar cada vez que llegan más datos al mismo buffer, el análisis
+ * continúa desde donde quedó. Los segmentos son relativos al inicio de datos.
+ *
+ * Si hay Content-Length el pedido se completa recién cuando llegó todo el
+ * cuerpo, y longitud lo incluye: así el que sigue en la conexión empieza
+ * después del cuerpo y no dentro de él. Un Content-Length repetido o inválido
+ * es un error (400), uno mayor que HTTP_CUERPO_MAX también (413) y
+ * Transfer-Encoding no está soportado (501): en esos casos no se sabe dónde
+ * termina el pedido y hay que cerrar la conexión.
+ *
+ * @param pedido Estado del analizador
+ * @param datos Buffer de recepción
+ * @param longitud Bytes válidos en datos
+ * @return http_resultado
+ */
+http_resultado http_parser_analizar(http_pedido *pedido, const char *datos, size_t longitud);
+
+/**
+ * @brief Compara un segmento con una cadena
+ *
+ * @return int 1 si son iguales, 0 si no
+ */
+int http_segmento_igual(const char *datos, http_segmento segmento, const char *texto);
+
+/**
+ * @brief Busca una cabecera por nombre (sin distinguir mayúsculas)
+ *
+ * @param pedido Pedido completo
+ * @param datos Buffer de recepción
+ * @param nombre Nombre de la cabecera
+ * @return const http_segmento* Valor de la cabecera o NULL si no está
+ */
+const http_segmento *http_pedido_cabecera(const http_pedido *pedido, const char *datos, const char *nombre);
+
+/**
+ * @brief Indica si un valor de cabecera contiene un token (sin distinguir mayúsculas)
+ *
+ * Por ejemplo el token "close" en "Connection: keep-alive, close".
+ *
+ * @return int 1 si lo contiene, 0 si no
+ */
+int http_segmento_contiene_token(const char *datos, http_segmento segmento, const char *token);
+
+/**
+ * @brief Indica si un valor de Accept-Encoding acepta una codificación
+ *
+ * La codificación es aceptada si figura (o figura "*") con calidad mayor a 0,
+ * ej: "gzip" en "gzip, deflate" pero no en "gzip;q=0, *".
+ *
+ * @return int 1 si la acepta, 0 si no
+ */
+int http_segmento_acepta_codificacion(const char *datos, http_segmento segmento, const char *codificacion);
+
+/**
+ * @brief Indica si un valor de If-None-Match coincide con un ETag
+ *
+ * Usa la comparación débil (RFC 9110, 13.1.2): se ignora el prefijo W/ y
+ * "*" coincide con cualquier ETag.
+ *
+ * @param etag ETag con comillas, ej: "\"1a2b\""
+ * @return int 1 si coincide, 0 si no
+ */
+int http_segmento_contiene_etag(const char *datos, http_segmento segmento, const char *etag);
+
+/**
+ * @brief Busca un parámetro de la query por nombre, ej: "to" en "from=1&to=2"
+ *
+ * No decodifica %XX: los parámetros que usa el servidor son numéricos.
+ *
+ * @param datos Buffer de recepción
+ * @param query Query del pedido
+ * @param nombre Nombre del parámetro
+ * @param valor Valor del parámetro, vacío si no tiene '='
+ * @return int 1 si está, 0 si no
+ */
+int http_query_parametro(const char *datos, http_segmento query, const char *nombre, http_segmento *valor);
+
+/**
+ * @brief Convierte un segmento a entero decimal con signo opcional
+ *
+ * @return int 1 si el segmento es un entero válido de 64 bits, 0 si no
+ */
+int http_segmento_entero(const char *datos, http_segmento segmento, int64_t *valor);
+
+#endif // HTTP_PARSER_H
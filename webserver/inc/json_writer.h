@@ -0,0 +1,127 @@
+/**
+ * @file json_writer.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Serialización de JSON directo sobre un buffer, sin reservar memoria
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_NUMERO_MAX 20 //Caracteres como máximo de un número con 2 decimales y su coma
+#define JSON_NUMERO_LIMITE 1e15 //Valores con módulo desde este límite se escriben como null
+#define JSON_ENTERO_MAX 21 //Caracteres como máximo de un entero de 64 bits y su coma
+#define JSON_SEGUNDOS_MAX (JSON_ENTERO_MAX + 4) //Caracteres como máximo de un tiempo con milisegundos y su coma
+
+/*Bytes necesarios para json_writer_muestras con n muestras, incluido el '\0'*/
+#define JSON_MUESTRAS_SIZE(n) (32 + (size_t)(n) * (JSON_NUMERO_MAX + JSON_SEGUNDOS_MAX))
+
+/**
+ * @brief Escritor sobre un buffer de tamaño fijo
+ *
+ * Cada escritura avanza longitud sin volver a recorrer lo ya escrito. Si algo
+ * no entra se marca desbordado y las escrituras siguientes se ignoran, así
+ * alcanza con revisar el resultado una vez al final.
+ */
+typedef struct json_writer
+{
+    char *destino;
+    size_t capacidad; // Bytes disponibles en destino, incluido el '\0'
+    size_t longitud; // Bytes escritos, sin el '\0'
+    int desbordado;
+} json_writer;
+
+/**
+ * @brief Prepara el escritor sobre un buffer
+ *
+ * @param writer
+ * @param destino
+ * @param capacidad Tamaño de destino, al menos 1
+ */
+void json_writer_iniciar(json_writer *writer, char *destino, size_t capacidad);
+
+/**
+ * @brief Escribe texto tal cual (estructura del JSON, nombres entre comillas)
+ *
+ * @param writer
+ * @param texto
+ * @param longitud
+ */
+void json_writer_texto(json_writer *writer, const char *texto, size_t longitud);
+
+/**
+ * @brief Escribe un número con dos decimales en punto fijo
+ *
+ * Da el mismo resultado que printf("%.2f") en el locale "C", sin depender
+ * del locale del proceso. NaN, infinito y valores fuera de
+ * ±JSON_NUMERO_LIMITE se escriben como null, que sí es JSON válido.
+ *
+ * @param writer
+ * @param valor
+ */
+void json_writer_numero(json_writer *writer, float valor);
+
+/**
+ * @brief Escribe un entero, ej: una hora en segundos que no entra en un float
+ *
+ * @param writer
+ * @param valor
+ */
+void json_writer_entero(json_writer *writer, int64_t valor);
+
+/**
+ * @brief Escribe un tiempo en ns como segundos con tres decimales, ej: 41.014
+ *
+ * Se redondea al milisegundo con aritmética entera, sin pasar por float.
+ *
+ * @param writer
+ * @param tiempo_ns
+ */
+void json_writer_segundos(json_writer *writer, int64_t tiempo_ns);
+
+/**
+ * @brief Escribe un arreglo de números con dos decimales, ej: [1.00,2.50]
+ *
+ * @param writer
+ * @param valores
+ * @param n
+ */
+void json_writer_arreglo(json_writer *writer, const float *valores, size_t n);
+
+/**
+ * @brief Escribe un arreglo de enteros, ej: [1700000000,1700000060]
+ *
+ * @param writer
+ * @param valores
+ * @param n
+ */
+void json_writer_arreglo_enteros(json_writer *writer, const int64_t *valores, size_t n);
+
+/**
+ * @brief Termina el texto con '\0'
+ *
+ * @param writer
+ * @return int Longitud escrita, -1 si no entró en el buffer
+ */
+int json_writer_terminar(json_writer *writer);
+
+/**
+ * @brief Serializa las muestras de /GetData: {"temp":[...],"time":[...]}
+ *
+ * @param destino
+ * @param capacidad Alcanza con JSON_MUESTRAS_SIZE(n)
+ * @param temp
+ * @param tiempo_ns ns desde el inicio del buffer, se escriben en segundos
+ * @param n Cantidad de muestras
+ * @return int Longitud del JSON, -1 si no entró en el buffer
+ */
+int json_writer_muestras(char *destino, size_t capacidad, const float *temp, const int64_t *tiempo_ns, size_t n);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,109 @@
+/**
+ * @file metricas.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Contadores del servidor y del muestreo para /metrics (formato de Prometheus)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "../inc/buffer.h"
+#include "../inc/historial.h"
+
+#define METRICAS_PARTES 16 //Partes de los contadores, cada proceso suma en la de su pid
+#define METRICAS_RUTAS 16 //Rutas distintas que se cuentan como máximo
+#define METRICAS_BUCKETS 14 //Límites de los histogramas, el último es +Inf
+#define METRICAS_CODIGOS 15 //Códigos de estado que se distinguen, el último junta los demás
+#define METRICAS_TEXTO_SIZE 65536 //Tamaño máximo de la respuesta de /metrics
+
+/**
+ * @brief Contadores de una parte, en su propia línea de cache
+ *
+ * Solo se suman con atomic_fetch_add relajado: en el modo epoll cada parte la
+ * usa un solo proceso y en el modo fork pueden coincidir pocos hijos, nunca
+ * hay un lock. Los histogramas cuentan por bucket, sin acumular; /metrics
+ * acumula al leerlos.
+ */
+typedef struct metricas_parte
+{
+    _Atomic uint64_t pedidos[METRICAS_RUTAS][METRICAS_BUCKETS]; // Por ruta y bucket de duración
+    _Atomic uint64_t codigos[METRICAS_RUTAS][METRICAS_CODIGOS]; // Por ruta y código de estado (índice en la tabla de códigos)
+    _Atomic uint64_t duracion_ns[METRICAS_RUTAS];
+    _Atomic uint64_t enviados; // Bytes enviados a los clientes
+    _Atomic uint64_t conexiones_abiertas;
+    _Atomic uint64_t conexiones_cerradas;
+    _Atomic uint64_t lecturas[METRICAS_BUCKETS]; // Duración de las lecturas del sensor
+    _Atomic uint64_t lectura_ns;
+    _Atomic uint64_t retrasos[METRICAS_BUCKETS]; // Retraso de cada lectura respecto del timer (jitter)
+    _Atomic uint64_t retraso_ns;
+} __attribute__((aligned(64))) metricas_parte;
+
+/**
+ * @brief Reserva los contadores en memoria compartida, antes del fork
+ *
+ * @return int 0 si se reservaron, -1 si no (las funciones de registro no hacen nada)
+ */
+int metricas_iniciar(void);
+
+/**
+ * @brief Registra un pedido atendido
+ *
+ * @param ruta Índice de la ruta, menor que METRICAS_RUTAS
+ * @param codigo Código de estado HTTP de la respuesta
+ * @param duracion_ns Tiempo que llevó generar la respuesta
+ */
+void metricas_pedido(unsigned int ruta, unsigned int codigo, int64_t duracion_ns);
+
+/**
+ * @brief Suma bytes enviados a un cliente
+ *
+ * @param bytes
+ */
+void metricas_enviados(size_t bytes);
+
+/**
+ * @brief Registra que se aceptó una conexión
+ */
+void metricas_conexion_abierta(void);
+
+/**
+ * @brief Registra que se cerró una conexión
+ */
+void metricas_conexion_cerrada(void);
+
+/**
+ * @brief Registra una lectura del sensor (solo el proceso que lo lee)
+ *
+ * @param lectura_ns Duración de la lectura del dispositivo
+ * @param retraso_ns Cuánto después del vencimiento del timer empezó
+ */
+void metricas_muestreo(int64_t lectura_ns, int64_t retraso_ns);
+
+/**
+ * @brief Suma las partes y escribe todas las métricas en el formato de texto de Prometheus
+ *
+ * Además de los contadores incluye el estado del muestreo, el llenado y las
+ * estadísticas de la ventana del buffer y los agregados del minuto, la hora
+ * y el día en curso del historial.
+ *
+ * @param texto
+ * @param texto_size
+ * @param rutas Nombre de cada ruta, se usa como etiqueta
+ * @param n_rutas Hasta METRICAS_RUTAS
+ * @param buffer
+ * @param h Historial, NULL si no hay
+ * @return int Longitud del texto, -1 si no entra o hubo un error
+ */
+int metricas_escribir(char *texto, size_t texto_size, const char *const *rutas, unsigned int n_rutas,
+                      shared_buffer *buffer, const historial *h);
+
+#endif // METRICAS_H
@@ -15,7 +15,9 @@
     #include <sys/socket.h>
     #include <sys/ipc.h>
 
-    #define MAX_CONN 10 //Nro maximo de conexiones en espera
-    #define BUFFER_TIME_SLEEP 1 //Tiempo de espera entre cada carga de buffer
+    #define MAX_CONN 128 //Nro maximo de conexiones en espera
+
+    #define SERVER_MODO_FORK 0 //Un proceso hijo por cada conexion
+    #define SERVER_MODO_EPOLL 1 //Un unico proceso con epoll para todas las conexiones
     
 #endif
\ No newline at end of file
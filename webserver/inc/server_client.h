@@ -13,6 +13,8 @@
 #define SERVER_CLIENT_H
 
 #include "../inc/buffer.h"
+#include "../inc/http_parser.h"
+#include "../inc/historial.h"
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -20,9 +22,128 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #define SAVED_DATA_VECTOR_SIZE 20
 
+#define KEEPALIVE_TIMEOUT 5 //Segundos que una conexion persistente puede quedar inactiva
+#define KEEPALIVE_MAX_PEDIDOS 1000 //Pedidos atendidos por conexion antes de cerrarla
+
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+/*Cabecera Connection de las respuestas, incluida la línea vacía final*/
+#define CABECERA_KEEPALIVE "Connection: keep-alive\r\nKeep-Alive: timeout=" STR(KEEPALIVE_TIMEOUT) ", max=" STR(KEEPALIVE_MAX_PEDIDOS) "\r\n"
+#define CABECERA_CLOSE "Connection: close\r\n"
+
+#define RESPUESTA_MAX_SEGMENTOS 4 //Porciones de memoria que se envían en un solo writev
+
+#define RESPUESTA_FLUJO_NINGUNO 0 //La conexión sigue con el próximo pedido
+#define RESPUESTA_FLUJO_SSE 1 //La conexión queda suscripta a las muestras nuevas (/stream)
+#define RESPUESTA_FLUJO_WEBSOCKET 2 //La conexión pasa a hablar WebSocket (/ws)
+
+struct static_cache;
+
+/**
+ * @brief Respuesta HTTP lista para enviar (cabecera + cuerpo)
+ *
+ * La respuesta se arma como una lista de segmentos que se envían con un solo
+ * writev: memoria propia (datos) o archivos de la cache estática, sin copiarlos.
+ * El campo enviado permite retomar el envío tras una escritura parcial,
+ * tanto en el modo fork (bloqueante) como en el modo epoll (no bloqueante).
+ *
+ * Si archivo_fd es válido, luego de los segmentos se envía esa porción del
+ * archivo con sendfile, sin pasar el contenido por el espacio de usuario.
+ */
+typedef struct respuesta_http
+{
+    struct iovec segmentos[RESPUESTA_MAX_SEGMENTOS];
+    int n_segmentos;
+    size_t longitud; // Suma de los segmentos y de archivo_len
+    size_t enviado;
+    char *datos; // Memoria propia a liberar, NULL si no hay
+    struct static_cache *cache; // Generación de la cache referenciada, NULL si no hay
+    int archivo_fd; // Archivo a enviar con sendfile, -1 si no hay (no es propio)
+    off_t archivo_offset;
+    size_t archivo_len;
+    int cerrar; // 1 si hay que cerrar la conexion luego de enviarla
+    int flujo; // RESPUESTA_FLUJO_*, qué hacer con la conexión luego de enviarla
+    int reanudar; // 1 si el cliente indicó el último evento que recibió
+    uint32_t ultimo_evento; // Secuencia del último evento recibido si reanudar es 1
+    unsigned int ruta; // Posición de la ruta en la tabla, para contar el pedido en /metrics
+} respuesta_http;
+
 int ProcesarCliente(int s_aux, struct sockaddr_in *pDireccionCliente, int puerto, shared_buffer *buffer) ;
 
+/**
+ * @brief Genera la respuesta al primer pedido completo de la entrada
+ *
+ * La entrada puede contener varios pedidos encadenados (pipelining), solo se
+ * atiende el primero. El análisis es incremental: si el pedido está incompleto
+ * se puede volver a llamar cuando lleguen más datos con el mismo estado.
+ * Decide además si la conexión se mantiene abierta según la versión HTTP, la
+ * cabecera Connection y la cantidad de pedidos atendidos.
+ *
+ * @param entrada Datos recibidos
+ * @param entrada_len Cantidad de bytes recibidos
+ * @param pedido Estado del analizador de esta conexión
+ * @param pedidos Pedidos ya atendidos en esta conexión
+ * @param buffer Buffer de memoria compartida con las muestras
+ * @param respuesta Respuesta generada
+ * @return ssize_t Bytes de la entrada consumidos por el pedido, 0 si está incompleto, -1 si hubo un error
+ */
+ssize_t server_client_atender_pedido(char *entrada, size_t entrada_len, http_pedido *pedido, unsigned int pedidos, shared_buffer *buffer, respuesta_http *respuesta);
+
+/**
+ * @brief Genera la respuesta HTTP para un pedido, sin tocar el socket
+ *
+ * @param datos Buffer de recepción al que apuntan los segmentos del pedido
+ * @param pedido Pedido completo
+ * @param buffer Buffer de memoria compartida con las muestras
+ * @param mantener_conexion 1 para responder con Connection: keep-alive
+ * @param respuesta Respuesta generada, se libera con server_client_liberar_respuesta
+ * @return int 0 si se generó la respuesta, -1 si hubo un error
+ */
+int server_client_generar_respuesta(const char *datos, const http_pedido *pedido, shared_buffer *buffer, int mantener_conexion, respuesta_http *respuesta);
+
+/**
+ * @brief Envía lo que falte de la respuesta por el socket
+ *
+ * @param s_aux Socket del cliente
+ * @param respuesta Respuesta a enviar
+ * @return int 1 si se envió completa, 0 si el socket no acepta más datos (EAGAIN), -1 si hubo un error
+ */
+int server_client_enviar_respuesta(int s_aux, respuesta_http *respuesta);
+
+/**
+ * @brief Habilita las rutas que dejan la conexión abierta recibiendo muestras
+ *
+ * Solo el modo epoll puede mantener estas conexiones, en el modo fork esas
+ * rutas responden 501.
+ */
+void server_client_habilitar_flujos(void);
+
+/**
+ * @brief Indica el historial que responde /GetData?from=&to=&step=
+ *
+ * Sin historial esas consultas responden 503.
+ *
+ * @param h Historial abierto, NULL para dejar de usarlo
+ */
+void server_client_usar_historial(const historial *h);
+
+/**
+ * @brief Inicializa una respuesta vacía
+ *
+ * @param respuesta
+ */
+void server_client_iniciar_respuesta(respuesta_http *respuesta);
+
+/**
+ * @brief Libera la memoria de una respuesta y la referencia a la cache
+ *
+ * @param respuesta
+ */
+void server_client_liberar_respuesta(respuesta_http *respuesta);
+
 #endif // SERVER_CLIENT_H
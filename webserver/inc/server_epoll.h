@@ -0,0 +1,34 @@
+/**
+ * @file server_epoll.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Servidor de un solo proceso basado en epoll
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef SERVER_EPOLL_H
+#define SERVER_EPOLL_H
+
+#include "../inc/buffer.h"
+
+#define EPOLL_MAX_EVENTOS 64 //Eventos atendidos por cada llamada a epoll_wait
+#define CONEXION_BUFFER_SIZE 16384 //Tamaño del buffer de recepción de cada conexión
+#define CONEXION_COLA_MENSAJES 64 //Mensajes pendientes como máximo en una conexión suscripta
+#define WS_PING_INTERVALO 30 //Segundos sin tramas del cliente WebSocket antes de enviarle un ping
+
+/**
+ * @brief Atiende a todos los clientes desde un único proceso
+ *
+ * Cada conexión es una máquina de estados (lectura, procesamiento, escritura)
+ * sobre sockets no bloqueantes. Las rutas son las mismas que en el modo fork.
+ *
+ * @param socket_id Socket en escucha
+ * @param buffer Buffer de memoria compartida con las muestras
+ * @return int -1 si hubo un error irrecuperable, no retorna en otro caso
+ */
+int server_epoll_run(int socket_id, shared_buffer *buffer);
+
+#endif // SERVER_EPOLL_H
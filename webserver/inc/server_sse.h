@@ -0,0 +1,54 @@
+/**
+ * @file server_sse.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Eventos Server-Sent Events (text/event-stream) de /stream
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef SERVER_SSE_H
+#define SERVER_SSE_H
+
+#include "../inc/http_parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SSE_EVENTO_SIZE 96 //Longitud máxima de un evento con una muestra
+#define SSE_REINTENTO_MS 2000 //Espera que el navegador usa antes de reconectarse
+
+/*Cabecera de la respuesta a /stream, la conexión queda abierta hasta que el cliente la cierre*/
+#define SSE_CABECERA "HTTP/1.1 200 OK\r\n" \
+                     "Content-Type: text/event-stream\r\n" \
+                     "Cache-Control: no-cache\r\n" \
+                     "Connection: keep-alive\r\n" \
+                     "\r\n"
+
+/**
+ * @brief Arma el evento de una muestra, con la secuencia como id
+ *
+ * Ej: "id: 42\ndata: {\"time\":41.014,\"temp\":23.50}\n\n"
+ *
+ * @param destino
+ * @param destino_size Al menos SSE_EVENTO_SIZE
+ * @param secuencia Número de la muestra
+ * @param tiempo_ns ns desde el inicio del buffer, se escriben segundos con milisegundos
+ * @param temp Temperatura en grados Celsius
+ * @return int Longitud del evento
+ */
+int server_sse_evento(char *destino, size_t destino_size, uint32_t secuencia, int64_t tiempo_ns, float temp);
+
+/**
+ * @brief Obtiene el id del último evento recibido por el cliente al reconectarse
+ *
+ * @param datos Buffer de recepción
+ * @param pedido Pedido completo
+ * @param id Valor de Last-Event-ID
+ * @return int 0 si la cabecera está y es un número, -1 si no
+ */
+int server_sse_ultimo_id(const char *datos, const http_pedido *pedido, uint32_t *id);
+
+#endif // SERVER_SSE_H
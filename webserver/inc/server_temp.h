@@ -9,9 +9,85 @@
  * 
  */
 
+#ifndef SERVER_TEMP_H
+#define SERVER_TEMP_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "../inc/buffer.h"
+
+#define SENSOR_ARCHIVO "/dev/bmp280_sitara" //Char device del driver
+#define SENSOR_COLA_MUESTRAS 64 //Profundidad de la cola de cada lector en el driver (BMP280_FIFO_DEPTH)
+#define SENSOR_LINEA_MAX 33 //Línea "tiempo_ns centésimas\n" más larga del driver con su '\0' (BMP280_LINE_MAX)
+#define SENSOR_LECTURA_SIZE (SENSOR_COLA_MUESTRAS * SENSOR_LINEA_MAX + 1) //Un read vacía la cola entera
+#define SENSOR_PERIODO_MS 1000 //Período de muestreo por defecto
+#define SENSOR_PERIODO_MIN_MS 14 //ODR del BMP280 como lo configura el driver (osrs_t x1, osrs_p x4, t_sb 0.5 ms)
+#define SENSOR_PERIODO_DRIVER 0 //Sin timer: cada muestra se lee apenas el driver la encola, con poll
+#define SENSOR_ESPERA_MS 2000 //Sin timer: si no llega ninguna muestra en este tiempo se cuenta un error
+
+/**
+ * @brief Muestreo periódico del sensor
+ * 
+ * El dispositivo se abre una sola vez, así el chip queda midiendo en modo
+ * normal y el filtro IIR no se reinicia: el driver lo calibra en el probe y
+ * lo pone a dormir cuando se cierra el último descriptor. El driver muestrea
+ * solo y encola cada muestra con su hora; el read no usa el bus, devuelve las
+ * encoladas desde el anterior. El período lo marca un timerfd con vencimientos
+ * absolutos, así el tiempo de lectura no se acumula como con sleep; conviene
+ * que no sea menor que el del driver (sampling_period_ms), si no hay
+ * vencimientos sin muestra nueva.
+ * 
+ * Con SENSOR_PERIODO_DRIVER no hay timer: se espera con poll a que el
+ * dispositivo sea legible, así cada muestra se lee microsegundos después de
+ * que el driver la encola y el período es el del driver.
+ */
+typedef struct sensor
+{
+    int fd; // -1 si el dispositivo no está abierto, se reintenta en cada lectura
+    int timer_fd; // -1 con SENSOR_PERIODO_DRIVER
+    int64_t periodo_ns;
+    struct timespec proximo; // Próximo vencimiento del timer (CLOCK_MONOTONIC)
+    int64_t tiempo_ns; // Hora de la última muestra según el driver, cuando la leyó del chip (CLOCK_MONOTONIC)
+    int64_t muestra_ns; // Hora del driver de la última lectura que trajo una muestra, 0 si todavía no hubo
+    int64_t retraso_ns; // De la última muestra: cuánto después del vencimiento (o de que la tomó el driver) empezó la lectura
+    int64_t lectura_ns; // De la última muestra: duración de la lectura
+    char lectura[SENSOR_LECTURA_SIZE];
+    double m2_retraso; // Suma de cuadrados de las diferencias del retraso (Welford)
+    buffer_muestreo muestreo;
+} sensor;
+
+/**
+ * @brief Abre el dispositivo y arranca el timer
+ * 
+ * Si el dispositivo no se puede abrir se informa y se sigue: cada lectura lo
+ * vuelve a intentar y mientras tanto devuelve -1.
+ * 
+ * @param s 
+ * @param periodo_ms Desde SENSOR_PERIODO_MIN_MS, o SENSOR_PERIODO_DRIVER
+ * @return int 0 si el timer quedó armado, -1 si hubo un error
+ */
+int sensor_abrir(sensor *s, int periodo_ms);
+
+/**
+ * @brief Espera el próximo vencimiento del timer, o la próxima muestra del driver, y lee la temperatura
+ * 
+ * Actualiza las estadísticas de s->muestreo: retraso respecto del
+ * vencimiento (sin timer, respecto de la hora de la muestra), duración de la
+ * lectura y períodos perdidos (sin timer, muestras del driver que quedaron
+ * atrás de otra más nueva).
+ * 
+ * @param s 
+ * @param temp Temperatura en °C, -1 si no se pudo leer
+ * @return int 0 si se leyó una muestra nueva, -1 si no (solo los errores se cuentan en s->muestreo)
+ */
+int sensor_muestrear(sensor *s, float *temp);
+
 /**
- * @brief Obtiene la temperatura del sensor
+ * @brief Cierra el dispositivo y el timer
  * 
- * @return float 
+ * @param s 
  */
-float get_temp(void);
+void sensor_cerrar(sensor *s);
+
+#endif // SERVER_TEMP_H
@@ -0,0 +1,101 @@
+/**
+ * @file server_websocket.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Protocolo WebSocket (RFC 6455) de /ws: handshake y tramas
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef SERVER_WEBSOCKET_H
+#define SERVER_WEBSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define WS_CLAVE_LEN 24 //Sec-WebSocket-Key: 16 bytes en base64
+#define WS_ACEPTAR_SIZE 29 //Sec-WebSocket-Accept: 20 bytes en base64 y el '\0'
+#define WS_CABECERA_MAX 10 //Cabecera más larga de una trama del servidor (sin máscara)
+#define WS_CONTROL_MAX 125 //Carga máxima de las tramas de control (ping, pong, cierre)
+#define WS_MENSAJE_MAX 1024 //Carga máxima aceptada en las tramas del cliente
+#define WS_REGISTRO_SIZE 16 //Bytes de cada muestra en las tramas binarias
+
+/*Códigos de cierre*/
+#define WS_CIERRE_NORMAL 1000
+#define WS_CIERRE_PROTOCOLO 1002
+#define WS_CIERRE_NO_SOPORTADO 1003
+#define WS_CIERRE_DEMASIADO_GRANDE 1009
+
+/**
+ * @brief Tipos de trama
+ */
+typedef enum ws_opcode
+{
+    WS_CONTINUACION = 0x0,
+    WS_TEXTO = 0x1,
+    WS_BINARIO = 0x2,
+    WS_CIERRE = 0x8,
+    WS_PING = 0x9,
+    WS_PONG = 0xA
+} ws_opcode;
+
+/**
+ * @brief Trama recibida del cliente, la carga ya sin máscara
+ */
+typedef struct ws_trama
+{
+    int fin; // 1 si es la última trama del mensaje
+    ws_opcode opcode;
+    size_t carga_inicio; // Desplazamiento de la carga desde el inicio de los datos
+    size_t carga_len;
+} ws_trama;
+
+/**
+ * @brief Calcula Sec-WebSocket-Accept: base64(SHA-1(clave + GUID))
+ *
+ * @param clave Valor de Sec-WebSocket-Key
+ * @param clave_len Longitud de la clave
+ * @param aceptar Destino de al menos WS_ACEPTAR_SIZE bytes
+ */
+void server_websocket_aceptar(const char *clave, size_t clave_len, char *aceptar);
+
+/**
+ * @brief Arma la cabecera de una trama del servidor (FIN, sin máscara)
+ *
+ * @param destino Al menos WS_CABECERA_MAX bytes
+ * @param opcode
+ * @param carga_len Longitud de la carga que sigue a la cabecera
+ * @return size_t Longitud de la cabecera
+ */
+size_t server_websocket_cabecera(uint8_t *destino, ws_opcode opcode, size_t carga_len);
+
+/**
+ * @brief Empaqueta una muestra en WS_REGISTRO_SIZE bytes
+ *
+ * Formato little-endian: secuencia (uint32), temperatura en grados Celsius
+ * (float32), tiempo en ns desde el inicio del buffer (int64). Una trama
+ * binaria lleva uno o más registros seguidos.
+ *
+ * @param destino
+ * @param secuencia
+ * @param tiempo_ns
+ * @param temp
+ */
+void server_websocket_registro(uint8_t *destino, uint32_t secuencia, int64_t tiempo_ns, float temp);
+
+/**
+ * @brief Decodifica la primera trama de los datos recibidos y le quita la máscara
+ *
+ * @param datos Datos recibidos, la carga se modifica en el lugar
+ * @param longitud Bytes válidos
+ * @param trama Trama decodificada
+ * @return ssize_t Bytes que ocupa la trama, 0 si está incompleta, -1 si viola el
+ * protocolo (sin máscara, control fragmentado o largo) o supera WS_MENSAJE_MAX;
+ * en el último caso trama->carga_len queda con el tamaño anunciado
+ */
+ssize_t server_websocket_decodificar(uint8_t *datos, size_t longitud, ws_trama *trama);
+
+#endif // SERVER_WEBSOCKET_H
@@ -0,0 +1,140 @@
+/**
+ * @file static_cache.h
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Cache en memoria de los archivos estáticos de public/
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include <stddef.h>
+
+#define STATIC_CACHE_DIR "public" //Directorio que se carga en la cache
+#define STATIC_CACHE_MAX_ENTRADAS 64 //Archivos como máximo en la cache
+#define STATIC_CACHE_RUTA_SIZE 256
+#define STATIC_CACHE_CABECERA_SIZE 384
+#define STATIC_CACHE_ETAG_SIZE 24
+#define STATIC_CACHE_SENDFILE_MIN 65536 //Archivos binarios desde este tamaño se envían con sendfile
+#define STATIC_CACHE_MAX_AGE 86400 //Segundos que el navegador usa el archivo sin revalidarlo
+
+/**
+ * @brief Codificaciones de contenido que puede tener un archivo
+ *
+ * Las variantes comprimidas se generan con "make comprimir" junto al
+ * original (ej: style.css.gz, style.css.br) y se cargan si no son más viejas.
+ */
+typedef enum static_codificacion
+{
+    STATIC_IDENTIDAD = 0,
+    STATIC_GZIP,
+    STATIC_BROTLI,
+    STATIC_CODIFICACIONES
+} static_codificacion;
+
+/**
+ * @brief Una representación del archivo con su cabecera HTTP ya armada
+ *
+ * Hay una cabecera para conexiones persistentes y otra para las que se
+ * cierran, ambas terminan en la línea vacía, así servir el archivo es un
+ * único writev de cabecera y cuerpo.
+ *
+ * También se arman las respuestas 304 para los pedidos con If-None-Match.
+ *
+ * Los archivos binarios grandes no se copian a memoria: se mantiene el
+ * archivo abierto y el cuerpo se envía con sendfile desde el page cache.
+ */
+typedef struct static_variante
+{
+    char etag[STATIC_CACHE_ETAG_SIZE]; // Con comillas, ej: "\"1a2b...\"", distinto en cada variante
+    char *cuerpo; // NULL si el cuerpo se envía con sendfile desde fd
+    size_t cuerpo_len;
+    int fd; // Archivo abierto para sendfile, -1 si está en memoria
+    char cabecera[2][STATIC_CACHE_CABECERA_SIZE]; // [0] keep-alive, [1] close
+    size_t cabecera_len[2];
+    char no_modificado[2][STATIC_CACHE_CABECERA_SIZE]; // Respuesta 304, [0] keep-alive, [1] close
+    size_t no_modificado_len[2];
+} static_variante;
+
+/**
+ * @brief Archivo de la cache con sus variantes comprimidas
+ */
+typedef struct static_entrada
+{
+    char ruta[STATIC_CACHE_RUTA_SIZE]; // Relativa al directorio, ej: "/css/style.css"
+    const char *content_type;
+    unsigned int codificaciones; // Variantes cargadas, bit (1 << static_codificacion)
+    static_variante variantes[STATIC_CODIFICACIONES];
+} static_entrada;
+
+/**
+ * @brief Generación de la cache, inmutable una vez cargada
+ *
+ * Cuando inotify avisa que cambió algún archivo se carga una generación nueva.
+ * La anterior se libera cuando ninguna respuesta en curso la referencia.
+ */
+typedef struct static_cache
+{
+    unsigned int referencias;
+    unsigned int n_entradas;
+    static_entrada entradas[STATIC_CACHE_MAX_ENTRADAS];
+} static_cache;
+
+/**
+ * @brief Carga todos los archivos del directorio y empieza a vigilarlo con inotify
+ *
+ * @param directorio
+ * @return int 0 si se cargó la cache, -1 si hubo un error
+ */
+int static_cache_iniciar(const char *directorio);
+
+/**
+ * @brief Descriptor de inotify, se vuelve legible cuando cambia algún archivo
+ *
+ * @return int
+ */
+int static_cache_fd(void);
+
+/**
+ * @brief Procesa los eventos de inotify pendientes (sin bloquear) y recarga si hace falta
+ */
+void static_cache_revisar(void);
+
+/**
+ * @brief Devuelve la generación actual y toma una referencia
+ *
+ * @return static_cache*
+ */
+static_cache *static_cache_obtener(void);
+
+/**
+ * @brief Suelta una referencia tomada con static_cache_obtener
+ *
+ * @param cache
+ */
+void static_cache_liberar(static_cache *cache);
+
+/**
+ * @brief Busca un archivo por su ruta relativa al directorio
+ *
+ * @param cache
+ * @param ruta Ruta, ej: "/css/style.css"
+ * @param ruta_len Longitud de la ruta
+ * @return const static_entrada* La entrada o NULL si no está
+ */
+const static_entrada *static_cache_buscar(const static_cache *cache, const char *ruta, size_t ruta_len);
+
+/**
+ * @brief Elige la variante más chica entre las que acepta el cliente
+ *
+ * @param entrada
+ * @param aceptadas Codificaciones aceptadas, bit (1 << static_codificacion)
+ * @return const static_variante* Nunca NULL, la identidad siempre está
+ */
+const static_variante *static_cache_variante(const static_entrada *entrada, unsigned int aceptadas);
+
+#endif // STATIC_CACHE_H
@@ -17,19 +17,43 @@
 #include <sys/shm.h>
 #include <errno.h>
 #include <sys/time.h>
-
-static float timedifference_msec(struct timeval t0, struct timeval t1);
-
-static struct timeval t0, t1;
+#include <time.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <string.h>
+#include <math.h>
+
+/* El anillo se indexa con una máscara y la secuencia se comparte entre procesos sin locks */
+_Static_assert((BUFFER_CAPACIDAD & BUFFER_MASCARA) == 0 && BUFFER_CAPACIDAD > BUFFER_SIZE, "BUFFER_CAPACIDAD debe ser potencia de 2");
+_Static_assert(ATOMIC_INT_LOCK_FREE == 2, "Se necesitan atómicos de 32 bits sin lock");
+
+static int64_t leer_reloj_ns(clockid_t reloj);
+static int leer_muestras(struct shared_buffer *buffer, uint32_t desde, unsigned int n, float *temp, int64_t *tiempo_ns);
+static uint32_t leer_ventana(struct shared_buffer *buffer, unsigned int n, float *temp, int64_t *tiempo_ns);
+static void actualizar_estadisticas(struct shared_buffer *buffer, uint32_t numero, float data);
+static void deque_agregar(struct shared_buffer *buffer, buffer_deque *deque, uint32_t numero, float data, int minimo);
+static float deque_frente(struct shared_buffer *buffer, const buffer_deque *deque);
+static void ordenadas_reemplazar(float *ordenadas, uint32_t cantidad, float saliente, float entrante);
+static float ordenadas_cuantil(const float *ordenadas, uint32_t cantidad, float q);
+
+/* Se vuelve legible con cada buffer_put, lo heredan los procesos hijos */
+static int aviso_fd = -1;
 
 int buffer_init(struct shared_buffer **buffer, int *shmid)
 {
-    int i = 0;
-    
     printf("Inicializando buffer de memoria compartida\n");
 
     /* Creamos la región de memoria compartida */
     *shmid = shmget(SHI_MEM_KEY, sizeof(struct shared_buffer), IPC_CREAT | 0666);
+
+    /* Si quedó una región de una versión anterior con otro tamaño se reemplaza */
+    if (*shmid < 0 && errno == EINVAL && (*shmid = shmget(SHI_MEM_KEY, 0, 0666)) >= 0)
+    {
+        shmctl(*shmid, IPC_RMID, NULL);
+        *shmid = shmget(SHI_MEM_KEY, sizeof(struct shared_buffer), IPC_CREAT | 0666);
+    }
+
     if (*shmid < 0)
     {
         fprintf(stderr, "Error en shmget\n");
@@ -45,62 +69,97 @@ int buffer_init(struct shared_buffer **buffer, int *shmid)
         return -1;
     }
 
-    /* Inicializamos el semáforo */
-
-    (*buffer)->sem = sem_open("sem", O_CREAT, 0644, 1);
 
-    if ((*buffer)->sem == SEM_FAILED)
+    /* Aviso de muestras nuevas para los clientes suscriptos */
+    aviso_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (aviso_fd < 0)
     {
-        fprintf(stderr, "Error en sem_open\n");
-        shmdt(*buffer); // Desmapeamos la memoria compartida
-        shmctl(*shmid, IPC_RMID, NULL); // Liberamos la memoria compartida
-        return -1;
+        fprintf(stderr, "Error en eventfd\n");
     }
-   
-    /* Inicializamos el buffer */
-    for (i = 0; i < BUFFER_SIZE; i++)
+
+    (*buffer)->arranque = (uint32_t)time(NULL);
+
+    /* Ancla de tiempo: los dos relojes leídos juntos, la hora real se deduce de la monotónica */
+    (*buffer)->ancla_monotonica_ns = leer_reloj_ns(CLOCK_MONOTONIC);
+    (*buffer)->ancla_real_ns = leer_reloj_ns(CLOCK_REALTIME);
+
+    /* Inicializamos el buffer, puede ser una región de una ejecución anterior */
+    memset((*buffer)->muestras, 0, sizeof((*buffer)->muestras));
+
+    for (unsigned int i = 0; i < BUFFER_CAPACIDAD; i++)
     {
-        (*buffer)->temp_celsius[i] = 0;
-        (*buffer)->time[i] = 0;
+        (*buffer)->muestras[i].tiempo_ns = (*buffer)->ancla_monotonica_ns;
     }
+    atomic_store(&(*buffer)->secuencia, 0);
 
-    /* Inicializamos el tiempo */
-    gettimeofday(&t0, 0);
+    memset(&(*buffer)->estadisticas, 0, sizeof((*buffer)->estadisticas));
+    memset(&(*buffer)->acumulado, 0, sizeof((*buffer)->acumulado));
+    (*buffer)->estadisticas.ewma_alfa = BUFFER_EWMA_ALFA;
+    atomic_store(&(*buffer)->version_estadisticas, 0);
+
+    memset(&(*buffer)->muestreo, 0, sizeof((*buffer)->muestreo));
+    atomic_store(&(*buffer)->version_muestreo, 0);
 
     printf("Buffer de memoria compartida inicializado\n");
 
     return 0;
 }
 
-int buffer_put(struct shared_buffer *buffer, float data)
+/**
+ * @brief Agrega una muestra al anillo, O(1) y sin bloquearse por los lectores
+ * 
+ * Solo la llama el proceso que lee el sensor (único escritor).
+ * 
+ * @param buffer 
+ * @param tiempo_ns Hora de la muestra (CLOCK_MONOTONIC), ej: buffer_ahora_ns()
+ * @param data Temperatura en grados Celsius
+ * @return int 
+ */
+int buffer_put(struct shared_buffer *buffer, int64_t tiempo_ns, float data)
 {
+    uint32_t numero;
+    buffer_muestra *muestra;
+
     if(buffer == NULL)
     {
         fprintf(stderr, "Error en buffer_put: NULL ptr\n"); 
         return -1;
     }
 
-    sem_wait(buffer->sem); // Esperamos a que el semáforo esté libre
+    // Escribimos la muestra en su lugar del anillo, todavía no es visible
+
+    numero = atomic_load_explicit(&buffer->secuencia, memory_order_relaxed) + 1;
+    muestra = &buffer->muestras[numero & BUFFER_MASCARA];
+
+    muestra->tiempo_ns = tiempo_ns;
+    muestra->temp_celsius = data;
+
+    // La publicamos: quien lea la secuencia nueva ve la muestra completa
+    atomic_store_explicit(&buffer->secuencia, numero, memory_order_release);
+
+    actualizar_estadisticas(buffer, numero, data);
 
-    // Actualizamos el buffer
-    // El buffer es de tipo FIFO
+    // La próxima muestra no puede empezar a pisar su lugar antes de que se vea esta secuencia
+    atomic_thread_fence(memory_order_seq_cst);
 
-    for (int i = 0; i < BUFFER_SIZE - 1; i++)
+    if (aviso_fd >= 0)
     {
-        buffer->temp_celsius[i] = buffer->temp_celsius[i + 1];
-        buffer->time[i] = buffer->time[i + 1];
-    }
+        uint64_t uno = 1;
 
-    gettimeofday(&t1, 0);
-    buffer->time[BUFFER_SIZE - 1] = timedifference_msec(t0, t1)*0.001;
-    buffer->temp_celsius[BUFFER_SIZE - 1] = data;
+        if (write(aviso_fd, &uno, sizeof(uno)) < 0)
+        {
+            fprintf(stderr, "Error al avisar la muestra nueva\n");
+        }
+    }
 
-    sem_post(buffer->sem); // Liberamos el semáforo
     return 0;
 }
 
 void print_buffer(struct shared_buffer *buffer)
 {
+    float temp[BUFFER_SIZE];
+    int64_t tiempo_ns[BUFFER_SIZE];
+
     printf("Imprimiendo buffer de memoria compartida\n");
 
     if(buffer == NULL)
@@ -109,21 +168,22 @@ void print_buffer(struct shared_buffer *buffer)
         return;
     }
 
-    sem_wait(buffer->sem); // Esperamos a que el semáforo esté libre
+    leer_ventana(buffer, BUFFER_SIZE, temp, tiempo_ns);
 
-    // Imprimimos el buffer
+    // Imprimimos la ventana
 
     for (int i = 0; i < BUFFER_SIZE; i++)
     {
-        printf("Temp: %f\n", buffer->temp_celsius[i]);
-        printf("Time: %f\n", buffer->time[i]);
+        printf("Temp: %f\n", temp[i]);
+        printf("Time: %.3f\n", buffer_desde_inicio_ns(buffer, tiempo_ns[i]) / 1e9);
     }
-
-    sem_post(buffer->sem); // Liberamos el semáforo
 }
 
 int buffer_get_temp(struct shared_buffer *buffer , unsigned int position, float *data)
 {
+    uint32_t numero;
+    int64_t descartado;
+
     if(data == NULL)
     {
         fprintf(stderr, "Error en buffer_get\n");      
@@ -136,21 +196,28 @@ int buffer_get_temp(struct shared_buffer *buffer , unsigned int position, float
         return -1;
     }
 
-    sem_wait(buffer->sem); // Esperamos a que el semáforo esté libre
-
-    // Leemos el buffer
-    // El buffer es de tipo FIFO
+    if(position >= BUFFER_SIZE)
+    {
+        fprintf(stderr, "Error en buffer_get: posicion fuera de la ventana\n");
+        return -1;
+    }
 
-    *data = buffer->temp_celsius[position];
+    // La posición es dentro de la ventana, 0 es la muestra más vieja
 
-    sem_post(buffer->sem); // Liberamos el semáforo
+    do
+    {
+        numero = atomic_load_explicit(&buffer->secuencia, memory_order_acquire) - (BUFFER_SIZE - 1) + position;
+    } while (leer_muestras(buffer, numero, 1, data, &descartado) < 0);
 
     return 0;
 }
 
-int buffer_get_time(struct shared_buffer *buffer , unsigned int position, float *data)
+int buffer_get_time(struct shared_buffer *buffer , unsigned int position, int64_t *tiempo_ns)
 {
-    if(data == NULL)
+    uint32_t numero;
+    float descartado;
+
+    if(tiempo_ns == NULL)
     {
         fprintf(stderr, "Error en buffer_get\n");      
         return -1;
@@ -162,20 +229,242 @@ int buffer_get_time(struct shared_buffer *buffer , unsigned int position, float
         return -1;
     }
 
-    sem_wait(buffer->sem); // Esperamos a que el semáforo esté libre
+    if(position >= BUFFER_SIZE)
+    {
+        fprintf(stderr, "Error en buffer_get: posicion fuera de la ventana\n");
+        return -1;
+    }
 
-    // Leemos el buffer
-    // El buffer es de tipo FIFO
+    // La posición es dentro de la ventana, 0 es la muestra más vieja
 
-    *data = buffer->time[position];
+    do
+    {
+        numero = atomic_load_explicit(&buffer->secuencia, memory_order_acquire) - (BUFFER_SIZE - 1) + position;
+    } while (leer_muestras(buffer, numero, 1, &descartado, tiempo_ns) < 0);
 
-    sem_post(buffer->sem); // Liberamos el semáforo
+    return 0;
+}
+
+/**
+ * @brief Obtiene la cantidad de muestras escritas, cambia cada vez que cambia el buffer
+ * 
+ * @param buffer 
+ * @param arranque Hora de inicio del buffer
+ * @param secuencia Muestras escritas desde el inicio
+ * @return int 
+ */
+int buffer_get_secuencia(struct shared_buffer *buffer, uint32_t *arranque, uint32_t *secuencia)
+{
+    if(buffer == NULL || arranque == NULL || secuencia == NULL)
+    {
+        fprintf(stderr, "Error en buffer_get_secuencia\n");
+        return -1;
+    }
+
+    *arranque = buffer->arranque;
+    *secuencia = atomic_load_explicit(&buffer->secuencia, memory_order_acquire);
 
     return 0;
 }
 
 /**
- * @brief Calcula el promedio de los datos del buffer
+ * @brief Copia las últimas n muestras de una sola vez, todas de un mismo instante
+ * 
+ * No toma ningún lock: las lecturas se validan con la secuencia (como un
+ * seqlock) y solo se repiten si el escritor pisó algo mientras se copiaba.
+ * Las posiciones anteriores a la primera muestra quedan en 0 °C en el
+ * instante del ancla (0 desde el inicio).
+ * 
+ * @param buffer 
+ * @param n Muestras a copiar, hasta BUFFER_SNAPSHOT_MAX
+ * @param temp Vector de n temperaturas, la última es la más nueva
+ * @param tiempo_ns Vector de n horas (CLOCK_MONOTONIC en ns)
+ * @param arranque Hora de inicio del buffer, puede ser NULL
+ * @param secuencia Número de la última muestra copiada
+ * @return int 
+ */
+int buffer_snapshot(struct shared_buffer *buffer, unsigned int n, float *temp, int64_t *tiempo_ns, uint32_t *arranque, uint32_t *secuencia)
+{
+    if(buffer == NULL || temp == NULL || tiempo_ns == NULL || secuencia == NULL || n == 0 || n > BUFFER_SNAPSHOT_MAX)
+    {
+        fprintf(stderr, "Error en buffer_snapshot\n");
+        return -1;
+    }
+
+    if (arranque != NULL)
+    {
+        *arranque = buffer->arranque;
+    }
+
+    *secuencia = leer_ventana(buffer, n, temp, tiempo_ns);
+
+    return 0;
+}
+
+/**
+ * @brief Hora actual en el reloj de las muestras (CLOCK_MONOTONIC en ns)
+ * 
+ * @return int64_t 
+ */
+int64_t buffer_ahora_ns(void)
+{
+    return leer_reloj_ns(CLOCK_MONOTONIC);
+}
+
+/**
+ * @brief Tiempo de una muestra desde el inicio del buffer
+ * 
+ * @param buffer 
+ * @param tiempo_ns Hora de la muestra (CLOCK_MONOTONIC)
+ * @return int64_t ns desde buffer_init
+ */
+int64_t buffer_desde_inicio_ns(const struct shared_buffer *buffer, int64_t tiempo_ns)
+{
+    return tiempo_ns - buffer->ancla_monotonica_ns;
+}
+
+/**
+ * @brief Hora real de una muestra con el ancla del buffer
+ * 
+ * Las muestras quedan a la distancia que marcó el reloj monotónico aunque
+ * después se cambie la hora del sistema.
+ * 
+ * @param buffer 
+ * @param tiempo_ns Hora de la muestra (CLOCK_MONOTONIC)
+ * @return int64_t ns desde 1970
+ */
+int64_t buffer_tiempo_real_ns(const struct shared_buffer *buffer, int64_t tiempo_ns)
+{
+    return buffer->ancla_real_ns + (tiempo_ns - buffer->ancla_monotonica_ns);
+}
+
+/**
+ * @brief Descriptor que se vuelve legible cuando hay muestras nuevas
+ * 
+ * Es un eventfd: al leerlo se obtiene la cantidad de avisos pendientes.
+ * 
+ * @return int -1 si no se pudo crear
+ */
+int buffer_aviso_fd(void)
+{
+    return aviso_fd;
+}
+
+/**
+ * @brief Copia las estadísticas de la ventana sin tocar las muestras
+ * 
+ * Se validan con la versión igual que un seqlock: solo se repite la copia
+ * si el escritor las estaba actualizando.
+ * 
+ * @param buffer 
+ * @param estadisticas 
+ * @return int 
+ */
+int buffer_get_estadisticas(struct shared_buffer *buffer, buffer_estadisticas *estadisticas)
+{
+    uint32_t version;
+
+    if(buffer == NULL || estadisticas == NULL)
+    {
+        fprintf(stderr, "Error en buffer_get_estadisticas\n");
+        return -1;
+    }
+
+    do
+    {
+        version = atomic_load_explicit(&buffer->version_estadisticas, memory_order_acquire);
+
+        *estadisticas = buffer->estadisticas;
+
+        // La copia no puede quedar después de la segunda lectura de la versión
+        atomic_thread_fence(memory_order_acquire);
+    } while ((version & 1) || version != atomic_load_explicit(&buffer->version_estadisticas, memory_order_relaxed));
+
+    return 0;
+}
+
+/**
+ * @brief Cambia el peso de la muestra nueva en el promedio exponencial
+ * 
+ * Se llama antes de empezar a cargar muestras.
+ * 
+ * @param buffer 
+ * @param alfa Entre 0 (no cambia) y 1 (solo la última muestra)
+ * @return int 
+ */
+int buffer_set_ewma_alfa(struct shared_buffer *buffer, float alfa)
+{
+    if(buffer == NULL || !(alfa > 0 && alfa <= 1))
+    {
+        fprintf(stderr, "Error en buffer_set_ewma_alfa\n");
+        return -1;
+    }
+
+    buffer->estadisticas.ewma_alfa = alfa;
+
+    return 0;
+}
+
+/**
+ * @brief Copia las estadísticas del muestreo, igual que buffer_get_estadisticas
+ * 
+ * @param buffer 
+ * @param muestreo 
+ * @return int 
+ */
+int buffer_get_muestreo(struct shared_buffer *buffer, buffer_muestreo *muestreo)
+{
+    uint32_t version;
+
+    if(buffer == NULL || muestreo == NULL)
+    {
+        fprintf(stderr, "Error en buffer_get_muestreo\n");
+        return -1;
+    }
+
+    do
+    {
+        version = atomic_load_explicit(&buffer->version_muestreo, memory_order_acquire);
+
+        *muestreo = buffer->muestreo;
+
+        atomic_thread_fence(memory_order_acquire);
+    } while ((version & 1) || version != atomic_load_explicit(&buffer->version_muestreo, memory_order_relaxed));
+
+    return 0;
+}
+
+/**
+ * @brief Publica las estadísticas del muestreo (solo el proceso que lee el sensor)
+ * 
+ * @param buffer 
+ * @param muestreo 
+ * @return int 
+ */
+int buffer_set_muestreo(struct shared_buffer *buffer, const buffer_muestreo *muestreo)
+{
+    uint32_t version;
+
+    if(buffer == NULL || muestreo == NULL)
+    {
+        fprintf(stderr, "Error en buffer_set_muestreo\n");
+        return -1;
+    }
+
+    version = atomic_load_explicit(&buffer->version_muestreo, memory_order_relaxed);
+
+    atomic_store_explicit(&buffer->version_muestreo, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    buffer->muestreo = *muestreo;
+
+    atomic_store_explicit(&buffer->version_muestreo, version + 2, memory_order_release);
+
+    return 0;
+}
+
+/**
+ * @brief Promedio de la ventana, O(1): lo mantiene buffer_put
  * 
  * @param buffer 
  * @param data 
@@ -183,7 +472,7 @@ int buffer_get_time(struct shared_buffer *buffer , unsigned int position, float
  */
 int buffer_avg(struct shared_buffer *buffer, float *data)
 {
-    float sum = 0;
+    buffer_estadisticas estadisticas;
 
     if(data == NULL)
     {
@@ -197,18 +486,9 @@ int buffer_avg(struct shared_buffer *buffer, float *data)
         return -1;
     }
 
-    sem_wait(buffer->sem); // Esperamos a que el semáforo esté libre
-
-    // Calculamos el promedio
-
-    for (int i = 0; i < BUFFER_SIZE; i++)
-    {
-        sum += buffer->temp_celsius[i];
-    }
-
-    sem_post(buffer->sem); // Liberamos el semáforo
+    buffer_get_estadisticas(buffer, &estadisticas);
 
-    *data = sum / BUFFER_SIZE;
+    *data = estadisticas.media;
 
     return 0;
 }
@@ -216,9 +496,11 @@ int buffer_avg(struct shared_buffer *buffer, float *data)
 void buffer_destroy(struct shared_buffer **buffer, int shmid)
 {
 
-    sem_close((*buffer)->sem); // Cerramos el semáforo
-    
-    sem_unlink("sem"); // Eliminamos el semáforo
+    if (aviso_fd >= 0)
+    {
+        close(aviso_fd);
+        aviso_fd = -1;
+    }
 
     shmdt(*buffer); // Desmapeamos la memoria compartida
 
@@ -230,7 +512,207 @@ void buffer_destroy(struct shared_buffer **buffer, int shmid)
 }
 
 
-static float timedifference_msec(struct timeval t0, struct timeval t1)
+static int64_t leer_reloj_ns(clockid_t reloj)
+{
+    struct timespec ts;
+
+    clock_gettime(reloj, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Copia n muestras consecutivas sin bloquear al escritor
+ * 
+ * La muestra desde se pisa cuando el escritor empieza a escribir la número
+ * desde + BUFFER_CAPACIDAD, o sea cuando la secuencia llega a
+ * desde + BUFFER_CAPACIDAD - 1. Si después de copiar la secuencia no llegó
+ * ahí, nada de lo copiado se pisó.
+ * 
+ * @param desde Número de la primera muestra
+ * @param n Cantidad, menor que BUFFER_CAPACIDAD
+ * @return int 0 si la copia es consistente, -1 si hay que repetirla
+ */
+static int leer_muestras(struct shared_buffer *buffer, uint32_t desde, unsigned int n, float *temp, int64_t *tiempo_ns)
+{
+    uint32_t secuencia;
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const buffer_muestra *muestra = &buffer->muestras[(desde + i) & BUFFER_MASCARA];
+
+        temp[i] = muestra->temp_celsius;
+        tiempo_ns[i] = muestra->tiempo_ns;
+    }
+
+    // Las lecturas de las muestras no pueden quedar después de la de la secuencia
+    atomic_thread_fence(memory_order_acquire);
+    secuencia = atomic_load_explicit(&buffer->secuencia, memory_order_relaxed);
+
+    return (uint32_t)(secuencia - desde) < BUFFER_CAPACIDAD - 1 ? 0 : -1;
+}
+
+/**
+ * @brief Copia las últimas n muestras, repitiendo si el escritor las pisó
+ * 
+ * @return uint32_t Secuencia de la última muestra copiada
+ */
+static uint32_t leer_ventana(struct shared_buffer *buffer, unsigned int n, float *temp, int64_t *tiempo_ns)
+{
+    uint32_t secuencia;
+
+    do
+    {
+        secuencia = atomic_load_explicit(&buffer->secuencia, memory_order_acquire);
+    } while (leer_muestras(buffer, secuencia - (n - 1), n, temp, tiempo_ns) < 0);
+
+    return secuencia;
+}
+
+/**
+ * @brief Actualiza las estadísticas con la muestra numero, O(1)
+ * 
+ * Con la ventana llena la muestra nueva reemplaza a la número
+ * numero - BUFFER_SIZE: media y varianza se corrigen con la diferencia
+ * entre las dos (Welford con ventana deslizante) y el mínimo y el máximo
+ * salen del frente de sus colas monótonas.
+ */
+static void actualizar_estadisticas(struct shared_buffer *buffer, uint32_t numero, float data)
 {
-    return (t1.tv_sec - t0.tv_sec) * 1000.0f + (t1.tv_usec - t0.tv_usec) / 1000.0f;
-}
\ No newline at end of file
+    buffer_acumulado *acumulado = &buffer->acumulado;
+    buffer_estadisticas *estadisticas = &buffer->estadisticas;
+    uint32_t cantidad = estadisticas->cantidad;
+    uint32_t version = atomic_load_explicit(&buffer->version_estadisticas, memory_order_relaxed);
+    double media_anterior = acumulado->media;
+    double saliente;
+
+    if (cantidad < BUFFER_SIZE)
+    {
+        // La posición libre al final hace de saliente más grande que todas
+        acumulado->ordenadas[cantidad] = INFINITY;
+        ordenadas_reemplazar(acumulado->ordenadas, cantidad + 1, INFINITY, data);
+        cantidad++;
+        acumulado->media += (data - media_anterior) / cantidad;
+        acumulado->m2 += (data - media_anterior) * (data - acumulado->media);
+        acumulado->ewma = (cantidad == 1) ? data : acumulado->ewma;
+    }
+    else
+    {
+        saliente = buffer->muestras[(numero - BUFFER_SIZE) & BUFFER_MASCARA].temp_celsius;
+        acumulado->media += (data - saliente) / BUFFER_SIZE;
+        acumulado->m2 += (data - saliente) * (data - acumulado->media + saliente - media_anterior);
+        ordenadas_reemplazar(acumulado->ordenadas, cantidad, saliente, data);
+    }
+
+    acumulado->ewma += estadisticas->ewma_alfa * (data - acumulado->ewma);
+
+    deque_agregar(buffer, &acumulado->minimos, numero, data, 1);
+    deque_agregar(buffer, &acumulado->maximos, numero, data, 0);
+
+    // Publicación: versión impar mientras se escribe
+    atomic_store_explicit(&buffer->version_estadisticas, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    estadisticas->secuencia = numero;
+    estadisticas->cantidad = cantidad;
+    estadisticas->media = acumulado->media;
+    estadisticas->minimo = deque_frente(buffer, &acumulado->minimos);
+    estadisticas->maximo = deque_frente(buffer, &acumulado->maximos);
+    // El redondeo acumulado puede dejar m2 apenas negativo
+    estadisticas->desvio = (acumulado->m2 > 0) ? sqrt(acumulado->m2 / cantidad) : 0;
+    estadisticas->ewma = acumulado->ewma;
+    estadisticas->p50 = ordenadas_cuantil(acumulado->ordenadas, cantidad, 0.50f);
+    estadisticas->p95 = ordenadas_cuantil(acumulado->ordenadas, cantidad, 0.95f);
+    estadisticas->p99 = ordenadas_cuantil(acumulado->ordenadas, cantidad, 0.99f);
+
+    atomic_store_explicit(&buffer->version_estadisticas, version + 2, memory_order_release);
+}
+
+/**
+ * @brief Cambia saliente por entrante en la ventana ordenada, O(BUFFER_SIZE)
+ *
+ * Se saca saliente corriendo los mayores hacia atrás y se inserta entrante
+ * corriendo los que le siguen, sin volver a ordenar.
+ */
+static void ordenadas_reemplazar(float *ordenadas, uint32_t cantidad, float saliente, float entrante)
+{
+    uint32_t i = 0;
+
+    while (i + 1 < cantidad && ordenadas[i] != saliente)
+    {
+        i++;
+    }
+
+    // Hueco en i: se mueve hacia donde va entrante
+    while (i > 0 && ordenadas[i - 1] > entrante)
+    {
+        ordenadas[i] = ordenadas[i - 1];
+        i--;
+    }
+
+    while (i + 1 < cantidad && ordenadas[i + 1] < entrante)
+    {
+        ordenadas[i] = ordenadas[i + 1];
+        i++;
+    }
+
+    ordenadas[i] = entrante;
+}
+
+/**
+ * @brief Cuantil q de la ventana ordenada, interpolando entre vecinas
+ */
+static float ordenadas_cuantil(const float *ordenadas, uint32_t cantidad, float q)
+{
+    float posicion = q * (cantidad - 1);
+    uint32_t i = (uint32_t)posicion;
+
+    if (i + 1 >= cantidad)
+    {
+        return ordenadas[cantidad - 1];
+    }
+
+    return ordenadas[i] + (ordenadas[i + 1] - ordenadas[i]) * (posicion - i);
+}
+
+/**
+ * @brief Agrega la muestra numero a una cola monótona y descarta las que salieron de la ventana
+ * 
+ * Las muestras que nunca van a ser el mínimo (o el máximo) porque hay una
+ * más nueva menor (o mayor) se sacan del fondo: cada muestra entra y sale
+ * una sola vez, O(1) amortizado.
+ * 
+ * @param minimo 1 para la cola del mínimo, 0 para la del máximo
+ */
+static void deque_agregar(struct shared_buffer *buffer, buffer_deque *deque, uint32_t numero, float data, int minimo)
+{
+    uint32_t fondo;
+    float valor;
+
+    if (deque->largo > 0 && (uint32_t)(numero - deque->numeros[deque->cabeza]) >= BUFFER_SIZE)
+    {
+        deque->cabeza = (deque->cabeza + 1) % BUFFER_SIZE;
+        deque->largo--;
+    }
+
+    while (deque->largo > 0)
+    {
+        fondo = deque->numeros[(deque->cabeza + deque->largo - 1) % BUFFER_SIZE];
+        valor = buffer->muestras[fondo & BUFFER_MASCARA].temp_celsius;
+
+        if (minimo ? valor < data : valor > data)
+        {
+            break;
+        }
+
+        deque->largo--;
+    }
+
+    deque->numeros[(deque->cabeza + deque->largo) % BUFFER_SIZE] = numero;
+    deque->largo++;
+}
+
+static float deque_frente(struct shared_buffer *buffer, const buffer_deque *deque)
+{
+    return buffer->muestras[deque->numeros[deque->cabeza] & BUFFER_MASCARA].temp_celsius;
+}
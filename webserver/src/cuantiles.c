@@ -0,0 +1,247 @@
+/**
+ * @file cuantiles.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Estimación de cuantiles en línea con un t-digest de tamaño fijo
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/cuantiles.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*Compresión: con la función de escala k1 salen como mucho delta + 2 centroides*/
+#define CUANTILES_DELTA (CUANTILES_CENTROIDES - 2)
+
+/*Lo más que se compacta de una vez: los centroides y pendientes de dos resúmenes*/
+#define CUANTILES_TEMPORALES (2 * (CUANTILES_CENTROIDES + CUANTILES_PENDIENTES))
+
+/*Funciones privadas*/
+
+static void compactar(cuantiles_digest *digest, const cuantiles_digest *otro);
+static int comparar_centroides(const void *a, const void *b);
+static double escala(double q);
+static double escala_inversa(double k);
+
+/*Funciones de la biblioteca*/
+
+void cuantiles_iniciar(cuantiles_digest *digest)
+{
+    digest->total = 0;
+    digest->n_centroides = 0;
+    digest->n_pendientes = 0;
+    digest->minimo = 0;
+    digest->maximo = 0;
+}
+
+void cuantiles_agregar(cuantiles_digest *digest, float valor)
+{
+    if (digest->total == 0 || valor < digest->minimo)
+    {
+        digest->minimo = valor;
+    }
+    if (digest->total == 0 || valor > digest->maximo)
+    {
+        digest->maximo = valor;
+    }
+
+    digest->pendientes[digest->n_pendientes++] = valor;
+    digest->total++;
+
+    if (digest->n_pendientes == CUANTILES_PENDIENTES)
+    {
+        compactar(digest, NULL);
+    }
+}
+
+void cuantiles_unir(cuantiles_digest *destino, const cuantiles_digest *origen)
+{
+    if (origen->total == 0)
+    {
+        return;
+    }
+
+    if (destino->total == 0 || origen->minimo < destino->minimo)
+    {
+        destino->minimo = origen->minimo;
+    }
+    if (destino->total == 0 || origen->maximo > destino->maximo)
+    {
+        destino->maximo = origen->maximo;
+    }
+
+    destino->total += origen->total;
+
+    compactar(destino, origen);
+}
+
+float cuantiles_valor(cuantiles_digest *digest, double q)
+{
+    const cuantiles_centroide *c = digest->centroides;
+    uint32_t n;
+    double objetivo;
+    double acumulado;
+    double tramo;
+
+    if (digest->n_pendientes > 0)
+    {
+        compactar(digest, NULL);
+    }
+
+    n = digest->n_centroides;
+
+    if (digest->total == 0)
+    {
+        return NAN;
+    }
+
+    if (q <= 0)
+    {
+        return digest->minimo;
+    }
+
+    if (q >= 1)
+    {
+        return digest->maximo;
+    }
+
+    // Cada centroide se toma centrado en su media: la mitad de su peso de
+    // cada lado, entre un centro y el siguiente se interpola lineal
+    objetivo = q * digest->total;
+    acumulado = c[0].peso / 2.0;
+
+    if (objetivo < acumulado)
+    {
+        return digest->minimo + (c[0].media - digest->minimo) * (objetivo / acumulado);
+    }
+
+    for (uint32_t i = 0; i + 1 < n; i++)
+    {
+        tramo = (c[i].peso + c[i + 1].peso) / 2.0;
+
+        if (objetivo < acumulado + tramo)
+        {
+            return c[i].media + (c[i + 1].media - c[i].media) * ((objetivo - acumulado) / tramo);
+        }
+
+        acumulado += tramo;
+    }
+
+    tramo = c[n - 1].peso / 2.0;
+
+    return c[n - 1].media + (digest->maximo - c[n - 1].media) * fmin(1.0, (objetivo - acumulado) / tramo);
+}
+
+/*Funciones privadas*/
+
+/**
+ * @brief Junta centroides, pendientes y opcionalmente otro resumen en los
+ * centroides de digest
+ *
+ * Se ordena todo por media y se recorre una vez: cada elemento se suma al
+ * centroide actual mientras el centroide no abarque más de una unidad de la
+ * escala k1, que es angosta cerca de q = 0 y q = 1 (centroides chicos en las
+ * colas) y ancha en el medio.
+ *
+ * @param otro Resumen a unir, NULL para compactar solo digest; su total ya
+ * tiene que estar sumado a digest->total
+ */
+static void compactar(cuantiles_digest *digest, const cuantiles_digest *otro)
+{
+    cuantiles_centroide temporales[CUANTILES_TEMPORALES];
+    uint32_t n = 0;
+    double total = digest->total;
+    double acumulado = 0;
+    double limite;
+    double media;
+    uint32_t peso;
+
+    memcpy(temporales, digest->centroides, digest->n_centroides * sizeof(cuantiles_centroide));
+    n = digest->n_centroides;
+
+    for (uint32_t i = 0; i < digest->n_pendientes; i++)
+    {
+        temporales[n].media = digest->pendientes[i];
+        temporales[n++].peso = 1;
+    }
+
+    if (otro != NULL)
+    {
+        memcpy(temporales + n, otro->centroides, otro->n_centroides * sizeof(cuantiles_centroide));
+        n += otro->n_centroides;
+
+        for (uint32_t i = 0; i < otro->n_pendientes; i++)
+        {
+            temporales[n].media = otro->pendientes[i];
+            temporales[n++].peso = 1;
+        }
+    }
+
+    digest->n_pendientes = 0;
+    digest->n_centroides = 0;
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    qsort(temporales, n, sizeof(cuantiles_centroide), comparar_centroides);
+
+    media = temporales[0].media;
+    peso = temporales[0].peso;
+    limite = total * escala_inversa(escala(0) + 1);
+
+    for (uint32_t i = 1; i < n; i++)
+    {
+        // El último centroide absorbe lo que sobre si no hay más lugar
+        if (acumulado + peso + temporales[i].peso <= limite || digest->n_centroides == CUANTILES_CENTROIDES - 1)
+        {
+            peso += temporales[i].peso;
+            media += (temporales[i].media - media) * temporales[i].peso / peso;
+            continue;
+        }
+
+        digest->centroides[digest->n_centroides].media = media;
+        digest->centroides[digest->n_centroides++].peso = peso;
+
+        acumulado += peso;
+        limite = total * escala_inversa(escala(acumulado / total) + 1);
+
+        media = temporales[i].media;
+        peso = temporales[i].peso;
+    }
+
+    digest->centroides[digest->n_centroides].media = media;
+    digest->centroides[digest->n_centroides++].peso = peso;
+}
+
+static int comparar_centroides(const void *a, const void *b)
+{
+    float media_a = ((const cuantiles_centroide *)a)->media;
+    float media_b = ((const cuantiles_centroide *)b)->media;
+
+    return (media_a > media_b) - (media_a < media_b);
+}
+
+/**
+ * @brief Función de escala k1 del t-digest: k(q) = delta / (2 pi) * asin(2q - 1)
+ */
+static double escala(double q)
+{
+    return CUANTILES_DELTA / (2 * M_PI) * asin(2 * q - 1);
+}
+
+static double escala_inversa(double k)
+{
+    if (k >= CUANTILES_DELTA / 4.0)
+    {
+        return 1;
+    }
+
+    return (sin(k * 2 * M_PI / CUANTILES_DELTA) + 1) / 2;
+}
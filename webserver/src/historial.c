@@ -0,0 +1,1066 @@
+/**
+ * @file historial.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Historial de temperaturas persistente en un archivo mapeado en memoria
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/historial.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HISTORIAL_MAGIA "BTHIST01"
+#define INDICE_SIZE (HISTORIAL_MAX_BLOQUES * sizeof(historial_indice)) //Bytes del índice, después de la cabecera
+#define AGREGADOS_SIZE ((HISTORIAL_MINUTOS + HISTORIAL_HORAS + HISTORIAL_DIAS) * sizeof(historial_agregado)) //Bytes de los anillos de agregados, después del índice
+#define CUANTILES_SIZE ((HISTORIAL_HORAS + HISTORIAL_DIAS) * sizeof(historial_cuantiles)) //Bytes de los anillos de cuantiles, después de los agregados
+#define AGREGADO_REINTENTOS 64 //Lecturas de un agregado que se está actualizando antes de descartarlo
+#define AGREGADOS_RECALCULO_MS (10 * 60 * 1000) //Al abrir se recalculan los agregados desde el día de la última muestra menos este margen
+
+_Static_assert(sizeof(historial_bloque) == HISTORIAL_BLOQUE_SIZE, "El bloque debe ocupar HISTORIAL_BLOQUE_SIZE");
+_Static_assert(sizeof(historial_cabecera) == HISTORIAL_BLOQUE_SIZE, "La cabecera debe ocupar HISTORIAL_BLOQUE_SIZE");
+_Static_assert(INDICE_SIZE % HISTORIAL_BLOQUE_SIZE == 0, "Los agregados deben quedar alineados a página después del índice");
+_Static_assert(AGREGADOS_SIZE % HISTORIAL_BLOQUE_SIZE == 0, "Los cuantiles deben quedar alineados a página después de los agregados");
+_Static_assert(CUANTILES_SIZE % HISTORIAL_BLOQUE_SIZE == 0, "Los bloques deben quedar alineados a página después de los cuantiles");
+
+/// @brief Intervalos de una consulta
+typedef struct consulta
+{
+    int64_t desde_ms; // Inicio del intervalo 0
+    int64_t paso_ms;
+    historial_punto *puntos;
+    cuantiles_digest *digestos; // NULL si no se piden cuantiles
+} consulta;
+
+/*Variables privadas*/
+
+/// @brief Ancho de los períodos de cada nivel, en ms
+static const int64_t ancho_nivel[HISTORIAL_NIVELES] = {60 * 1000, 60 * 60 * 1000, 24 * 60 * 60 * 1000};
+
+/// @brief Períodos que guarda el anillo de cada nivel
+static const uint32_t capacidad_nivel[HISTORIAL_NIVELES] = {HISTORIAL_MINUTOS, HISTORIAL_HORAS, HISTORIAL_DIAS};
+
+/*Funciones privadas*/
+
+static size_t tamanio_archivo(uint32_t bloques);
+static int crecer(historial *h, uint32_t bloques);
+static int crear(historial *h);
+static historial_bloque *bloque_numero(const historial *h, uint32_t numero);
+static int bloque_valido(const historial *h, uint32_t numero);
+static void recuperar_cola(historial *h);
+static void recuperar_indice(historial *h);
+static void recuperar_agregados(historial *h);
+static int empezar_bloque(historial *h, int64_t tiempo_ms);
+static void indexar(historial *h, uint32_t numero);
+static int leer_indice(const historial *h, uint32_t numero, historial_indice *copia);
+static void acumular(historial_punto *punto, double suma, double suma_cuadrados, float minimo, float maximo,
+                     uint32_t cantidad);
+static uint32_t primer_bloque(const historial *h, uint32_t primero, uint32_t total, int64_t desde_ms);
+static void consultar_bloques(const historial *h, int64_t desde_ms, int64_t hasta_ms, const consulta *c);
+static uint64_t contar_muestras(const historial *h, int64_t desde_ms, int64_t hasta_ms);
+static int sumar_indice(const historial_indice *entrada, int64_t desde_ms, int64_t hasta_ms, const consulta *c);
+static void recorrer_bloque(const historial *h, uint32_t numero, int64_t desde_ms, int64_t hasta_ms, const consulta *c);
+static void sumar_agregados(const historial *h, historial_nivel nivel, uint32_t primero, uint32_t ultimo,
+                            const consulta *c);
+static int leer_versionado(_Atomic uint32_t *version, _Atomic uint32_t *marca, uint32_t periodo, void *copia,
+                           const void *datos, size_t longitud);
+static void empezar_escritura(_Atomic uint32_t *version);
+static void terminar_escritura(_Atomic uint32_t *version);
+static void agregar_niveles(historial *h, int64_t tiempo_ms, float valor);
+
+/*Funciones de la biblioteca*/
+
+int historial_abrir(historial *h, const char *ruta)
+{
+    struct stat info;
+    historial_cabecera *cabecera;
+
+    h->cabecera = MAP_FAILED;
+
+    if ((h->fd = open(ruta, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+    {
+        perror("Error al abrir el historial");
+        return -1;
+    }
+
+    if (fstat(h->fd, &info) < 0)
+    {
+        perror("Error en fstat del historial");
+        close(h->fd);
+        return -1;
+    }
+
+    // Se reserva el espacio de direcciones para el tamaño máximo, el archivo crece debajo
+    h->cabecera = mmap(NULL, tamanio_archivo(HISTORIAL_MAX_BLOQUES), PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+
+    if (h->cabecera == MAP_FAILED)
+    {
+        perror("Error en mmap del historial");
+        close(h->fd);
+        return -1;
+    }
+
+    cabecera = h->cabecera;
+    h->indice = (historial_indice *)(cabecera + 1);
+    h->agregados[HISTORIAL_MINUTO] = (historial_agregado *)((char *)h->indice + INDICE_SIZE);
+    h->agregados[HISTORIAL_HORA] = h->agregados[HISTORIAL_MINUTO] + HISTORIAL_MINUTOS;
+    h->agregados[HISTORIAL_DIA] = h->agregados[HISTORIAL_HORA] + HISTORIAL_HORAS;
+    h->cuantiles[HISTORIAL_MINUTO] = NULL;
+    h->cuantiles[HISTORIAL_HORA] = (historial_cuantiles *)(h->agregados[HISTORIAL_DIA] + HISTORIAL_DIAS);
+    h->cuantiles[HISTORIAL_DIA] = h->cuantiles[HISTORIAL_HORA] + HISTORIAL_HORAS;
+    h->bloques = (historial_bloque *)(h->cuantiles[HISTORIAL_DIA] + HISTORIAL_DIAS);
+
+    if ((size_t)info.st_size < tamanio_archivo(0))
+    {
+        if (crear(h) < 0)
+        {
+            historial_cerrar(h);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (memcmp(cabecera->magia, HISTORIAL_MAGIA, sizeof(cabecera->magia)) != 0 ||
+        cabecera->version != HISTORIAL_VERSION ||
+        cabecera->bloque_size != HISTORIAL_BLOQUE_SIZE ||
+        cabecera->muestras_bloque != HISTORIAL_MUESTRAS_BLOQUE ||
+        cabecera->max_bloques != HISTORIAL_MAX_BLOQUES)
+    {
+        fprintf(stderr, "Error: %s no es un historial de esta versión\n", ruta);
+        historial_cerrar(h);
+        return -1;
+    }
+
+    h->archivo_bloques = (info.st_size - tamanio_archivo(0)) / HISTORIAL_BLOQUE_SIZE;
+
+    if (h->archivo_bloques > HISTORIAL_MAX_BLOQUES)
+    {
+        h->archivo_bloques = HISTORIAL_MAX_BLOQUES;
+    }
+
+    recuperar_cola(h);
+    recuperar_indice(h);
+    recuperar_agregados(h);
+
+    return 0;
+}
+
+int historial_agregar(historial *h, int64_t tiempo_ms, float valor)
+{
+    uint32_t total = atomic_load_explicit(&h->cabecera->bloques, memory_order_relaxed);
+    historial_bloque *cola = (total > 0) ? bloque_numero(h, total - 1) : NULL;
+    historial_muestra *muestra;
+    uint32_t cantidad = 0;
+
+    if (cola != NULL)
+    {
+        cantidad = atomic_load_explicit(&cola->resumen.cantidad, memory_order_relaxed);
+
+        // El historial no retrocede aunque se corrija el reloj
+        if (cantidad > 0 && tiempo_ms < cola->resumen.fin_ms)
+        {
+            tiempo_ms = cola->resumen.fin_ms;
+        }
+    }
+
+    if (cola == NULL || cantidad == HISTORIAL_MUESTRAS_BLOQUE || tiempo_ms - cola->resumen.inicio_ms >= HISTORIAL_VACIA)
+    {
+        if (empezar_bloque(h, tiempo_ms) < 0)
+        {
+            return -1;
+        }
+
+        cola = bloque_numero(h, atomic_load_explicit(&h->cabecera->bloques, memory_order_relaxed) - 1);
+        cantidad = 0;
+    }
+
+    muestra = &cola->muestras[cantidad];
+    muestra->delta_ms = (uint32_t)(tiempo_ms - cola->resumen.inicio_ms);
+    muestra->valor = valor;
+
+    if (cantidad == 0 || valor < cola->resumen.minimo)
+    {
+        cola->resumen.minimo = valor;
+    }
+    if (cantidad == 0 || valor > cola->resumen.maximo)
+    {
+        cola->resumen.maximo = valor;
+    }
+    cola->resumen.suma += valor;
+    cola->resumen.suma_cuadrados += (double)valor * valor;
+    cola->resumen.fin_ms = tiempo_ms;
+
+    // Los lectores ven la muestra recién cuando cambia la cantidad
+    atomic_store_explicit(&cola->resumen.cantidad, cantidad + 1, memory_order_release);
+
+    agregar_niveles(h, tiempo_ms, valor);
+
+    if (cantidad + 1 == HISTORIAL_MUESTRAS_BLOQUE)
+    {
+        // Bloque completo: se pide al kernel que lo baje a disco sin esperar
+        msync(cola, HISTORIAL_BLOQUE_SIZE, MS_ASYNC);
+    }
+
+    return 0;
+}
+
+uint32_t historial_bloques(const historial *h, uint32_t *primero)
+{
+    uint32_t total = atomic_load_explicit(&h->cabecera->bloques, memory_order_acquire);
+
+    *primero = (total > HISTORIAL_MAX_BLOQUES) ? total - HISTORIAL_MAX_BLOQUES : 0;
+
+    return total;
+}
+
+const historial_bloque *historial_bloque_leer(const historial *h, uint32_t numero)
+{
+    uint32_t primero;
+    uint32_t total = historial_bloques(h, &primero);
+    const historial_bloque *bloque;
+
+    if ((uint32_t)(numero - primero) >= (uint32_t)(total - primero))
+    {
+        return NULL;
+    }
+
+    bloque = bloque_numero(h, numero);
+
+    return historial_bloque_vigente(bloque, numero) ? bloque : NULL;
+}
+
+int historial_bloque_vigente(const historial_bloque *bloque, uint32_t numero)
+{
+    // Las lecturas del bloque no pueden quedar después de la verificación
+    atomic_thread_fence(memory_order_acquire);
+
+    return bloque->resumen.magia == HISTORIAL_MAGIA_BLOQUE && bloque->resumen.numero == numero;
+}
+
+int historial_consultar(const historial *h, int64_t desde_ms, int64_t hasta_ms, int64_t paso_ms,
+                        historial_punto *puntos, cuantiles_digest *digestos, unsigned int n_puntos)
+{
+    consulta c = {desde_ms, paso_ms, puntos, digestos};
+    int nivel;
+    int64_t ancho = 1;
+    int64_t primero_ms = hasta_ms;
+    int64_t ultimo_ms = hasta_ms;
+
+    if (desde_ms < 0 || paso_ms <= 0 || hasta_ms <= desde_ms || n_puntos == 0 || n_puntos > HISTORIAL_PUNTOS_MAX ||
+        (hasta_ms - desde_ms - 1) / paso_ms >= n_puntos)
+    {
+        return -1;
+    }
+
+    // El nivel más grueso que entra al menos cuatro veces en el paso. Con cuantiles solo sirven los niveles
+    // que los tienen y alcanza con que entre una vez: pasar las muestras por los digestos cuesta mucho más
+    // que correr un período al intervalo de su punto medio
+    for (nivel = HISTORIAL_NIVELES - 1;
+         nivel >= 0 && (digestos == NULL ? ancho_nivel[nivel] * 4 > paso_ms
+                                          : ancho_nivel[nivel] > paso_ms || h->cuantiles[nivel] == NULL);
+         nivel--)
+    {
+    }
+
+    // Los intervalos completos del nivel salen de los agregados, los extremos de los bloques;
+    // sin nivel (o si no hay ningún período completo) todo sale de los bloques
+    if (nivel >= 0)
+    {
+        ancho = ancho_nivel[nivel];
+        primero_ms = (desde_ms + ancho - 1) / ancho * ancho;
+        ultimo_ms = hasta_ms / ancho * ancho;
+
+        if (primero_ms >= ultimo_ms)
+        {
+            primero_ms = hasta_ms;
+            ultimo_ms = hasta_ms;
+        }
+    }
+
+    // Con cuantiles cada muestra de los extremos pasa por un digesto: se rechaza antes de empezar
+    if (digestos != NULL &&
+        contar_muestras(h, desde_ms, primero_ms) + contar_muestras(h, ultimo_ms, hasta_ms) > HISTORIAL_CUANTILES_MUESTRAS_MAX)
+    {
+        return -1;
+    }
+
+    memset(puntos, 0, n_puntos * sizeof(historial_punto));
+
+    for (unsigned int k = 0; digestos != NULL && k < n_puntos; k++)
+    {
+        cuantiles_iniciar(&digestos[k]);
+    }
+
+    consultar_bloques(h, desde_ms, primero_ms, &c);
+
+    if (primero_ms < ultimo_ms)
+    {
+        sumar_agregados(h, nivel, primero_ms / ancho, ultimo_ms / ancho, &c);
+    }
+
+    consultar_bloques(h, ultimo_ms, hasta_ms, &c);
+
+    return 0;
+}
+
+void historial_cerrar(historial *h)
+{
+    if (h->cabecera != MAP_FAILED)
+    {
+        msync(h->cabecera, tamanio_archivo(h->archivo_bloques), MS_ASYNC);
+        munmap(h->cabecera, tamanio_archivo(HISTORIAL_MAX_BLOQUES));
+        h->cabecera = MAP_FAILED;
+    }
+
+    if (h->fd >= 0)
+    {
+        close(h->fd);
+        h->fd = -1;
+    }
+}
+
+/*Funciones privadas*/
+
+static size_t tamanio_archivo(uint32_t bloques)
+{
+    return sizeof(historial_cabecera) + INDICE_SIZE + AGREGADOS_SIZE + CUANTILES_SIZE + (size_t)bloques * HISTORIAL_BLOQUE_SIZE;
+}
+
+/**
+ * @brief Agranda el archivo hasta tener la cantidad de bloques indicada
+ *
+ * Los bloques nuevos quedan en cero (sin asignar en disco hasta que se escriben).
+ */
+static int crecer(historial *h, uint32_t bloques)
+{
+    if (bloques > HISTORIAL_MAX_BLOQUES)
+    {
+        bloques = HISTORIAL_MAX_BLOQUES;
+    }
+
+    if (ftruncate(h->fd, tamanio_archivo(bloques)) < 0)
+    {
+        perror("Error al agrandar el historial");
+        return -1;
+    }
+
+    h->archivo_bloques = bloques;
+
+    return 0;
+}
+
+static int crear(historial *h)
+{
+    historial_cabecera *cabecera = h->cabecera;
+
+    if (crecer(h, HISTORIAL_CRECIMIENTO) < 0)
+    {
+        return -1;
+    }
+
+    memcpy(cabecera->magia, HISTORIAL_MAGIA, sizeof(cabecera->magia));
+    cabecera->version = HISTORIAL_VERSION;
+    cabecera->bloque_size = HISTORIAL_BLOQUE_SIZE;
+    cabecera->muestras_bloque = HISTORIAL_MUESTRAS_BLOQUE;
+    cabecera->max_bloques = HISTORIAL_MAX_BLOQUES;
+    atomic_store(&cabecera->bloques, 0);
+
+    msync(cabecera, sizeof(historial_cabecera), MS_SYNC);
+
+    printf("Historial nuevo creado\n");
+
+    return 0;
+}
+
+static historial_bloque *bloque_numero(const historial *h, uint32_t numero)
+{
+    return &h->bloques[numero % HISTORIAL_MAX_BLOQUES];
+}
+
+/**
+ * @brief Indica si el bloque número numero está en el archivo e inicializado
+ */
+static int bloque_valido(const historial *h, uint32_t numero)
+{
+    if (numero % HISTORIAL_MAX_BLOQUES >= h->archivo_bloques)
+    {
+        return 0;
+    }
+
+    return historial_bloque_vigente(bloque_numero(h, numero), numero);
+}
+
+/**
+ * @brief Deja la cola consistente después de un corte
+ *
+ * Las páginas del mapeo llegan al disco en cualquier orden: la cabecera
+ * puede contar un bloque que nunca se escribió o no contar uno que sí.
+ * Dentro de la cola las posiciones libres tienen delta_ms HISTORIAL_VACIA,
+ * las muestras válidas son las primeras con horas no decrecientes.
+ */
+static void recuperar_cola(historial *h)
+{
+    uint32_t total = atomic_load(&h->cabecera->bloques);
+    historial_bloque *cola;
+    uint32_t cantidad;
+    uint32_t anterior = 0;
+
+    while (total > 0 && !bloque_valido(h, total - 1))
+    {
+        total--;
+    }
+
+    while (bloque_valido(h, total))
+    {
+        total++;
+    }
+
+    if (total != atomic_load(&h->cabecera->bloques))
+    {
+        fprintf(stderr, "Historial: cabecera corregida de %u a %u bloques\n", atomic_load(&h->cabecera->bloques), total);
+        atomic_store(&h->cabecera->bloques, total);
+    }
+
+    if (total == 0)
+    {
+        return;
+    }
+
+    cola = bloque_numero(h, total - 1);
+
+    for (cantidad = 0; cantidad < HISTORIAL_MUESTRAS_BLOQUE; cantidad++)
+    {
+        uint32_t delta = cola->muestras[cantidad].delta_ms;
+
+        if (delta == HISTORIAL_VACIA || delta < anterior)
+        {
+            break;
+        }
+
+        anterior = delta;
+    }
+
+    // Lo que sigue a la última muestra válida vuelve a quedar libre
+    if (cantidad < HISTORIAL_MUESTRAS_BLOQUE)
+    {
+        memset(&cola->muestras[cantidad], 0xFF, (HISTORIAL_MUESTRAS_BLOQUE - cantidad) * sizeof(historial_muestra));
+    }
+
+    cola->resumen.suma = 0;
+    cola->resumen.suma_cuadrados = 0;
+
+    for (uint32_t i = 0; i < cantidad; i++)
+    {
+        float valor = cola->muestras[i].valor;
+
+        if (i == 0 || valor < cola->resumen.minimo)
+        {
+            cola->resumen.minimo = valor;
+        }
+        if (i == 0 || valor > cola->resumen.maximo)
+        {
+            cola->resumen.maximo = valor;
+        }
+        cola->resumen.suma += valor;
+        cola->resumen.suma_cuadrados += (double)valor * valor;
+    }
+
+    cola->resumen.fin_ms = cola->resumen.inicio_ms + (cantidad > 0 ? cola->muestras[cantidad - 1].delta_ms : 0);
+
+    if (cantidad != atomic_load(&cola->resumen.cantidad))
+    {
+        fprintf(stderr, "Historial: cola recuperada con %u muestras (cabecera: %u)\n", cantidad, atomic_load(&cola->resumen.cantidad));
+    }
+
+    atomic_store(&cola->resumen.cantidad, cantidad);
+}
+
+/**
+ * @brief Completa las entradas del índice que no llegaron al disco
+ *
+ * Solo se leen los bloques cuya entrada no corresponde, el resto del índice
+ * se recorre sin tocar las muestras.
+ */
+static void recuperar_indice(historial *h)
+{
+    uint32_t primero;
+    uint32_t total = historial_bloques(h, &primero);
+    uint32_t reconstruidas = 0;
+
+    for (uint32_t numero = primero; numero + 1 < total; numero++)
+    {
+        if (atomic_load(&h->indice[numero % HISTORIAL_MAX_BLOQUES].bloque) != numero + 1 && bloque_valido(h, numero))
+        {
+            indexar(h, numero);
+            reconstruidas++;
+        }
+    }
+
+    if (reconstruidas > 0)
+    {
+        fprintf(stderr, "Historial: %u entradas del índice reconstruidas\n", reconstruidas);
+    }
+}
+
+/**
+ * @brief Recalcula los agregados recientes a partir de las muestras
+ *
+ * Un corte puede dejar agregados que no coinciden con los bloques (páginas
+ * que no llegaron al disco o un agregado a medio escribir). Se vacían los
+ * períodos desde el día de la última muestra, o el anterior si la muestra es
+ * de los primeros minutos del día, y se vuelven a sumar sus muestras.
+ */
+static void recuperar_agregados(historial *h)
+{
+    uint32_t primero;
+    uint32_t total = historial_bloques(h, &primero);
+    int64_t desde_ms;
+    int64_t fin_ms;
+
+    if (total == 0)
+    {
+        return;
+    }
+
+    fin_ms = bloque_numero(h, total - 1)->resumen.fin_ms;
+    desde_ms = fin_ms - AGREGADOS_RECALCULO_MS;
+    desde_ms = (desde_ms > 0) ? desde_ms / ancho_nivel[HISTORIAL_DIA] * ancho_nivel[HISTORIAL_DIA] : 0;
+
+    for (int nivel = 0; nivel < HISTORIAL_NIVELES; nivel++)
+    {
+        for (uint32_t periodo = desde_ms / ancho_nivel[nivel]; periodo <= fin_ms / ancho_nivel[nivel]; periodo++)
+        {
+            historial_agregado *agregado = &h->agregados[nivel][periodo % capacidad_nivel[nivel]];
+            historial_cuantiles *resumen;
+
+            empezar_escritura(&agregado->version);
+            atomic_store_explicit(&agregado->periodo, 0, memory_order_relaxed);
+            terminar_escritura(&agregado->version);
+
+            if (h->cuantiles[nivel] != NULL)
+            {
+                resumen = &h->cuantiles[nivel][periodo % capacidad_nivel[nivel]];
+
+                empezar_escritura(&resumen->version);
+                atomic_store_explicit(&resumen->periodo, 0, memory_order_relaxed);
+                terminar_escritura(&resumen->version);
+            }
+        }
+    }
+
+    for (uint32_t numero = primer_bloque(h, primero, total, desde_ms); numero < total; numero++)
+    {
+        const historial_bloque *bloque = bloque_numero(h, numero);
+        uint32_t cantidad = atomic_load(&bloque->resumen.cantidad);
+
+        if (!bloque_valido(h, numero))
+        {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < cantidad && i < HISTORIAL_MUESTRAS_BLOQUE; i++)
+        {
+            int64_t tiempo_ms = bloque->resumen.inicio_ms + bloque->muestras[i].delta_ms;
+
+            if (tiempo_ms >= desde_ms)
+            {
+                agregar_niveles(h, tiempo_ms, bloque->muestras[i].valor);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Inicializa el bloque siguiente y lo publica como cola
+ *
+ * El bloque que deja de ser la cola ya no cambia y pasa al índice. Si el
+ * historial dio la vuelta se recicla el bloque más viejo: primero se
+ * invalida para que los lectores que lo estén usando lo noten.
+ */
+static int empezar_bloque(historial *h, int64_t tiempo_ms)
+{
+    uint32_t numero = atomic_load_explicit(&h->cabecera->bloques, memory_order_relaxed);
+    uint32_t indice = numero % HISTORIAL_MAX_BLOQUES;
+    historial_bloque *bloque;
+
+    if (indice >= h->archivo_bloques && crecer(h, h->archivo_bloques + HISTORIAL_CRECIMIENTO) < 0)
+    {
+        return -1;
+    }
+
+    if (numero > 0)
+    {
+        indexar(h, numero - 1);
+    }
+
+    bloque = &h->bloques[indice];
+
+    bloque->resumen.magia = 0;
+    atomic_thread_fence(memory_order_seq_cst);
+
+    memset(bloque->muestras, 0xFF, sizeof(bloque->muestras));
+    bloque->resumen.numero = numero;
+    bloque->resumen.inicio_ms = tiempo_ms;
+    bloque->resumen.fin_ms = tiempo_ms;
+    atomic_store_explicit(&bloque->resumen.cantidad, 0, memory_order_relaxed);
+    bloque->resumen.minimo = 0;
+    bloque->resumen.maximo = 0;
+    bloque->resumen.suma = 0;
+    bloque->resumen.suma_cuadrados = 0;
+
+    atomic_thread_fence(memory_order_release);
+    bloque->resumen.magia = HISTORIAL_MAGIA_BLOQUE;
+
+    atomic_store_explicit(&h->cabecera->bloques, numero + 1, memory_order_release);
+
+    return 0;
+}
+
+/**
+ * @brief Copia el resumen de un bloque completo a su entrada del índice
+ *
+ * Igual que con los bloques, la entrada se invalida mientras se escribe.
+ */
+static void indexar(historial *h, uint32_t numero)
+{
+    const historial_bloque *bloque = bloque_numero(h, numero);
+    historial_indice *entrada = &h->indice[numero % HISTORIAL_MAX_BLOQUES];
+
+    atomic_store_explicit(&entrada->bloque, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    entrada->inicio_ms = bloque->resumen.inicio_ms;
+    entrada->fin_ms = bloque->resumen.fin_ms;
+    entrada->suma = bloque->resumen.suma;
+    entrada->suma_cuadrados = bloque->resumen.suma_cuadrados;
+    entrada->minimo = bloque->resumen.minimo;
+    entrada->maximo = bloque->resumen.maximo;
+    entrada->cantidad = atomic_load_explicit(&bloque->resumen.cantidad, memory_order_relaxed);
+
+    atomic_store_explicit(&entrada->bloque, numero + 1, memory_order_release);
+}
+
+/**
+ * @brief Copia la entrada del índice del bloque numero
+ *
+ * @return int 1 si la copia es válida, 0 si la entrada es de otro bloque o
+ * se reescribió mientras se copiaba
+ */
+static int leer_indice(const historial *h, uint32_t numero, historial_indice *copia)
+{
+    historial_indice *entrada = &h->indice[numero % HISTORIAL_MAX_BLOQUES];
+
+    if (atomic_load_explicit(&entrada->bloque, memory_order_acquire) != numero + 1)
+    {
+        return 0;
+    }
+
+    copia->inicio_ms = entrada->inicio_ms;
+    copia->fin_ms = entrada->fin_ms;
+    copia->suma = entrada->suma;
+    copia->suma_cuadrados = entrada->suma_cuadrados;
+    copia->minimo = entrada->minimo;
+    copia->maximo = entrada->maximo;
+    copia->cantidad = entrada->cantidad;
+
+    atomic_thread_fence(memory_order_acquire);
+
+    return atomic_load_explicit(&entrada->bloque, memory_order_relaxed) == numero + 1;
+}
+
+static void acumular(historial_punto *punto, double suma, double suma_cuadrados, float minimo, float maximo,
+                     uint32_t cantidad)
+{
+    if (punto->cantidad == 0 || minimo < punto->minimo)
+    {
+        punto->minimo = minimo;
+    }
+    if (punto->cantidad == 0 || maximo > punto->maximo)
+    {
+        punto->maximo = maximo;
+    }
+    punto->suma += suma;
+    punto->suma_cuadrados += suma_cuadrados;
+    punto->cantidad += cantidad;
+}
+
+/**
+ * @brief Primer bloque completo que termina en desde_ms o después
+ *
+ * Búsqueda binaria en el índice. Una entrada inválida solo puede ser del
+ * bloque más viejo, que se está reciclando, y se toma como anterior.
+ *
+ * @return uint32_t Número del bloque, total - 1 (la cola) si no hay ninguno
+ */
+static uint32_t primer_bloque(const historial *h, uint32_t primero, uint32_t total, int64_t desde_ms)
+{
+    historial_indice entrada;
+    uint32_t izquierda = primero;
+    uint32_t derecha = total - 1;
+
+    while (izquierda < derecha)
+    {
+        uint32_t medio = izquierda + (derecha - izquierda) / 2;
+
+        if (!leer_indice(h, medio, &entrada) || entrada.fin_ms < desde_ms)
+        {
+            izquierda = medio + 1;
+        }
+        else
+        {
+            derecha = medio;
+        }
+    }
+
+    return izquierda;
+}
+
+/**
+ * @brief Suma a la consulta las muestras de [desde_ms, hasta_ms) usando los bloques
+ */
+static void consultar_bloques(const historial *h, int64_t desde_ms, int64_t hasta_ms, const consulta *c)
+{
+    historial_indice entrada;
+    uint32_t primero;
+    uint32_t total;
+
+    total = historial_bloques(h, &primero);
+
+    if (total == 0 || desde_ms >= hasta_ms)
+    {
+        return;
+    }
+
+    for (uint32_t numero = primer_bloque(h, primero, total, desde_ms); numero < total - 1; numero++)
+    {
+        if (!leer_indice(h, numero, &entrada))
+        {
+            continue;
+        }
+
+        if (entrada.inicio_ms >= hasta_ms)
+        {
+            return;
+        }
+
+        if (c->digestos != NULL || !sumar_indice(&entrada, desde_ms, hasta_ms, c))
+        {
+            recorrer_bloque(h, numero, desde_ms, hasta_ms, c);
+        }
+    }
+
+    // La cola no tiene entrada en el índice
+    recorrer_bloque(h, total - 1, desde_ms, hasta_ms, c);
+}
+
+/**
+ * @brief Cuenta con el índice las muestras de los bloques que tocan [desde_ms, hasta_ms), sin leerlos
+ *
+ * Es una cota: los bloques de los extremos cuentan enteros.
+ */
+static uint64_t contar_muestras(const historial *h, int64_t desde_ms, int64_t hasta_ms)
+{
+    historial_indice entrada;
+    uint32_t primero;
+    uint32_t total;
+    uint64_t cantidad = 0;
+
+    total = historial_bloques(h, &primero);
+
+    if (total == 0 || desde_ms >= hasta_ms)
+    {
+        return 0;
+    }
+
+    for (uint32_t numero = primer_bloque(h, primero, total, desde_ms); numero < total - 1; numero++)
+    {
+        if (!leer_indice(h, numero, &entrada))
+        {
+            continue;
+        }
+
+        if (entrada.inicio_ms >= hasta_ms)
+        {
+            return cantidad;
+        }
+
+        cantidad += entrada.cantidad;
+    }
+
+    // La cola no tiene entrada en el índice
+    return cantidad + atomic_load_explicit(&bloque_numero(h, total - 1)->resumen.cantidad, memory_order_acquire);
+}
+
+/**
+ * @brief Suma un bloque completo a su intervalo usando solo su resumen
+ *
+ * @return int 1 si se sumó, 0 si hay que recorrer sus muestras
+ */
+static int sumar_indice(const historial_indice *entrada, int64_t desde_ms, int64_t hasta_ms, const consulta *c)
+{
+    int64_t primero;
+    int64_t ultimo;
+
+    if (entrada->cantidad == 0 || entrada->inicio_ms < desde_ms || entrada->fin_ms >= hasta_ms)
+    {
+        return 0;
+    }
+
+    primero = (entrada->inicio_ms - c->desde_ms) / c->paso_ms;
+    ultimo = (entrada->fin_ms - c->desde_ms) / c->paso_ms;
+
+    if (primero != ultimo)
+    {
+        // Un bloque corto al lado del paso se corre como mucho un cuarto de intervalo
+        if ((entrada->fin_ms - entrada->inicio_ms) * 4 > c->paso_ms)
+        {
+            return 0;
+        }
+
+        primero = (entrada->inicio_ms + (entrada->fin_ms - entrada->inicio_ms) / 2 - c->desde_ms) / c->paso_ms;
+    }
+
+    acumular(&c->puntos[primero], entrada->suma, entrada->suma_cuadrados, entrada->minimo, entrada->maximo,
+             entrada->cantidad);
+
+    return 1;
+}
+
+/**
+ * @brief Suma una por una las muestras del bloque que caen en [desde_ms, hasta_ms)
+ *
+ * Las muestras se copian antes de sumarlas: si el bloque se recicló mientras
+ * tanto se descartan enteras.
+ */
+static void recorrer_bloque(const historial *h, uint32_t numero, int64_t desde_ms, int64_t hasta_ms, const consulta *c)
+{
+    historial_muestra muestras[HISTORIAL_MUESTRAS_BLOQUE];
+    const historial_bloque *bloque = historial_bloque_leer(h, numero);
+    uint32_t cantidad;
+    int64_t inicio_ms;
+
+    if (bloque == NULL)
+    {
+        return;
+    }
+
+    cantidad = atomic_load_explicit(&bloque->resumen.cantidad, memory_order_acquire);
+    inicio_ms = bloque->resumen.inicio_ms;
+
+    if (cantidad > HISTORIAL_MUESTRAS_BLOQUE)
+    {
+        cantidad = HISTORIAL_MUESTRAS_BLOQUE;
+    }
+
+    memcpy(muestras, bloque->muestras, cantidad * sizeof(historial_muestra));
+
+    if (!historial_bloque_vigente(bloque, numero))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < cantidad; i++)
+    {
+        int64_t tiempo_ms = inicio_ms + muestras[i].delta_ms;
+        float valor = muestras[i].valor;
+        int64_t k;
+
+        if (tiempo_ms < desde_ms)
+        {
+            continue;
+        }
+
+        if (tiempo_ms >= hasta_ms)
+        {
+            break;
+        }
+
+        k = (tiempo_ms - c->desde_ms) / c->paso_ms;
+        acumular(&c->puntos[k], valor, (double)valor * valor, valor, valor, 1);
+
+        if (c->digestos != NULL)
+        {
+            cuantiles_agregar(&c->digestos[k], valor);
+        }
+    }
+}
+
+/**
+ * @brief Suma los agregados de los períodos [primero, ultimo) de un nivel
+ *
+ * Un agregado que abarca el límite entre dos intervalos de la consulta se
+ * suma al de su punto medio, igual que su resumen de cuantiles.
+ */
+static void sumar_agregados(const historial *h, historial_nivel nivel, uint32_t primero, uint32_t ultimo,
+                            const consulta *c)
+{
+    historial_agregado agregado;
+    historial_cuantiles *resumen;
+    cuantiles_digest digest;
+    int64_t ancho = ancho_nivel[nivel];
+    int64_t k;
+
+    for (uint32_t periodo = primero; periodo < ultimo; periodo++)
+    {
+        historial_agregado *origen = &h->agregados[nivel][periodo % capacidad_nivel[nivel]];
+
+        if (!leer_versionado(&origen->version, &origen->periodo, periodo, &agregado, origen,
+                             offsetof(historial_agregado, periodo)))
+        {
+            continue;
+        }
+
+        k = ((int64_t)periodo * ancho + ancho / 2 - c->desde_ms) / c->paso_ms;
+
+        acumular(&c->puntos[k], agregado.suma, agregado.suma_cuadrados, agregado.minimo, agregado.maximo,
+                 agregado.cantidad);
+
+        if (c->digestos != NULL)
+        {
+            resumen = &h->cuantiles[nivel][periodo % capacidad_nivel[nivel]];
+
+            if (leer_versionado(&resumen->version, &resumen->periodo, periodo, &digest, &resumen->digest,
+                                sizeof(digest)))
+            {
+                cuantiles_unir(&c->digestos[k], &digest);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Copia un agregado o un resumen de cuantiles del período indicado
+ *
+ * Como buffer_get_estadisticas: la copia vale si la versión era par y no
+ * cambió mientras se copiaba. El del período en curso puede estar
+ * actualizándose: se reintenta unas pocas veces, la escritura dura lo que
+ * tarda en sumar una muestra, y así un escritor que murió a mitad de una
+ * escritura no deja colgado al lector.
+ *
+ * @param version Campo version del agregado o resumen
+ * @param marca Campo periodo del agregado o resumen
+ * @param periodo Período buscado
+ * @param copia Destino de longitud bytes
+ * @param datos Lo que se copia, todo lo que está antes de marca
+ * @return int 1 si la copia es válida, 0 si el período no tiene muestras o ya se recicló
+ */
+static int leer_versionado(_Atomic uint32_t *version, _Atomic uint32_t *marca, uint32_t periodo, void *copia,
+                           const void *datos, size_t longitud)
+{
+    uint32_t leida;
+    uint32_t marcado;
+
+    for (int intento = 0; intento < AGREGADO_REINTENTOS; intento++)
+    {
+        leida = atomic_load_explicit(version, memory_order_acquire);
+
+        if (leida & 1)
+        {
+            continue;
+        }
+
+        marcado = atomic_load_explicit(marca, memory_order_relaxed);
+
+        memcpy(copia, datos, longitud);
+
+        // La copia no puede quedar después de la segunda lectura de la versión
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(version, memory_order_relaxed) == leida)
+        {
+            return marcado == periodo + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deja impar la versión de un agregado o resumen antes de escribirlo
+ *
+ * Si un escritor anterior murió a mitad de una escritura ya estaba impar y
+ * queda así; terminar_escritura la vuelve a dejar par con un valor nuevo.
+ */
+static void empezar_escritura(_Atomic uint32_t *version)
+{
+    atomic_store_explicit(version, atomic_load_explicit(version, memory_order_relaxed) | 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * @brief Publica lo escrito dejando par la versión
+ */
+static void terminar_escritura(_Atomic uint32_t *version)
+{
+    atomic_store_explicit(version, atomic_load_explicit(version, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/**
+ * @brief Suma una muestra al minuto, la hora y el día que le corresponden
+ *
+ * Si la posición del anillo es de un período anterior se recicla. Mientras
+ * se escribe su versión queda impar para que los lectores reintenten.
+ */
+static void agregar_niveles(historial *h, int64_t tiempo_ms, float valor)
+{
+    for (int nivel = 0; nivel < HISTORIAL_NIVELES; nivel++)
+    {
+        uint32_t periodo = tiempo_ms / ancho_nivel[nivel];
+        historial_agregado *agregado = &h->agregados[nivel][periodo % capacidad_nivel[nivel]];
+        historial_cuantiles *resumen;
+
+        empezar_escritura(&agregado->version);
+
+        if (atomic_load_explicit(&agregado->periodo, memory_order_relaxed) != periodo + 1)
+        {
+            atomic_store_explicit(&agregado->periodo, periodo + 1, memory_order_relaxed);
+            agregado->cantidad = 0;
+            agregado->suma = 0;
+            agregado->suma_cuadrados = 0;
+            agregado->minimo = valor;
+            agregado->maximo = valor;
+        }
+        else if (valor < agregado->minimo)
+        {
+            agregado->minimo = valor;
+        }
+        else if (valor > agregado->maximo)
+        {
+            agregado->maximo = valor;
+        }
+
+        agregado->suma += valor;
+        agregado->suma_cuadrados += (double)valor * valor;
+        agregado->cantidad++;
+
+        terminar_escritura(&agregado->version);
+
+        if (h->cuantiles[nivel] == NULL)
+        {
+            continue;
+        }
+
+        resumen = &h->cuantiles[nivel][periodo % capacidad_nivel[nivel]];
+
+        empezar_escritura(&resumen->version);
+
+        if (atomic_load_explicit(&resumen->periodo, memory_order_relaxed) != periodo + 1)
+        {
+            atomic_store_explicit(&resumen->periodo, periodo + 1, memory_order_relaxed);
+            cuantiles_iniciar(&resumen->digest);
+        }
+
+        cuantiles_agregar(&resumen->digest, valor);
+
+        terminar_escritura(&resumen->version);
+    }
+}
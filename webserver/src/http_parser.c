@@ -0,0 +1,588 @@
+/**
+ * @file http_parser.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Analizador incremental de pedidos HTTP/1.x
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/http_parser.h"
+
+#include <string.h>
+#include <strings.h>
+
+/*Funciones privadas*/
+
+static int es_token(char c);
+static int calidad_nula(const char *valor, size_t longitud);
+static int analizar_linea_pedido(http_pedido *pedido, const char *datos, size_t inicio, size_t longitud);
+static unsigned int analizar_cabecera(http_pedido *pedido, const char *datos, size_t inicio, size_t longitud);
+static unsigned int analizar_cuerpo(http_pedido *pedido, const char *datos, const http_cabecera *cabecera);
+static int nombre_igual(const char *datos, http_segmento nombre, const char *texto);
+
+/*Funciones de la biblioteca*/
+
+void http_parser_iniciar(http_pedido *pedido)
+{
+    pedido->estado = HTTP_PARSER_LINEA;
+    pedido->posicion = 0;
+    pedido->longitud = 0;
+    pedido->metodo.inicio = pedido->metodo.longitud = 0;
+    pedido->ruta.inicio = pedido->ruta.longitud = 0;
+    pedido->query.inicio = pedido->query.longitud = 0;
+    pedido->version_menor = 0;
+    pedido->n_cabeceras = 0;
+    pedido->cuerpo = 0;
+    pedido->cuerpo_declarado = 0;
+    pedido->codigo_error = 0;
+}
+
+http_resultado http_parser_analizar(http_pedido *pedido, const char *datos, size_t longitud)
+{
+    const char *inicio;
+    const char *fin;
+    size_t linea_len;
+
+    // Se analiza línea por línea, solo las que ya llegaron completas
+    while (pedido->estado != HTTP_PARSER_FIN)
+    {
+        if (pedido->posicion >= longitud)
+        {
+            return HTTP_PARSER_INCOMPLETO;
+        }
+
+        inicio = datos + pedido->posicion;
+        fin = memchr(inicio, '\n', longitud - pedido->posicion);
+
+        if (fin == NULL)
+        {
+            return HTTP_PARSER_INCOMPLETO;
+        }
+
+        linea_len = fin - inicio;
+
+        if (linea_len > 0 && inicio[linea_len - 1] == '\r')
+        {
+            linea_len--;
+        }
+
+        if (pedido->estado == HTTP_PARSER_LINEA)
+        {
+            // Las líneas vacías antes del pedido se ignoran (RFC 9112, 2.2)
+            if (linea_len > 0)
+            {
+                if (analizar_linea_pedido(pedido, datos, pedido->posicion, linea_len) < 0)
+                {
+                    pedido->codigo_error = 400;
+                    return HTTP_PARSER_ERROR;
+                }
+                pedido->estado = HTTP_PARSER_CABECERAS;
+            }
+        }
+        else if (linea_len == 0)
+        {
+            pedido->estado = HTTP_PARSER_FIN;
+            pedido->longitud = (fin - datos) + 1 + pedido->cuerpo;
+        }
+        else if ((pedido->codigo_error = analizar_cabecera(pedido, datos, pedido->posicion, linea_len)) != 0)
+        {
+            return HTTP_PARSER_ERROR;
+        }
+
+        pedido->posicion = (fin - datos) + 1;
+    }
+
+    // Falta que llegue el resto del cuerpo
+    return (pedido->longitud <= longitud) ? HTTP_PARSER_COMPLETO : HTTP_PARSER_INCOMPLETO;
+}
+
+int http_segmento_igual(const char *datos, http_segmento segmento, const char *texto)
+{
+    size_t texto_len = strlen(texto);
+
+    return segmento.longitud == texto_len && memcmp(datos + segmento.inicio, texto, texto_len) == 0;
+}
+
+const http_segmento *http_pedido_cabecera(const http_pedido *pedido, const char *datos, const char *nombre)
+{
+    size_t nombre_len = strlen(nombre);
+
+    for (unsigned int i = 0; i < pedido->n_cabeceras; i++)
+    {
+        const http_cabecera *cabecera = &pedido->cabeceras[i];
+
+        if (cabecera->nombre.longitud == nombre_len &&
+            strncasecmp(datos + cabecera->nombre.inicio, nombre, nombre_len) == 0)
+        {
+            return &cabecera->valor;
+        }
+    }
+
+    return NULL;
+}
+
+int http_segmento_contiene_token(const char *datos, http_segmento segmento, const char *token)
+{
+    size_t token_len = strlen(token);
+    size_t i = 0;
+    size_t inicio;
+    size_t fin;
+
+    // Lista separada por comas, con espacios opcionales
+    while (i < segmento.longitud)
+    {
+        while (i < segmento.longitud && (datos[segmento.inicio + i] == ' ' || datos[segmento.inicio + i] == '\t'))
+        {
+            i++;
+        }
+
+        inicio = i;
+
+        while (i < segmento.longitud && datos[segmento.inicio + i] != ',')
+        {
+            i++;
+        }
+
+        fin = i;
+
+        while (fin > inicio && (datos[segmento.inicio + fin - 1] == ' ' || datos[segmento.inicio + fin - 1] == '\t'))
+        {
+            fin--;
+        }
+
+        if (fin - inicio == token_len && strncasecmp(datos + segmento.inicio + inicio, token, token_len) == 0)
+        {
+            return 1;
+        }
+
+        i++;
+    }
+
+    return 0;
+}
+
+int http_segmento_acepta_codificacion(const char *datos, http_segmento segmento, const char *codificacion)
+{
+    size_t codificacion_len = strlen(codificacion);
+    const char *valor = datos + segmento.inicio;
+    int comodin = 0;
+    size_t i = 0;
+    size_t inicio;
+    size_t fin;
+    size_t parametros;
+
+    // Lista de "codificacion[;q=x]" separada por comas
+    while (i < segmento.longitud)
+    {
+        while (i < segmento.longitud && (valor[i] == ' ' || valor[i] == '\t' || valor[i] == ','))
+        {
+            i++;
+        }
+
+        inicio = i;
+
+        while (i < segmento.longitud && es_token(valor[i]))
+        {
+            i++;
+        }
+
+        fin = i;
+        parametros = i;
+
+        while (i < segmento.longitud && valor[i] != ',')
+        {
+            i++;
+        }
+
+        if (fin - inicio == codificacion_len && strncasecmp(valor + inicio, codificacion, codificacion_len) == 0)
+        {
+            // Una mención explícita tiene prioridad sobre "*"
+            return !calidad_nula(valor + parametros, i - parametros);
+        }
+
+        if (fin - inicio == 1 && valor[inicio] == '*')
+        {
+            comodin = !calidad_nula(valor + parametros, i - parametros);
+        }
+    }
+
+    return comodin;
+}
+
+int http_segmento_contiene_etag(const char *datos, http_segmento segmento, const char *etag)
+{
+    size_t etag_len = strlen(etag);
+    const char *valor = datos + segmento.inicio;
+    size_t i = 0;
+    size_t inicio;
+
+    while (i < segmento.longitud)
+    {
+        while (i < segmento.longitud && (valor[i] == ' ' || valor[i] == '\t' || valor[i] == ','))
+        {
+            i++;
+        }
+
+        if (i < segmento.longitud && valor[i] == '*')
+        {
+            return 1;
+        }
+
+        if (i + 2 <= segmento.longitud && valor[i] == 'W' && valor[i + 1] == '/')
+        {
+            i += 2;
+        }
+
+        // Cada ETag va entre comillas y no puede contenerlas
+        inicio = i;
+
+        if (i < segmento.longitud && valor[i] == '"')
+        {
+            i++;
+
+            while (i < segmento.longitud && valor[i] != '"')
+            {
+                i++;
+            }
+
+            if (i < segmento.longitud)
+            {
+                i++;
+            }
+        }
+
+        if (i - inicio == etag_len && memcmp(valor + inicio, etag, etag_len) == 0)
+        {
+            return 1;
+        }
+
+        // Salta lo que no sea un ETag válido hasta la próxima coma
+        while (i < segmento.longitud && valor[i] != ',')
+        {
+            i++;
+        }
+    }
+
+    return 0;
+}
+
+int http_query_parametro(const char *datos, http_segmento query, const char *nombre, http_segmento *valor)
+{
+    size_t nombre_len = strlen(nombre);
+    size_t i = 0;
+    size_t inicio;
+    size_t igual;
+
+    // Pares nombre=valor separados por '&'
+    while (i <= query.longitud)
+    {
+        inicio = i;
+        igual = query.longitud + 1;
+
+        while (i < query.longitud && datos[query.inicio + i] != '&')
+        {
+            if (igual > query.longitud && datos[query.inicio + i] == '=')
+            {
+                igual = i;
+            }
+            i++;
+        }
+
+        if (igual > query.longitud)
+        {
+            igual = i;
+        }
+
+        if (igual - inicio == nombre_len && memcmp(datos + query.inicio + inicio, nombre, nombre_len) == 0)
+        {
+            valor->inicio = query.inicio + (igual < i ? igual + 1 : i);
+            valor->longitud = query.inicio + i - valor->inicio;
+            return 1;
+        }
+
+        i++;
+    }
+
+    return 0;
+}
+
+int http_segmento_entero(const char *datos, http_segmento segmento, int64_t *valor)
+{
+    const char *p = datos + segmento.inicio;
+    const char *fin = p + segmento.longitud;
+    int negativo = 0;
+    int64_t acumulado = 0;
+
+    if (p < fin && (*p == '-' || *p == '+'))
+    {
+        negativo = (*p == '-');
+        p++;
+    }
+
+    if (p == fin)
+    {
+        return 0;
+    }
+
+    for (; p < fin; p++)
+    {
+        if (*p < '0' || *p > '9' || acumulado > (INT64_MAX - (*p - '0')) / 10)
+        {
+            return 0;
+        }
+
+        acumulado = acumulado * 10 + (*p - '0');
+    }
+
+    *valor = negativo ? -acumulado : acumulado;
+
+    return 1;
+}
+
+/*Funciones privadas*/
+
+/**
+ * @brief Caracteres válidos en métodos y nombres de cabecera (RFC 9110, 5.6.2)
+ */
+static int es_token(char c)
+{
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+    {
+        return 1;
+    }
+
+    return c != '\0' && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+/**
+ * @brief Indica si los parámetros de un elemento tienen "q=0" (q=0, q=0.0, q=0.000)
+ *
+ * @param valor Parámetros del elemento, ej: ";q=0.5"
+ */
+static int calidad_nula(const char *valor, size_t longitud)
+{
+    size_t i = 0;
+
+    while (i < longitud)
+    {
+        while (i < longitud && (valor[i] == ' ' || valor[i] == '\t' || valor[i] == ';'))
+        {
+            i++;
+        }
+
+        if (i + 1 < longitud && (valor[i] == 'q' || valor[i] == 'Q') && valor[i + 1] == '=')
+        {
+            i += 2;
+
+            if (i >= longitud || valor[i] != '0')
+            {
+                return 0;
+            }
+
+            for (i++; i < longitud && (valor[i] == '.' || valor[i] == '0'); i++)
+            {
+            }
+
+            // Cualquier dígito distinto de cero hace la calidad positiva
+            return i >= longitud || valor[i] < '1' || valor[i] > '9';
+        }
+
+        while (i < longitud && valor[i] != ';')
+        {
+            i++;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Analiza "METODO SP destino SP HTTP/1.x"
+ *
+ * @return int 0 si la línea es válida, -1 si no
+ */
+static int analizar_linea_pedido(http_pedido *pedido, const char *datos, size_t inicio, size_t longitud)
+{
+    size_t i = inicio;
+    size_t fin = inicio + longitud;
+    size_t destino;
+
+    // Método
+    while (i < fin && es_token(datos[i]))
+    {
+        i++;
+    }
+
+    if (i == inicio || i >= fin || datos[i] != ' ')
+    {
+        return -1;
+    }
+
+    pedido->metodo.inicio = inicio;
+    pedido->metodo.longitud = i - inicio;
+
+    // Destino, en forma absoluta se descarta el esquema y el host
+    destino = ++i;
+
+    while (i < fin && datos[i] != ' ')
+    {
+        i++;
+    }
+
+    if (i == destino || i >= fin)
+    {
+        return -1;
+    }
+
+    if (i - destino > 7 && strncasecmp(datos + destino, "http://", 7) == 0)
+    {
+        destino += 7;
+
+        while (destino < i && datos[destino] != '/')
+        {
+            destino++;
+        }
+
+        if (destino == i)
+        {
+            return -1;
+        }
+    }
+
+    pedido->ruta.inicio = destino;
+    pedido->ruta.longitud = i - destino;
+    pedido->query.inicio = i;
+    pedido->query.longitud = 0;
+
+    for (size_t j = destino; j < i; j++)
+    {
+        if (datos[j] == '?')
+        {
+            pedido->ruta.longitud = j - destino;
+            pedido->query.inicio = j + 1;
+            pedido->query.longitud = i - j - 1;
+            break;
+        }
+    }
+
+    // Versión
+    i++;
+
+    if (fin - i != 8 || strncmp(datos + i, "HTTP/1.", 7) != 0 || (datos[i + 7] != '0' && datos[i + 7] != '1'))
+    {
+        return -1;
+    }
+
+    pedido->version_menor = datos[i + 7] - '0';
+
+    return 0;
+}
+
+/**
+ * @brief Analiza "Nombre: valor"
+ *
+ * @return unsigned int 0 si la cabecera es válida, si no el estado a responder
+ */
+static unsigned int analizar_cabecera(http_pedido *pedido, const char *datos, size_t inicio, size_t longitud)
+{
+    size_t i = inicio;
+    size_t fin = inicio + longitud;
+    size_t valor;
+    http_cabecera leida;
+
+    while (i < fin && es_token(datos[i]))
+    {
+        i++;
+    }
+
+    // Sin nombre, con espacios antes de ':' o continuación de línea obsoleta
+    if (i == inicio || i >= fin || datos[i] != ':')
+    {
+        return 400;
+    }
+
+    valor = i + 1;
+
+    while (valor < fin && (datos[valor] == ' ' || datos[valor] == '\t'))
+    {
+        valor++;
+    }
+
+    while (fin > valor && (datos[fin - 1] == ' ' || datos[fin - 1] == '\t'))
+    {
+        fin--;
+    }
+
+    leida.nombre.inicio = inicio;
+    leida.nombre.longitud = i - inicio;
+    leida.valor.inicio = valor;
+    leida.valor.longitud = fin - valor;
+
+    // Las cabeceras que no entran no se registran, pero igual se mira si dicen dónde termina el pedido
+    if (pedido->n_cabeceras < HTTP_MAX_CABECERAS)
+    {
+        pedido->cabeceras[pedido->n_cabeceras++] = leida;
+    }
+
+    return analizar_cuerpo(pedido, datos, &leida);
+}
+
+/**
+ * @brief Registra el largo del cuerpo si la cabecera es Content-Length o Transfer-Encoding
+ *
+ * @return unsigned int 0 si se sabe dónde termina el pedido, si no el estado a responder
+ */
+static unsigned int analizar_cuerpo(http_pedido *pedido, const char *datos, const http_cabecera *cabecera)
+{
+    size_t cuerpo = 0;
+
+    if (nombre_igual(datos, cabecera->nombre, "Transfer-Encoding"))
+    {
+        return 501;
+    }
+
+    if (!nombre_igual(datos, cabecera->nombre, "Content-Length"))
+    {
+        return 0;
+    }
+
+    // Repetido, aunque sea con el mismo valor, vacío o con algo que no es un dígito
+    if (pedido->cuerpo_declarado || cabecera->valor.longitud == 0)
+    {
+        return 400;
+    }
+
+    for (uint32_t k = 0; k < cabecera->valor.longitud; k++)
+    {
+        char c = datos[cabecera->valor.inicio + k];
+
+        if (c < '0' || c > '9')
+        {
+            return 400;
+        }
+
+        // Se corta antes de desbordar
+        if ((cuerpo = cuerpo * 10 + (c - '0')) > HTTP_CUERPO_MAX)
+        {
+            return 413;
+        }
+    }
+
+    pedido->cuerpo = cuerpo;
+    pedido->cuerpo_declarado = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Compara un nombre de cabecera sin distinguir mayúsculas
+ */
+static int nombre_igual(const char *datos, http_segmento nombre, const char *texto)
+{
+    size_t texto_len = strlen(texto);
+
+    return nombre.longitud == texto_len && strncasecmp(datos + nombre.inicio, texto, texto_len) == 0;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file json_writer.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Serialización de JSON directo sobre un buffer, sin reservar memoria
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/json_writer.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*Variables privadas*/
+
+/// @brief Pares de dígitos "00".."99", se escriben dos dígitos por división
+static const char pares[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/*Funciones de la biblioteca*/
+
+void json_writer_iniciar(json_writer *writer, char *destino, size_t capacidad)
+{
+    writer->destino = destino;
+    writer->capacidad = capacidad;
+    writer->longitud = 0;
+    writer->desbordado = 0;
+}
+
+void json_writer_texto(json_writer *writer, const char *texto, size_t longitud)
+{
+    // Siempre queda lugar para el '\0'
+    if (writer->desbordado || longitud >= writer->capacidad - writer->longitud)
+    {
+        writer->desbordado = 1;
+        return;
+    }
+
+    memcpy(writer->destino + writer->longitud, texto, longitud);
+    writer->longitud += longitud;
+}
+
+void json_writer_numero(json_writer *writer, float valor)
+{
+    char digitos[JSON_NUMERO_MAX];
+    char *p = digitos + sizeof(digitos);
+    long long centesimos;
+    unsigned long long entero;
+    unsigned int resto;
+
+    if (!isfinite(valor) || fabs(valor) >= JSON_NUMERO_LIMITE)
+    {
+        json_writer_texto(writer, "null", 4);
+        return;
+    }
+
+    // El producto de un float por 100 es exacto en double, y llrint redondea
+    // al par más cercano igual que printf
+    centesimos = llrint((double)valor * 100.0);
+    entero = (unsigned long long)llabs(centesimos);
+
+    resto = entero % 100;
+    entero /= 100;
+    p -= 2;
+    memcpy(p, pares + 2 * resto, 2);
+    *--p = '.';
+
+    while (entero >= 100)
+    {
+        resto = entero % 100;
+        entero /= 100;
+        p -= 2;
+        memcpy(p, pares + 2 * resto, 2);
+    }
+
+    if (entero >= 10)
+    {
+        p -= 2;
+        memcpy(p, pares + 2 * entero, 2);
+    }
+    else
+    {
+        *--p = '0' + entero;
+    }
+
+    // printf conserva el signo aunque el valor redondeado sea cero, ej: "-0.00"
+    if (signbit(valor))
+    {
+        *--p = '-';
+    }
+
+    json_writer_texto(writer, p, digitos + sizeof(digitos) - p);
+}
+
+void json_writer_entero(json_writer *writer, int64_t valor)
+{
+    char digitos[JSON_ENTERO_MAX];
+    char *p = digitos + sizeof(digitos);
+    // El módulo en unsigned también vale para INT64_MIN
+    uint64_t modulo = (valor < 0) ? -(uint64_t)valor : (uint64_t)valor;
+    unsigned int resto;
+
+    while (modulo >= 100)
+    {
+        resto = modulo % 100;
+        modulo /= 100;
+        p -= 2;
+        memcpy(p, pares + 2 * resto, 2);
+    }
+
+    if (modulo >= 10)
+    {
+        p -= 2;
+        memcpy(p, pares + 2 * modulo, 2);
+    }
+    else
+    {
+        *--p = '0' + modulo;
+    }
+
+    if (valor < 0)
+    {
+        *--p = '-';
+    }
+
+    json_writer_texto(writer, p, digitos + sizeof(digitos) - p);
+}
+
+void json_writer_segundos(json_writer *writer, int64_t tiempo_ns)
+{
+    char decimales[4] = {'.'};
+    int64_t milisegundos = (tiempo_ns >= 0) ? (tiempo_ns + 500000) / 1000000 : (tiempo_ns - 500000) / 1000000;
+    unsigned int resto = (unsigned int)llabs(milisegundos % 1000);
+
+    if (milisegundos < 0 && milisegundos > -1000)
+    {
+        json_writer_texto(writer, "-", 1);
+    }
+
+    json_writer_entero(writer, milisegundos / 1000);
+
+    decimales[1] = '0' + resto / 100;
+    memcpy(decimales + 2, pares + 2 * (resto % 100), 2);
+    json_writer_texto(writer, decimales, sizeof(decimales));
+}
+
+void json_writer_arreglo(json_writer *writer, const float *valores, size_t n)
+{
+    json_writer_texto(writer, "[", 1);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0)
+        {
+            json_writer_texto(writer, ",", 1);
+        }
+
+        json_writer_numero(writer, valores[i]);
+    }
+
+    json_writer_texto(writer, "]", 1);
+}
+
+void json_writer_arreglo_enteros(json_writer *writer, const int64_t *valores, size_t n)
+{
+    json_writer_texto(writer, "[", 1);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0)
+        {
+            json_writer_texto(writer, ",", 1);
+        }
+
+        json_writer_entero(writer, valores[i]);
+    }
+
+    json_writer_texto(writer, "]", 1);
+}
+
+int json_writer_terminar(json_writer *writer)
+{
+    if (writer->desbordado || writer->capacidad == 0)
+    {
+        return -1;
+    }
+
+    writer->destino[writer->longitud] = '\0';
+
+    return writer->longitud;
+}
+
+int json_writer_muestras(char *destino, size_t capacidad, const float *temp, const int64_t *tiempo_ns, size_t n)
+{
+    json_writer writer;
+
+    json_writer_iniciar(&writer, destino, capacidad);
+
+    json_writer_texto(&writer, "{\"temp\":", 8);
+    json_writer_arreglo(&writer, temp, n);
+    json_writer_texto(&writer, ",\"time\":[", 9);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0)
+        {
+            json_writer_texto(&writer, ",", 1);
+        }
+
+        json_writer_segundos(&writer, tiempo_ns[i]);
+    }
+
+    json_writer_texto(&writer, "]", 1);
+    json_writer_texto(&writer, "}", 1);
+
+    return json_writer_terminar(&writer);
+}
@@ -0,0 +1,524 @@
+/**
+ * @file metricas.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Contadores del servidor y del muestreo para /metrics (formato de Prometheus)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/metricas.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Suma de todas las partes, se arma en cada lectura de /metrics
+ */
+typedef struct metricas_totales
+{
+    uint64_t pedidos[METRICAS_RUTAS][METRICAS_BUCKETS];
+    uint64_t codigos[METRICAS_RUTAS][METRICAS_CODIGOS];
+    uint64_t duracion_ns[METRICAS_RUTAS];
+    uint64_t enviados;
+    uint64_t conexiones_abiertas;
+    uint64_t conexiones_cerradas;
+    uint64_t lecturas[METRICAS_BUCKETS];
+    uint64_t lectura_ns;
+    uint64_t retrasos[METRICAS_BUCKETS];
+    uint64_t retraso_ns;
+} metricas_totales;
+
+/**
+ * @brief Texto que se va escribiendo, recuerda si alguna vez no entró
+ */
+typedef struct exposicion
+{
+    char *texto;
+    size_t size;
+    size_t longitud;
+    int desbordado;
+} exposicion;
+
+/*Variables privadas*/
+
+/// @brief Niveles del historial que se muestran, con el período en curso de cada uno
+static const struct
+{
+    const char *nombre;
+    int64_t ancho_ms;
+} periodos[] = {{"minute", 60000}, {"hour", 3600000}, {"day", 86400000}};
+
+#define N_PERIODOS (sizeof(periodos) / sizeof(periodos[0]))
+
+/// @brief Límite superior de cada bucket de los histogramas en ns (de 10 us a 100 ms), el último es +Inf
+static const int64_t limites_ns[METRICAS_BUCKETS - 1] =
+{
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000,
+    2500000, 5000000, 10000000, 25000000, 50000000, 100000000
+};
+
+/// @brief Los mismos límites como los escribe /metrics, en segundos
+static const char *const limites_texto[METRICAS_BUCKETS] =
+{
+    "0.00001", "0.000025", "0.00005", "0.0001", "0.00025", "0.0005", "0.001",
+    "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "+Inf"
+};
+
+/// @brief Códigos de estado que responde el servidor, los demás van a la última posición
+static const unsigned int codigos[METRICAS_CODIGOS - 1] =
+{
+    101, 200, 206, 304, 400, 404, 405, 413, 416, 426, 500, 501, 503, 505
+};
+
+static metricas_parte *partes = NULL;
+
+/// @brief Parte de este proceso, se vuelve a elegir después de cada fork
+static metricas_parte *propia = NULL;
+
+/*Funciones privadas*/
+
+static void olvidar_parte(void);
+static metricas_parte *parte(void);
+static unsigned int bucket(int64_t ns);
+static void sumar(metricas_totales *totales);
+static void escribir(exposicion *e, const char *formato, ...) __attribute__((format(printf, 2, 3)));
+static void escribir_histograma(exposicion *e, const char *nombre, const char *etiquetas,
+                                const uint64_t *buckets, uint64_t suma_ns);
+
+/*Funciones de la biblioteca*/
+
+int metricas_iniciar(void)
+{
+    void *mapeo = mmap(NULL, METRICAS_PARTES * sizeof(metricas_parte), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (mapeo == MAP_FAILED)
+    {
+        perror("Error al reservar las métricas");
+        return -1;
+    }
+
+    if (pthread_atfork(NULL, NULL, olvidar_parte) != 0)
+    {
+        fprintf(stderr, "Error en pthread_atfork\n");
+        munmap(mapeo, METRICAS_PARTES * sizeof(metricas_parte));
+        return -1;
+    }
+
+    // mmap anónimo ya viene en cero
+    partes = (metricas_parte *)mapeo;
+
+    return 0;
+}
+
+void metricas_pedido(unsigned int ruta, unsigned int codigo, int64_t duracion_ns)
+{
+    metricas_parte *p = parte();
+    unsigned int i = 0;
+
+    if (p == NULL || ruta >= METRICAS_RUTAS)
+    {
+        return;
+    }
+
+    while (i < METRICAS_CODIGOS - 1 && codigos[i] != codigo)
+    {
+        i++;
+    }
+
+    atomic_fetch_add_explicit(&p->codigos[ruta][i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->pedidos[ruta][bucket(duracion_ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->duracion_ns[ruta], duracion_ns > 0 ? duracion_ns : 0, memory_order_relaxed);
+}
+
+void metricas_enviados(size_t bytes)
+{
+    metricas_parte *p = parte();
+
+    if (p != NULL && bytes > 0)
+    {
+        atomic_fetch_add_explicit(&p->enviados, bytes, memory_order_relaxed);
+    }
+}
+
+void metricas_conexion_abierta(void)
+{
+    metricas_parte *p = parte();
+
+    if (p != NULL)
+    {
+        atomic_fetch_add_explicit(&p->conexiones_abiertas, 1, memory_order_relaxed);
+    }
+}
+
+void metricas_conexion_cerrada(void)
+{
+    metricas_parte *p = parte();
+
+    if (p != NULL)
+    {
+        atomic_fetch_add_explicit(&p->conexiones_cerradas, 1, memory_order_relaxed);
+    }
+}
+
+void metricas_muestreo(int64_t lectura_ns, int64_t retraso_ns)
+{
+    metricas_parte *p = parte();
+
+    if (p == NULL)
+    {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&p->lecturas[bucket(lectura_ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->lectura_ns, lectura_ns > 0 ? lectura_ns : 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->retrasos[bucket(retraso_ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->retraso_ns, retraso_ns > 0 ? retraso_ns : 0, memory_order_relaxed);
+}
+
+int metricas_escribir(char *texto, size_t texto_size, const char *const *rutas, unsigned int n_rutas,
+                      shared_buffer *buffer, const historial *h)
+{
+    metricas_totales *totales;
+    exposicion e = {texto, texto_size, 0, 0};
+    buffer_estadisticas estadisticas;
+    buffer_muestreo muestreo;
+    historial_punto puntos[N_PERIODOS];
+    char etiquetas[128];
+    float temp;
+    int64_t tiempo_ns;
+    int64_t ahora_ms;
+    uint64_t conexiones;
+
+    if (partes == NULL || n_rutas > METRICAS_RUTAS)
+    {
+        return -1;
+    }
+
+    if (buffer_get_estadisticas(buffer, &estadisticas) || buffer_get_muestreo(buffer, &muestreo) ||
+        buffer_get_temp(buffer, BUFFER_SIZE - 1, &temp) || buffer_get_time(buffer, BUFFER_SIZE - 1, &tiempo_ns))
+    {
+        return -1;
+    }
+
+    // Son más de 8 KiB, no van en la pila
+    if ((totales = (metricas_totales *)malloc(sizeof(metricas_totales))) == NULL)
+    {
+        fprintf(stderr, "Error al reservar memoria para las métricas\n");
+        return -1;
+    }
+
+    sumar(totales);
+
+    // Pedidos
+    escribir(&e, "# HELP webserver_http_requests_total HTTP requests answered, by route and status code.\n"
+                 "# TYPE webserver_http_requests_total counter\n");
+    for (unsigned int r = 0; r < n_rutas; r++)
+    {
+        for (unsigned int c = 0; c < METRICAS_CODIGOS; c++)
+        {
+            if (totales->codigos[r][c] == 0)
+            {
+                continue;
+            }
+
+            if (c < METRICAS_CODIGOS - 1)
+            {
+                escribir(&e, "webserver_http_requests_total{route=\"%s\",code=\"%u\"} %llu\n",
+                         rutas[r], codigos[c], (unsigned long long)totales->codigos[r][c]);
+            }
+            else
+            {
+                escribir(&e, "webserver_http_requests_total{route=\"%s\",code=\"other\"} %llu\n",
+                         rutas[r], (unsigned long long)totales->codigos[r][c]);
+            }
+        }
+    }
+
+    escribir(&e, "# HELP webserver_http_request_duration_seconds Time to build the response, by route.\n"
+                 "# TYPE webserver_http_request_duration_seconds histogram\n");
+    for (unsigned int r = 0; r < n_rutas; r++)
+    {
+        snprintf(etiquetas, sizeof(etiquetas), "route=\"%s\"", rutas[r]);
+        escribir_histograma(&e, "webserver_http_request_duration_seconds", etiquetas,
+                            totales->pedidos[r], totales->duracion_ns[r]);
+    }
+
+    // Conexiones: se abren y se cierran en partes distintas, solo la resta de los totales tiene sentido
+    conexiones = totales->conexiones_abiertas - totales->conexiones_cerradas;
+
+    escribir(&e, "# HELP webserver_http_sent_bytes_total Bytes sent to clients, including streams.\n"
+                 "# TYPE webserver_http_sent_bytes_total counter\n"
+                 "webserver_http_sent_bytes_total %llu\n"
+                 "# HELP webserver_connections_accepted_total Connections accepted.\n"
+                 "# TYPE webserver_connections_accepted_total counter\n"
+                 "webserver_connections_accepted_total %llu\n"
+                 "# HELP webserver_connections_active Connections currently open.\n"
+                 "# TYPE webserver_connections_active gauge\n"
+                 "webserver_connections_active %lld\n",
+             (unsigned long long)totales->enviados, (unsigned long long)totales->conexiones_abiertas,
+             (long long)conexiones);
+
+    // Muestreo
+    escribir(&e, "# HELP webserver_sensor_read_duration_seconds Time to read the sensor device.\n"
+                 "# TYPE webserver_sensor_read_duration_seconds histogram\n");
+    escribir_histograma(&e, "webserver_sensor_read_duration_seconds", "", totales->lecturas, totales->lectura_ns);
+
+    escribir(&e, "# HELP webserver_sensor_jitter_seconds Delay of each read after its timer expiration.\n"
+                 "# TYPE webserver_sensor_jitter_seconds histogram\n");
+    escribir_histograma(&e, "webserver_sensor_jitter_seconds", "", totales->retrasos, totales->retraso_ns);
+
+    escribir(&e, "# HELP webserver_sensor_period_seconds Sampling period.\n"
+                 "# TYPE webserver_sensor_period_seconds gauge\n"
+                 "webserver_sensor_period_seconds %.6f\n"
+                 "# HELP webserver_sensor_samples_total Sampling periods served since start.\n"
+                 "# TYPE webserver_sensor_samples_total counter\n"
+                 "webserver_sensor_samples_total %u\n"
+                 "# HELP webserver_sensor_missed_total Timer expirations skipped because a read took longer than a period.\n"
+                 "# TYPE webserver_sensor_missed_total counter\n"
+                 "webserver_sensor_missed_total %u\n"
+                 "# HELP webserver_sensor_errors_total Failed sensor reads.\n"
+                 "# TYPE webserver_sensor_errors_total counter\n"
+                 "webserver_sensor_errors_total %u\n"
+                 "# HELP webserver_sensor_jitter_max_seconds Largest delay after a timer expiration since start.\n"
+                 "# TYPE webserver_sensor_jitter_max_seconds gauge\n"
+                 "webserver_sensor_jitter_max_seconds %.6f\n"
+                 "# HELP webserver_sensor_jitter_stddev_seconds Standard deviation of the delay after a timer expiration.\n"
+                 "# TYPE webserver_sensor_jitter_stddev_seconds gauge\n"
+                 "webserver_sensor_jitter_stddev_seconds %.6f\n"
+                 "# HELP webserver_sensor_read_max_seconds Longest sensor read since start.\n"
+                 "# TYPE webserver_sensor_read_max_seconds gauge\n"
+                 "webserver_sensor_read_max_seconds %.6f\n",
+             muestreo.periodo_us / 1e6, muestreo.muestras, muestreo.perdidas, muestreo.errores,
+             muestreo.retraso_max_us / 1e6, muestreo.retraso_desvio_us / 1e6, muestreo.lectura_max_us / 1e6);
+
+    // Buffer y temperatura
+    escribir(&e, "# HELP webserver_buffer_samples Samples in the window.\n"
+                 "# TYPE webserver_buffer_samples gauge\n"
+                 "webserver_buffer_samples %u\n"
+                 "# HELP webserver_buffer_capacity Samples the window holds.\n"
+                 "# TYPE webserver_buffer_capacity gauge\n"
+                 "webserver_buffer_capacity %d\n"
+                 "# HELP webserver_temperature_celsius Last sample, -1 if the sensor could not be read.\n"
+                 "# TYPE webserver_temperature_celsius gauge\n"
+                 "webserver_temperature_celsius %.2f\n"
+                 "# HELP webserver_temperature_timestamp_seconds Time of the last sample since 1970.\n"
+                 "# TYPE webserver_temperature_timestamp_seconds gauge\n"
+                 "webserver_temperature_timestamp_seconds %.3f\n",
+             estadisticas.cantidad, BUFFER_SIZE, temp, buffer_tiempo_real_ns(buffer, tiempo_ns) / 1e9);
+
+    escribir(&e, "# HELP webserver_window_temperature_celsius Statistics of the samples in the window.\n"
+                 "# TYPE webserver_window_temperature_celsius gauge\n");
+    if (estadisticas.cantidad > 0)
+    {
+        escribir(&e, "webserver_window_temperature_celsius{stat=\"mean\"} %.3f\n"
+                     "webserver_window_temperature_celsius{stat=\"min\"} %.2f\n"
+                     "webserver_window_temperature_celsius{stat=\"max\"} %.2f\n"
+                     "webserver_window_temperature_celsius{stat=\"std\"} %.3f\n"
+                     "webserver_window_temperature_celsius{stat=\"p50\"} %.2f\n"
+                     "webserver_window_temperature_celsius{stat=\"p95\"} %.2f\n"
+                     "webserver_window_temperature_celsius{stat=\"p99\"} %.2f\n"
+                     "webserver_window_temperature_celsius{stat=\"ewma\"} %.3f\n",
+                 estadisticas.media, estadisticas.minimo, estadisticas.maximo, estadisticas.desvio,
+                 estadisticas.p50, estadisticas.p95, estadisticas.p99, estadisticas.ewma);
+    }
+
+    // Agregados del período en curso de cada nivel del historial
+    if (h != NULL)
+    {
+        ahora_ms = buffer_tiempo_real_ns(buffer, buffer_ahora_ns()) / 1000000;
+
+        for (size_t i = 0; i < N_PERIODOS; i++)
+        {
+            int64_t desde = ahora_ms - ahora_ms % periodos[i].ancho_ms;
+
+            if (historial_consultar(h, desde, desde + periodos[i].ancho_ms, periodos[i].ancho_ms, &puntos[i], NULL, 1) < 0)
+            {
+                puntos[i].cantidad = 0;
+            }
+        }
+
+        // Cada métrica va con todas sus series juntas
+        escribir(&e, "# HELP webserver_rollup_samples Samples in the current UTC minute, hour and day.\n"
+                     "# TYPE webserver_rollup_samples gauge\n");
+        for (size_t i = 0; i < N_PERIODOS; i++)
+        {
+            escribir(&e, "webserver_rollup_samples{period=\"%s\"} %u\n", periodos[i].nombre, puntos[i].cantidad);
+        }
+
+        escribir(&e, "# HELP webserver_rollup_temperature_celsius Statistics of the current UTC minute, hour and day.\n"
+                     "# TYPE webserver_rollup_temperature_celsius gauge\n");
+        for (size_t i = 0; i < N_PERIODOS; i++)
+        {
+            double media;
+            double varianza;
+
+            if (puntos[i].cantidad == 0)
+            {
+                continue;
+            }
+
+            media = puntos[i].suma / puntos[i].cantidad;
+            // Con muestras iguales el redondeo puede dar una varianza apenas negativa
+            varianza = fmax(0, puntos[i].suma_cuadrados / puntos[i].cantidad - media * media);
+
+            escribir(&e, "webserver_rollup_temperature_celsius{period=\"%s\",stat=\"mean\"} %.3f\n"
+                         "webserver_rollup_temperature_celsius{period=\"%s\",stat=\"min\"} %.2f\n"
+                         "webserver_rollup_temperature_celsius{period=\"%s\",stat=\"max\"} %.2f\n"
+                         "webserver_rollup_temperature_celsius{period=\"%s\",stat=\"std\"} %.3f\n",
+                     periodos[i].nombre, media, periodos[i].nombre, puntos[i].minimo,
+                     periodos[i].nombre, puntos[i].maximo, periodos[i].nombre, sqrt(varianza));
+        }
+    }
+
+    free(totales);
+
+    if (e.desbordado)
+    {
+        fprintf(stderr, "Las métricas no entran en %zu bytes\n", texto_size);
+        return -1;
+    }
+
+    return (int)e.longitud;
+}
+
+/*Funciones privadas*/
+
+/**
+ * @brief Al hacer fork el hijo elige su propia parte en el próximo registro
+ */
+static void olvidar_parte(void)
+{
+    propia = NULL;
+}
+
+static metricas_parte *parte(void)
+{
+    if (propia == NULL && partes != NULL)
+    {
+        propia = &partes[getpid() % METRICAS_PARTES];
+    }
+
+    return propia;
+}
+
+static unsigned int bucket(int64_t ns)
+{
+    unsigned int i = 0;
+
+    while (i < METRICAS_BUCKETS - 1 && ns > limites_ns[i])
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Suma todas las partes
+ *
+ * Cada contador se lee por separado mientras otros procesos siguen sumando:
+ * el resultado no es una foto de un instante, pero ningún contador retrocede.
+ */
+static void sumar(metricas_totales *totales)
+{
+    memset(totales, 0, sizeof(*totales));
+
+    for (unsigned int k = 0; k < METRICAS_PARTES; k++)
+    {
+        metricas_parte *p = &partes[k];
+
+        for (unsigned int r = 0; r < METRICAS_RUTAS; r++)
+        {
+            for (unsigned int b = 0; b < METRICAS_BUCKETS; b++)
+            {
+                totales->pedidos[r][b] += atomic_load_explicit(&p->pedidos[r][b], memory_order_relaxed);
+            }
+
+            for (unsigned int c = 0; c < METRICAS_CODIGOS; c++)
+            {
+                totales->codigos[r][c] += atomic_load_explicit(&p->codigos[r][c], memory_order_relaxed);
+            }
+
+            totales->duracion_ns[r] += atomic_load_explicit(&p->duracion_ns[r], memory_order_relaxed);
+        }
+
+        for (unsigned int b = 0; b < METRICAS_BUCKETS; b++)
+        {
+            totales->lecturas[b] += atomic_load_explicit(&p->lecturas[b], memory_order_relaxed);
+            totales->retrasos[b] += atomic_load_explicit(&p->retrasos[b], memory_order_relaxed);
+        }
+
+        totales->enviados += atomic_load_explicit(&p->enviados, memory_order_relaxed);
+        totales->lectura_ns += atomic_load_explicit(&p->lectura_ns, memory_order_relaxed);
+        totales->retraso_ns += atomic_load_explicit(&p->retraso_ns, memory_order_relaxed);
+        // Las cerradas antes que las abiertas: así la resta nunca da negativa
+        totales->conexiones_cerradas += atomic_load_explicit(&p->conexiones_cerradas, memory_order_relaxed);
+    }
+
+    for (unsigned int k = 0; k < METRICAS_PARTES; k++)
+    {
+        totales->conexiones_abiertas += atomic_load_explicit(&partes[k].conexiones_abiertas, memory_order_relaxed);
+    }
+}
+
+static void escribir(exposicion *e, const char *formato, ...)
+{
+    va_list argumentos;
+    int escrito;
+
+    if (e->desbordado)
+    {
+        return;
+    }
+
+    va_start(argumentos, formato);
+    escrito = vsnprintf(e->texto + e->longitud, e->size - e->longitud, formato, argumentos);
+    va_end(argumentos);
+
+    if (escrito < 0 || (size_t)escrito >= e->size - e->longitud)
+    {
+        e->desbordado = 1;
+        return;
+    }
+
+    e->longitud += escrito;
+}
+
+/**
+ * @brief Escribe los buckets acumulados, la suma y la cuenta de un histograma
+ *
+ * @param etiquetas Etiquetas además de le, "" si no hay
+ */
+static void escribir_histograma(exposicion *e, const char *nombre, const char *etiquetas,
+                                const uint64_t *buckets, uint64_t suma_ns)
+{
+    const char *separador = (etiquetas[0] != '\0') ? "," : "";
+    uint64_t acumulado = 0;
+
+    for (unsigned int b = 0; b < METRICAS_BUCKETS; b++)
+    {
+        acumulado += buckets[b];
+        escribir(e, "%s_bucket{%s%sle=\"%s\"} %llu\n", nombre, etiquetas, separador, limites_texto[b],
+                 (unsigned long long)acumulado);
+    }
+
+    if (etiquetas[0] != '\0')
+    {
+        escribir(e, "%s_sum{%s} %.9f\n%s_count{%s} %llu\n", nombre, etiquetas, suma_ns / 1e9,
+                 nombre, etiquetas, (unsigned long long)acumulado);
+    }
+    else
+    {
+        escribir(e, "%s_sum %.9f\n%s_count %llu\n", nombre, suma_ns / 1e9, nombre, (unsigned long long)acumulado);
+    }
+}
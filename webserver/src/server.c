@@ -13,6 +13,12 @@
 #include "../inc/buffer.h"
 #include "../inc/server_client.h"
 #include "../inc/server_temp.h"
+#include "../inc/server_epoll.h"
+#include "../inc/static_cache.h"
+#include "../inc/historial.h"
+#include "../inc/metricas.h"
+
+#include <time.h>
 
 #define FILENAME_DIR_MAX 256
 char cCurrentPath[FILENAME_DIR_MAX];
@@ -23,7 +29,15 @@ int main(int argc, char *argv[])
 {
   int socket_id;
   int shmid;
+  int modo = SERVER_MODO_EPOLL;
+  int opcion;
+  float ewma_alfa = BUFFER_EWMA_ALFA;
+  long periodo_ms = SENSOR_PERIODO_MS;
+  char *fin;
+  char *puerto = NULL;
   struct shared_buffer *buffer = NULL;
+  historial hist;
+  int con_historial;
 
   struct sockaddr_in datosServidor;
   socklen_t longDirec;
@@ -34,12 +48,43 @@ int main(int argc, char *argv[])
 
   printf("Current folder: %s\n", cCurrentPath);
 
-  if (argc != 2)
+  // Modo de atencion de clientes: -m epoll (por defecto) o -m fork
+  // Peso de la muestra nueva en el promedio exponencial de /stats: -a alfa
+  // Período de muestreo del sensor en ms: -p periodo (0: el del driver, se espera cada muestra con poll)
+  while ((opcion = getopt(argc, argv, "m:a:p:")) != -1)
   {
-    printf("\n\nLinea de comandos: webserver Puerto\n\n");
+    if (opcion == 'm' && strcmp(optarg, "fork") == 0)
+    {
+      modo = SERVER_MODO_FORK;
+    }
+    else if (opcion == 'm' && strcmp(optarg, "epoll") == 0)
+    {
+      modo = SERVER_MODO_EPOLL;
+    }
+    else if (opcion == 'a' && (ewma_alfa = strtof(optarg, &fin)) > 0 && ewma_alfa <= 1 && *fin == '\0')
+    {
+      continue;
+    }
+    else if (opcion == 'p' && (periodo_ms = strtol(optarg, &fin, 10)) <= 3600000 && *fin == '\0' &&
+             (periodo_ms >= SENSOR_PERIODO_MIN_MS || periodo_ms == SENSOR_PERIODO_DRIVER))
+    {
+      continue;
+    }
+    else
+    {
+      printf("\n\nLinea de comandos: webserver [-m epoll|fork] [-a alfa] [-p periodo_ms|0] Puerto\n\n");
+      return -1;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    printf("\n\nLinea de comandos: webserver [-m epoll|fork] [-a alfa] [-p periodo_ms|0] Puerto\n\n");
     return -1;
   }
 
+  puerto = argv[optind];
+
   // Creamos el socket
   socket_id = socket(AF_INET, SOCK_STREAM, 0);
 
@@ -51,19 +96,19 @@ int main(int argc, char *argv[])
 
   // Asigna el puerto indicado y una IP de la maquina
   datosServidor.sin_family = AF_INET;
-  datosServidor.sin_port = htons(atoi(argv[1]));
+  datosServidor.sin_port = htons(atoi(puerto));
   datosServidor.sin_addr.s_addr = htonl(INADDR_ANY);
 
   // Obtiene el puerto para este proceso.
   if (bind(socket_id, (struct sockaddr *)&datosServidor, sizeof(datosServidor)) == -1)
   {
-    printf("ERROR: este proceso no puede tomar el puerto %s\n", argv[1]);
+    printf("ERROR: este proceso no puede tomar el puerto %s\n", puerto);
     return -1;
   }
 
-  printf("\nServidor Web iniciado en el puerto %s\n", argv[1]);
+  printf("\nServidor Web iniciado en el puerto %s\n", puerto);
 
-  printf("\nIngrese en el navegador http://ip_beaglebone:%s\n", argv[1]);
+  printf("\nIngrese en el navegador http://ip_beaglebone:%s\n", puerto);
 
   // Indicar que el socket encole hasta MAX_CONN pedidos de conexion simultaneas.
 
@@ -82,7 +127,39 @@ int main(int argc, char *argv[])
     close(socket_id);
     return -1;
   }
+
+  buffer_set_ewma_alfa(buffer, ewma_alfa);
   
+  // Cargamos en memoria los archivos estaticos
+
+  if (static_cache_iniciar(STATIC_CACHE_DIR) < 0)
+  {
+    fprintf(stderr, "Error en static_cache_iniciar.\n");
+    buffer_destroy(&buffer , shmid); // Destruimos el buffer
+    close(socket_id);
+    return -1;
+  }
+
+  // Abrimos el historial persistente antes del fork, todos los procesos comparten el mapeo
+
+  con_historial = (historial_abrir(&hist, HISTORIAL_ARCHIVO) == 0);
+
+  if (!con_historial)
+  {
+    fprintf(stderr, "Sin historial persistente.\n");
+  }
+  else
+  {
+    server_client_usar_historial(&hist);
+  }
+
+  // Contadores de /metrics en memoria compartida, cada proceso suma en su parte
+
+  if (metricas_iniciar() < 0)
+  {
+    fprintf(stderr, "Sin metricas.\n");
+  }
+
   // Creamos un proceso hijo que carga el buffer
 
   pid_t pid = fork();
@@ -103,12 +180,22 @@ int main(int argc, char *argv[])
     // y que el proceso padre pueda terminar sin que el hijo termine.
 
     float new_temp = 0.0;
+    int leida;
+    sensor s;
+
+    if (sensor_abrir(&s, periodo_ms) < 0)
+    {
+      fprintf(stderr, "Error en sensor_abrir.\n");
+      exit(1);
+    }
+
     while (1)
     {
-      // Carga el buffer
-      new_temp = get_temp();
+      // Espera el próximo período y carga el buffer solo si hay una muestra nueva:
+      // la cola del driver puede estar vacía si el período es menor que el suyo
+      leida = sensor_muestrear(&s, &new_temp);
 
-      if (buffer_put(buffer, new_temp) < 0)
+      if (leida == 0 && buffer_put(buffer, s.tiempo_ns, new_temp) < 0)
       {
         fprintf(stderr, "Error en buffer_put.\n");
         buffer_destroy(&buffer, shmid); // Destruimos el buffer
@@ -116,10 +203,30 @@ int main(int argc, char *argv[])
         exit(1);
       }
 
-      sleep(BUFFER_TIME_SLEEP);
+      // El -1 de una lectura fallida no es una temperatura: no entra a los agregados del historial
+      if (con_historial && leida == 0)
+      {
+        // Hora real con el ancla del buffer: no retrocede si se cambia la hora del sistema
+        if (historial_agregar(&hist, buffer_tiempo_real_ns(buffer, s.tiempo_ns) / 1000000, new_temp) < 0)
+        {
+          fprintf(stderr, "Error en historial_agregar.\n");
+        }
+      }
+
+      buffer_set_muestreo(buffer, &s.muestreo);
+      metricas_muestreo(s.lectura_ns, s.retraso_ns);
     } // End of while loop
   } // End of child process
 
+  else if (pid > 0 && modo == SERVER_MODO_EPOLL)
+  {
+    // Proceso padre: un solo proceso atiende a todos los clientes
+    if (server_epoll_run(socket_id, buffer) < 0)
+    {
+      fprintf(stderr, "Error en server_epoll_run.\n");
+    }
+  }
+
   else if (pid > 0)
   {
     // Proceso padre
@@ -143,6 +250,9 @@ int main(int argc, char *argv[])
         return -1;
       }
 
+      // Los hijos heredan la cache, se recarga antes si cambió algún archivo
+      static_cache_revisar();
+
       pid_padre = fork();
       if (pid_padre < 0)
       {
@@ -153,7 +263,7 @@ int main(int argc, char *argv[])
       }
       if (pid_padre == 0)
       {       // Proceso hijo.
-        ProcesarCliente(s_aux_padre, &datosCliente, atoi(argv[1]), buffer);
+        ProcesarCliente(s_aux_padre, &datosCliente, atoi(puerto), buffer);
         return -1;
       }
     
@@ -163,6 +273,11 @@ int main(int argc, char *argv[])
 
   printf("\nServidor Web finalizado\n");
 
+  if (con_historial)
+  {
+    historial_cerrar(&hist);
+  }
+
   buffer_destroy(&buffer , shmid); // Destruimos el buffer
   close(socket_id); // Cerramos el socket
 
@@ -11,283 +11,1304 @@
 
 #include "../inc/server_client.h"
 #include "../inc/buffer.h"
+#include "../inc/static_cache.h"
+#include "../inc/server_sse.h"
+#include "../inc/server_websocket.h"
+#include "../inc/json_writer.h"
+#include "../inc/metricas.h"
 
 #include <arpa/inet.h> // Add this line to include the header file
 #include <time.h>
+#include <math.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/sendfile.h>
+#include <zlib.h>
 
 #define BUFFER_COMUNIC_SIZE 16384
 #define IP_ADDR_SIZE 20
-#define HTML_SIZE 8192
-#define HTML_HEADER_SIZE 4096
+#define RESPUESTA_HEADER_SIZE 256
+#define PARRAFO_SIZE 128
+#define ETAG_SIZE 64
+#define CABECERA_EXTRA_SIZE 192
+#define JSON_COMPRIMIR_MIN 256 //Los JSON más chicos se envían sin comprimir
+#define RANGO_PUNTOS_DEFECTO 500 //Puntos de /GetData?from= si no se indica step ni points
+#define RANGO_SEGUNDOS_MAX 100000000000LL //Límite de from y to, las horas en ms entran de sobra en 64 bits
+#define RANGO_CUANTILES_MAX 4 //Cuantiles como máximo en q=
+#define RANGO_PUNTOS_CUANTILES_MAX 1000 //Puntos como máximo si se piden cuantiles, cada uno lleva su resumen
+#define JSON_RANGO_SIZE (128 + 5 * (size_t)HISTORIAL_PUNTOS_MAX * JSON_ENTERO_MAX + \
+                         RANGO_CUANTILES_MAX * (16 + (size_t)RANGO_PUNTOS_CUANTILES_MAX * JSON_ENTERO_MAX))
 
-#define FILE_HTML_HEADER_ADDR  "public/html/header.html\0"
-#define FILE_CSS_ADDR "public/css/style.css\0"
+/*Rutas dentro de la cache de archivos estáticos*/
+#define FILE_HTML_HEADER_ADDR  "/html/header.html"
+#define FILE_CSS_ADDR "/css/style.css"
+#define FILE_PNG_ADDR "/image/logo-utn-frba.png"
 //#define FILE_HTML_BODY_ADDR "public/html/body.html\0"
 //#define FILE_HTML_FOOTER_ADDR "public/html/footer.html\0"
 
 /*Funciones privadas*/
 
-static int get_string_from_file(char *file_name, char *string);
-static void send_png(int client_socket, const char *file_path, const char *content_type);
-static void send_response(int client_socket, const char *response);
-static void generate_json(char *json, float * temp_data, float * time_data, int size);
+static int armar_cabecera(char *cabecera, size_t cabecera_size, const char *estado, const char *content_type, size_t cuerpo_len, const char *extra, int cerrar);
+static int armar_respuesta(respuesta_http *respuesta, const char *estado, const char *content_type, const char *cuerpo, size_t cuerpo_len, const char *extra);
+static int responder_archivo(respuesta_http *respuesta, const char *datos, const http_pedido *pedido, const char *ruta, size_t ruta_len);
+static int responder_no_modificado(respuesta_http *respuesta, const char *extra);
+static int etag_coincide(const char *datos, const http_pedido *pedido, const char *etag);
+static unsigned int codificaciones_aceptadas(const char *datos, const http_pedido *pedido);
+static unsigned int codigo_respuesta(const respuesta_http *respuesta);
+static int comprimir_json(const char *json, size_t json_len, uint32_t arranque, uint32_t secuencia);
+static int responder_rango(const char *datos, const http_pedido *pedido, respuesta_http *respuesta);
+static int parametro_entero(const char *datos, const http_pedido *pedido, const char *nombre, int64_t *valor);
+static int parametro_cuantiles(const char *datos, const http_pedido *pedido, int64_t *cuantiles);
+
+static int ruta_index(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+static int ruta_datos(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+static int ruta_stream(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+static int ruta_estadisticas(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+static int ruta_websocket(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+static int ruta_metricas(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+
+/*Variables privadas*/
+
+/// @brief 1 si el servidor puede mantener conexiones suscriptas (modo epoll)
+static int flujos_habilitados = 0;
+
+/// @brief Cabecera de /stream con el tiempo de reconexión como primer evento
+static const char cabecera_sse[] = SSE_CABECERA "retry: " STR(SSE_REINTENTO_MS) "\n\n";
+
+/// @brief JSON de /GetData, se serializa siempre sobre el mismo buffer
+static char json_muestras[JSON_MUESTRAS_SIZE(BUFFER_SIZE)];
+
+/// @brief Historial para las consultas con rango, NULL si no hay
+static const historial *historial_datos = NULL;
+
+/// @brief Resultado de /GetData con rango, se reutiliza entre pedidos
+static struct
+{
+  historial_punto puntos[HISTORIAL_PUNTOS_MAX];
+  int64_t time[HISTORIAL_PUNTOS_MAX];
+  float temp[HISTORIAL_PUNTOS_MAX];
+  float minimo[HISTORIAL_PUNTOS_MAX];
+  float maximo[HISTORIAL_PUNTOS_MAX];
+  float desvio[HISTORIAL_PUNTOS_MAX];
+  cuantiles_digest digestos[RANGO_PUNTOS_CUANTILES_MAX];
+  float cuantiles[RANGO_CUANTILES_MAX][RANGO_PUNTOS_CUANTILES_MAX];
+  char json[JSON_RANGO_SIZE];
+} rango;
+
+/// @brief Último JSON comprimido, se reutiliza hasta que llega otra muestra
+static struct
+{
+  int valido;
+  uint32_t arranque;
+  uint32_t secuencia;
+  char *datos;
+  size_t longitud;
+  size_t capacidad;
+} json_comprimido;
+
+/*Tabla de rutas*/
+
+typedef struct ruta_http
+{
+  const char *metodo;
+  const char *ruta;
+  int (*atender)(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta);
+  const char *archivo; // Si atender es NULL se sirve este archivo de la cache
+} ruta_http;
+
+static const ruta_http rutas[] =
+{
+  {"GET", "/", ruta_index, NULL},
+  {"GET", "/styles.css", NULL, FILE_CSS_ADDR},
+  {"GET", "/logo-utn-frba.png", NULL, FILE_PNG_ADDR},
+  {"GET", "/GetData", ruta_datos, NULL},
+  {"GET", "/stream", ruta_stream, NULL},
+  {"GET", "/stats", ruta_estadisticas, NULL},
+  {"GET", "/ws", ruta_websocket, NULL},
+  {"GET", "/metrics", ruta_metricas, NULL},
+};
+
+#define N_RUTAS (sizeof(rutas) / sizeof(rutas[0]))
+#define RUTA_ARCHIVOS N_RUTAS //Ruta para /metrics del resto de los archivos de public/
+#define RUTA_OTRA (N_RUTAS + 1) //Ruta para /metrics de los pedidos mal formados o con otro método
+
+_Static_assert(N_RUTAS + 2 <= METRICAS_RUTAS, "METRICAS_RUTAS no alcanza para la tabla de rutas");
 
 /*Funciones de la biblioteca*/
 
 /**
- * @brief 
- * 
- * @param s_aux 
- * @param pDireccionCliente 
- * @param puerto 
- * @param buffer 
- * @return int 
+ * @brief Atiende los pedidos de una conexión persistente en el socket s_aux (modo fork)
+ *
+ * @param s_aux
+ * @param pDireccionCliente
+ * @param puerto
+ * @param buffer
+ * @return int
  */
 int ProcesarCliente(int s_aux, struct sockaddr_in *pDireccionCliente, int puerto, shared_buffer *buffer)
 {
   char bufferComunic[BUFFER_COMUNIC_SIZE];
+  size_t bufferComunic_len = 0;
   char ipAddr[IP_ADDR_SIZE];
   int Port;
-  float tempCelsius;
-  char HTML[HTML_SIZE];
-  char encabezadoHTML[HTML_HEADER_SIZE];
-
-  float time[BUFFER_SIZE];
-  float temp[BUFFER_SIZE];
+  ssize_t recibido;
+  ssize_t consumido = 0;
+  unsigned int pedidos = 0;
+  int cerrar = 0;
+  respuesta_http respuesta;
+  http_pedido pedido;
+  struct timeval timeout = {KEEPALIVE_TIMEOUT, 0};
 
   strcpy(ipAddr, inet_ntoa(pDireccionCliente->sin_addr));
   Port = ntohs(pDireccionCliente->sin_port);
 
-  // Recibe el mensaje del cliente
-  if (recv(s_aux, bufferComunic, sizeof(bufferComunic), 0) == -1)
+  // Si el cliente no envía nada durante KEEPALIVE_TIMEOUT se cierra la conexión
+  setsockopt(s_aux, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  http_parser_iniciar(&pedido);
+  metricas_conexion_abierta();
+
+  while (!cerrar)
   {
-    fprintf(stderr, "Error en recv");
-    return -1;
+    // Recibe el mensaje del cliente
+    recibido = recv(s_aux, bufferComunic + bufferComunic_len,
+                    sizeof(bufferComunic) - 1 - bufferComunic_len, 0);
+
+    if (recibido <= 0)
+    {
+      if (recibido < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        fprintf(stderr, "Error en recv");
+      }
+      break;
+    }
+
+    bufferComunic_len += recibido;
+    bufferComunic[bufferComunic_len] = '\0';
+
+    printf("* Recibido del navegador Web %s:%d:\n%s\n",
+            ipAddr, Port, bufferComunic);
+
+    // Atiende todos los pedidos completos que haya en el buffer (pipelining)
+    while (!cerrar && (consumido = server_client_atender_pedido(bufferComunic, bufferComunic_len, &pedido, pedidos, buffer, &respuesta)) > 0)
+    {
+      // Envia el mensaje al cliente
+      if (server_client_enviar_respuesta(s_aux, &respuesta) != 1)
+      {
+        fprintf(stderr, "Error en send");
+        respuesta.cerrar = 1;
+      }
+
+      cerrar = respuesta.cerrar;
+      server_client_liberar_respuesta(&respuesta);
+
+      pedidos++;
+      bufferComunic_len -= consumido;
+      memmove(bufferComunic, bufferComunic + consumido, bufferComunic_len + 1);
+    }
+
+    if (consumido < 0 || bufferComunic_len >= sizeof(bufferComunic) - 1)
+    {
+      // Error al generar la respuesta o cabecera demasiado grande
+      break;
+    }
   }
-  printf("* Recibido del navegador Web %s:%d:\n%s\n",
-          ipAddr, Port, bufferComunic);
 
-  // Obtiene la temperatura del buffer
-  
-  if (buffer_avg(buffer, &tempCelsius))
+  // Cierra la conexion con el cliente actual
+  close(s_aux);
+  metricas_conexion_cerrada();
+
+  return 0;
+}
+
+/**
+ * @brief Responde 304 Not Modified, sin cuerpo
+ *
+ * @param extra Cabeceras ETag y Cache-Control terminadas en "\r\n"
+ * @return int 0 si se pudo reservar la memoria, -1 si no
+ */
+static int responder_no_modificado(respuesta_http *respuesta, const char *extra)
+{
+  char cabecera[RESPUESTA_HEADER_SIZE];
+  int cabecera_len;
+
+  cabecera_len = snprintf(cabecera, sizeof(cabecera),
+    "HTTP/1.1 304 Not Modified\r\n"
+    "%s"
+    "%s\r\n",
+    extra, respuesta->cerrar ? CABECERA_CLOSE : CABECERA_KEEPALIVE);
+
+  if ((respuesta->datos = (char *)malloc(cabecera_len)) == NULL)
   {
-    fprintf(stderr, "Error en buffer_avg");
+    fprintf(stderr, "Error al reservar memoria para la respuesta\n");
     return -1;
   }
 
-  // Cargo el vector time con datos del buffer
+  memcpy(respuesta->datos, cabecera, cabecera_len);
 
-  for(int i = 0; i < BUFFER_SIZE; i++)
+  respuesta->segmentos[0].iov_base = respuesta->datos;
+  respuesta->segmentos[0].iov_len = cabecera_len;
+  respuesta->n_segmentos = 1;
+  respuesta->longitud = cabecera_len;
+  respuesta->enviado = 0;
+
+  return 0;
+}
+
+/**
+ * @brief Indica si el If-None-Match del pedido coincide con el ETag
+ *
+ * @param etag ETag con comillas, puede seguir texto luego de la comilla final
+ */
+static int etag_coincide(const char *datos, const http_pedido *pedido, const char *etag)
+{
+  const http_segmento *if_none_match = http_pedido_cabecera(pedido, datos, "If-None-Match");
+  char etag_aux[ETAG_SIZE];
+  const char *fin;
+
+  if (if_none_match == NULL)
+  {
+    return 0;
+  }
+
+  // Recorta el ETag en la comilla de cierre
+  if ((fin = strchr(etag + 1, '"')) == NULL || (size_t)(fin - etag + 1) >= sizeof(etag_aux))
+  {
+    return 0;
+  }
+
+  memcpy(etag_aux, etag, fin - etag + 1);
+  etag_aux[fin - etag + 1] = '\0';
+
+  return http_segmento_contiene_etag(datos, *if_none_match, etag_aux);
+}
+
+ssize_t server_client_atender_pedido(char *entrada, size_t entrada_len, http_pedido *pedido, unsigned int pedidos, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  http_resultado resultado;
+  const http_segmento *connection;
+  int mantener_conexion;
+  size_t pedido_len;
+  int64_t inicio_ns;
+
+  resultado = http_parser_analizar(pedido, entrada, entrada_len);
+
+  if (resultado == HTTP_PARSER_INCOMPLETO)
   {
-    if (buffer_get_time(buffer, i, &time[i]))
+    return 0;
+  }
+
+  inicio_ns = buffer_ahora_ns();
+
+  if (resultado == HTTP_PARSER_ERROR)
+  {
+    // Pedido mal formado o sin saber dónde termina su cuerpo: se responde, se descarta el resto
+    // de la entrada y se cierra, lo que siga no se puede separar en pedidos
+    unsigned int codigo = pedido->codigo_error;
+    const char *estado = (codigo == 413) ? "413 Content Too Large" :
+                         (codigo == 501) ? "501 Not Implemented" : "400 Bad Request";
+
+    http_parser_iniciar(pedido);
+    server_client_iniciar_respuesta(respuesta);
+    respuesta->cerrar = 1;
+
+    if (armar_respuesta(respuesta, estado, "text/html; charset=utf-8", "", 0, ""))
     {
-      fprintf(stderr, "Error en buffer_get_time");
       return -1;
     }
+
+    metricas_pedido(RUTA_OTRA, codigo_respuesta(respuesta), buffer_ahora_ns() - inicio_ns);
+
+    return entrada_len;
+  }
+
+  // HTTP/1.1 mantiene la conexión salvo "Connection: close", HTTP/1.0 solo con "Connection: keep-alive"
+  connection = http_pedido_cabecera(pedido, entrada, "Connection");
+
+  if (pedido->version_menor == 1)
+  {
+    mantener_conexion = (connection == NULL || !http_segmento_contiene_token(entrada, *connection, "close"));
+  }
+  else
+  {
+    mantener_conexion = (connection != NULL && http_segmento_contiene_token(entrada, *connection, "keep-alive"));
+  }
+
+  if (pedidos + 1 >= KEEPALIVE_MAX_PEDIDOS)
+  {
+    mantener_conexion = 0;
+  }
+
+  pedido_len = pedido->longitud;
+
+  if (server_client_generar_respuesta(entrada, pedido, buffer, mantener_conexion, respuesta))
+  {
+    http_parser_iniciar(pedido);
+    return -1;
   }
 
-  // Cargo el vector temp con datos del buffer
+  metricas_pedido(respuesta->ruta, codigo_respuesta(respuesta), buffer_ahora_ns() - inicio_ns);
+
+  // El próximo pedido empieza al inicio de la entrada una vez consumido este
+  http_parser_iniciar(pedido);
+
+  return pedido_len;
+}
 
-  for(int i = 0; i < BUFFER_SIZE; i++)
+int server_client_generar_respuesta(const char *datos, const http_pedido *pedido, shared_buffer *buffer, int mantener_conexion, respuesta_http *respuesta)
+{
+  int ruta_encontrada = 0;
+  char allow[CABECERA_EXTRA_SIZE] = "Allow: ";
+
+  server_client_iniciar_respuesta(respuesta);
+  respuesta->cerrar = !mantener_conexion;
+
+  // Busca la ruta en la tabla
+  for (size_t i = 0; i < N_RUTAS; i++)
   {
-    if (buffer_get_temp(buffer, i, &temp[i]))
+    if (!http_segmento_igual(datos, pedido->ruta, rutas[i].ruta))
     {
-      fprintf(stderr, "Error en buffer_get_temp");
-      return -1;
+      continue;
     }
+
+    // Los métodos de la ruta van en el Allow del 405
+    if (ruta_encontrada)
+    {
+      strcat(allow, ", ");
+    }
+    strcat(allow, rutas[i].metodo);
+    ruta_encontrada = 1;
+
+    if (http_segmento_igual(datos, pedido->metodo, rutas[i].metodo))
+    {
+      respuesta->ruta = i;
+      if (rutas[i].atender == NULL)
+      {
+        return responder_archivo(respuesta, datos, pedido, rutas[i].archivo, strlen(rutas[i].archivo));
+      }
+      return rutas[i].atender(datos, pedido, buffer, respuesta);
+    }
+  }
+
+  if (ruta_encontrada)
+  {
+    strcat(allow, "\r\n");
+    return armar_respuesta(respuesta, "405 Method Not Allowed", "text/html; charset=utf-8", "", 0, allow);
+  }
+
+  // El resto de los archivos de public/ se sirven con su ruta
+  if (http_segmento_igual(datos, pedido->metodo, "GET"))
+  {
+    respuesta->ruta = RUTA_ARCHIVOS;
+    return responder_archivo(respuesta, datos, pedido, datos + pedido->ruta.inicio, pedido->ruta.longitud);
+  }
+
+  return armar_respuesta(respuesta, "404 Not Found", "text/html; charset=utf-8", "", 0, "");
+}
+
+/*Rutas*/
+
+static int ruta_index(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  float tempCelsius = 0;
+  int64_t tiempo_ns[BUFFER_SIZE];
+  float temp[BUFFER_SIZE];
+  char parrafo[PARRAFO_SIZE];
+  int parrafo_len;
+  char cabecera[RESPUESTA_HEADER_SIZE];
+  int cabecera_len;
+  char extra[CABECERA_EXTRA_SIZE];
+  uint32_t arranque;
+  uint32_t secuencia;
+  const static_entrada *entrada;
+  const static_variante *html;
+
+  respuesta->cache = static_cache_obtener();
+
+  if ((entrada = static_cache_buscar(respuesta->cache, FILE_HTML_HEADER_ADDR, strlen(FILE_HTML_HEADER_ADDR))) == NULL ||
+      entrada->variantes[STATIC_IDENTIDAD].cuerpo == NULL)
+  {
+    fprintf(stderr, "Error: %s no esta en la cache\n", FILE_HTML_HEADER_ADDR);
+    return -1;
+  }
+
+  // El párrafo se agrega al html sin comprimir
+  html = &entrada->variantes[STATIC_IDENTIDAD];
+
+  // La página cambia con el html o con cada muestra nueva, el promedio y el
+  // ETag salen de la misma copia del buffer
+  if (buffer_snapshot(buffer, BUFFER_SIZE, temp, tiempo_ns, &arranque, &secuencia))
+  {
+    fprintf(stderr, "Error en buffer_snapshot");
+    return -1;
+  }
+
+  snprintf(extra, sizeof(extra), "ETag: \"%.16s-%x-%u\"\r\nCache-Control: no-cache\r\n",
+           html->etag + 1, arranque, secuencia);
+
+  if (etag_coincide(datos, pedido, extra + strlen("ETag: ")))
+  {
+    return responder_no_modificado(respuesta, extra);
+  }
+
+  // Promedio de la ventana
+
+  for (int i = 0; i < BUFFER_SIZE; i++)
+  {
+    tempCelsius += temp[i];
+  }
+
+  tempCelsius /= BUFFER_SIZE;
+
+  parrafo_len = snprintf(parrafo, sizeof(parrafo),
+          "<p>%f grados Celsius equivale a %f grados Fahrenheit</p>",
+          tempCelsius, tempCelsius * 1.8 + 32);
+
+  cabecera_len = armar_cabecera(cabecera, sizeof(cabecera), "200 OK", "text/html; charset=utf-8",
+                                html->cuerpo_len + parrafo_len, extra, respuesta->cerrar);
+
+  // Cabecera y párrafo en memoria propia, el html sale directo de la cache
+  if ((respuesta->datos = (char *)malloc(cabecera_len + parrafo_len)) == NULL)
+  {
+    fprintf(stderr, "Error al reservar memoria para la respuesta\n");
+    return -1;
+  }
+
+  memcpy(respuesta->datos, cabecera, cabecera_len);
+  memcpy(respuesta->datos + cabecera_len, parrafo, parrafo_len);
+
+  respuesta->segmentos[0].iov_base = respuesta->datos;
+  respuesta->segmentos[0].iov_len = cabecera_len;
+  respuesta->segmentos[1].iov_base = html->cuerpo;
+  respuesta->segmentos[1].iov_len = html->cuerpo_len;
+  respuesta->segmentos[2].iov_base = respuesta->datos + cabecera_len;
+  respuesta->segmentos[2].iov_len = parrafo_len;
+  respuesta->n_segmentos = 3;
+  respuesta->longitud = cabecera_len + html->cuerpo_len + parrafo_len;
+
+  return 0;
+}
+
+static int ruta_datos(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  int64_t tiempo_ns[BUFFER_SIZE];
+  float temp[BUFFER_SIZE];
+  int json_len;
+  char extra[CABECERA_EXTRA_SIZE];
+  char extra_gzip[CABECERA_EXTRA_SIZE];
+  uint32_t arranque;
+  uint32_t secuencia;
+  int gzip;
+  http_segmento desde;
+
+  // Con from la consulta va al historial en lugar de la ventana del buffer
+  if (http_query_parametro(datos, pedido->query, "from", &desde))
+  {
+    return responder_rango(datos, pedido, respuesta);
+  }
+
+  // Una sola copia del buffer: los datos y el ETag corresponden a la misma secuencia
+  if (buffer_snapshot(buffer, BUFFER_SIZE, temp, tiempo_ns, &arranque, &secuencia))
+  {
+    fprintf(stderr, "Error en buffer_snapshot");
+    return -1;
+  }
+
+  // Cada representación tiene su ETag, las dos valen para la misma secuencia
+  snprintf(extra, sizeof(extra), "ETag: \"%x-%u\"\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n",
+           arranque, secuencia);
+  snprintf(extra_gzip, sizeof(extra_gzip), "ETag: \"%x-%u-gz\"\r\nCache-Control: no-cache\r\nVary: Accept-Encoding\r\n",
+           arranque, secuencia);
+
+  if (etag_coincide(datos, pedido, extra + strlen("ETag: ")))
+  {
+    return responder_no_modificado(respuesta, extra);
+  }
+
+  if (etag_coincide(datos, pedido, extra_gzip + strlen("ETag: ")))
+  {
+    return responder_no_modificado(respuesta, extra_gzip);
+  }
+
+  gzip = (codificaciones_aceptadas(datos, pedido) & (1 << STATIC_GZIP)) != 0;
+
+  // Mientras no llegue otra muestra se reutiliza la última compresión
+  strcat(extra_gzip, "Content-Encoding: gzip\r\n");
+
+  if (gzip && json_comprimido.valido && json_comprimido.arranque == arranque && json_comprimido.secuencia == secuencia)
+  {
+    return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8",
+                           json_comprimido.datos, json_comprimido.longitud, extra_gzip);
+  }
+
+  // "time" son segundos desde el inicio del buffer
+  for (int i = 0; i < BUFFER_SIZE; i++)
+  {
+    tiempo_ns[i] = buffer_desde_inicio_ns(buffer, tiempo_ns[i]);
+  }
+
+  if ((json_len = json_writer_muestras(json_muestras, sizeof(json_muestras), temp, tiempo_ns, BUFFER_SIZE)) < 0)
+  {
+    fprintf(stderr, "Error en json_writer_muestras");
+    return -1;
+  }
+
+  if (gzip && json_len >= JSON_COMPRIMIR_MIN && comprimir_json(json_muestras, json_len, arranque, secuencia) == 0)
+  {
+    return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8",
+                           json_comprimido.datos, json_comprimido.longitud, extra_gzip);
+  }
+
+  return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8", json_muestras, json_len, extra);
+}
+
+/**
+ * @brief Estadísticas de la ventana sin copiar las muestras
+ *
+ * {"seq":..,"n":..,"mean":..,"min":..,"max":..,"std":..,"p50":..,"p95":..,"p99":..,"ewma":..,"alpha":..,
+ *  "sampler":{"period_us":..,"samples":..,"missed":..,"errors":..,"jitter_mean_us":..,"jitter_max_us":..,
+ *  "jitter_std_us":..,"read_mean_us":..,"read_max_us":..}}
+ */
+static int ruta_estadisticas(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  buffer_estadisticas estadisticas;
+  buffer_muestreo muestreo;
+  char json[48 * JSON_ENTERO_MAX];
+  char extra[CABECERA_EXTRA_SIZE];
+  json_writer writer;
+  int json_len;
+
+  if (buffer_get_estadisticas(buffer, &estadisticas) || buffer_get_muestreo(buffer, &muestreo))
+  {
+    fprintf(stderr, "Error en buffer_get_estadisticas");
+    return -1;
+  }
+
+  // Cambian con cada muestra, igual que /GetData
+  snprintf(extra, sizeof(extra), "ETag: \"%x-%u\"\r\nCache-Control: no-cache\r\n", buffer->arranque, estadisticas.secuencia);
+
+  if (etag_coincide(datos, pedido, extra + strlen("ETag: ")))
+  {
+    return responder_no_modificado(respuesta, extra);
+  }
+
+  json_writer_iniciar(&writer, json, sizeof(json));
+  json_writer_texto(&writer, "{\"seq\":", 7);
+  json_writer_entero(&writer, estadisticas.secuencia);
+  json_writer_texto(&writer, ",\"n\":", 5);
+  json_writer_entero(&writer, estadisticas.cantidad);
+  json_writer_texto(&writer, ",\"mean\":", 8);
+  json_writer_numero(&writer, estadisticas.media);
+  json_writer_texto(&writer, ",\"min\":", 7);
+  json_writer_numero(&writer, estadisticas.minimo);
+  json_writer_texto(&writer, ",\"max\":", 7);
+  json_writer_numero(&writer, estadisticas.maximo);
+  json_writer_texto(&writer, ",\"std\":", 7);
+  json_writer_numero(&writer, estadisticas.desvio);
+  json_writer_texto(&writer, ",\"p50\":", 7);
+  json_writer_numero(&writer, estadisticas.p50);
+  json_writer_texto(&writer, ",\"p95\":", 7);
+  json_writer_numero(&writer, estadisticas.p95);
+  json_writer_texto(&writer, ",\"p99\":", 7);
+  json_writer_numero(&writer, estadisticas.p99);
+  json_writer_texto(&writer, ",\"ewma\":", 8);
+  json_writer_numero(&writer, estadisticas.ewma);
+  json_writer_texto(&writer, ",\"alpha\":", 9);
+  json_writer_numero(&writer, estadisticas.ewma_alfa);
+  json_writer_texto(&writer, ",\"sampler\":{\"period_us\":", 24);
+  json_writer_entero(&writer, muestreo.periodo_us);
+  json_writer_texto(&writer, ",\"samples\":", 11);
+  json_writer_entero(&writer, muestreo.muestras);
+  json_writer_texto(&writer, ",\"missed\":", 10);
+  json_writer_entero(&writer, muestreo.perdidas);
+  json_writer_texto(&writer, ",\"errors\":", 10);
+  json_writer_entero(&writer, muestreo.errores);
+  json_writer_texto(&writer, ",\"jitter_mean_us\":", 18);
+  json_writer_numero(&writer, muestreo.retraso_medio_us);
+  json_writer_texto(&writer, ",\"jitter_max_us\":", 17);
+  json_writer_numero(&writer, muestreo.retraso_max_us);
+  json_writer_texto(&writer, ",\"jitter_std_us\":", 17);
+  json_writer_numero(&writer, muestreo.retraso_desvio_us);
+  json_writer_texto(&writer, ",\"read_mean_us\":", 16);
+  json_writer_numero(&writer, muestreo.lectura_media_us);
+  json_writer_texto(&writer, ",\"read_max_us\":", 15);
+  json_writer_numero(&writer, muestreo.lectura_max_us);
+  json_writer_texto(&writer, "}}", 2);
+
+  if ((json_len = json_writer_terminar(&writer)) < 0)
+  {
+    fprintf(stderr, "Error al serializar las estadísticas");
+    return -1;
+  }
+
+  return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8", json, json_len, extra);
+}
+
+/**
+ * @brief Suscribe la conexión a las muestras nuevas con Server-Sent Events
+ *
+ * Solo se envía la cabecera, los eventos los agrega el servidor epoll a
+ * medida que llegan las muestras. Con Last-Event-ID se reenvían las que
+ * el cliente se perdió mientras estaba desconectado.
+ */
+static int ruta_stream(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  if (!flujos_habilitados)
+  {
+    respuesta->cerrar = 1;
+    return armar_respuesta(respuesta, "501 Not Implemented", "text/html; charset=utf-8", "", 0, "");
   }
 
-  // Comparamos el mensaje recibido con el mensaje esperado
-  // Genera el mensaje a enviar al cliente
+  respuesta->cerrar = 0;
+  respuesta->flujo = RESPUESTA_FLUJO_SSE;
+  respuesta->reanudar = (server_sse_ultimo_id(datos, pedido, &respuesta->ultimo_evento) == 0);
+
+  respuesta->segmentos[0].iov_base = (char *)cabecera_sse;
+  respuesta->segmentos[0].iov_len = sizeof(cabecera_sse) - 1;
+  respuesta->n_segmentos = 1;
+  respuesta->longitud = sizeof(cabecera_sse) - 1;
+  respuesta->enviado = 0;
+
+  return 0;
+}
+
+/**
+ * @brief Handshake de WebSocket (RFC 6455, 4.2)
+ *
+ * Luego del 101 la conexión deja de hablar HTTP, las tramas las atiende el
+ * servidor epoll.
+ */
+static int ruta_websocket(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  const http_segmento *upgrade = http_pedido_cabecera(pedido, datos, "Upgrade");
+  const http_segmento *connection = http_pedido_cabecera(pedido, datos, "Connection");
+  const http_segmento *version = http_pedido_cabecera(pedido, datos, "Sec-WebSocket-Version");
+  const http_segmento *clave = http_pedido_cabecera(pedido, datos, "Sec-WebSocket-Key");
+  char aceptar[WS_ACEPTAR_SIZE];
+  char cabecera[RESPUESTA_HEADER_SIZE];
+  int cabecera_len;
 
-  if (get_string_from_file(FILE_HTML_HEADER_ADDR, encabezadoHTML))
+  if (!flujos_habilitados)
   {
-    fprintf(stderr, "Error en get_sting_from_file");
+    respuesta->cerrar = 1;
+    return armar_respuesta(respuesta, "501 Not Implemented", "text/html; charset=utf-8", "", 0, "");
+  }
+
+  if (upgrade == NULL || !http_segmento_contiene_token(datos, *upgrade, "websocket") ||
+      connection == NULL || !http_segmento_contiene_token(datos, *connection, "upgrade") ||
+      clave == NULL || clave->longitud != WS_CLAVE_LEN || pedido->version_menor != 1)
+  {
+    return armar_respuesta(respuesta, "400 Bad Request", "text/html; charset=utf-8", "", 0, "");
+  }
+
+  if (version == NULL || !http_segmento_igual(datos, *version, "13"))
+  {
+    return armar_respuesta(respuesta, "426 Upgrade Required", "text/html; charset=utf-8", "", 0,
+                           "Sec-WebSocket-Version: 13\r\n");
+  }
+
+  server_websocket_aceptar(datos + clave->inicio, clave->longitud, aceptar);
+
+  cabecera_len = snprintf(cabecera, sizeof(cabecera),
+    "HTTP/1.1 101 Switching Protocols\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Accept: %s\r\n"
+    "\r\n",
+    aceptar);
+
+  if ((respuesta->datos = (char *)malloc(cabecera_len)) == NULL)
+  {
+    fprintf(stderr, "Error al reservar memoria para la respuesta\n");
     return -1;
   }
 
-  if(strstr(bufferComunic, "GET / HTTP/1.1") != NULL)
+  memcpy(respuesta->datos, cabecera, cabecera_len);
+
+  respuesta->cerrar = 0;
+  respuesta->flujo = RESPUESTA_FLUJO_WEBSOCKET;
+  respuesta->segmentos[0].iov_base = respuesta->datos;
+  respuesta->segmentos[0].iov_len = cabecera_len;
+  respuesta->n_segmentos = 1;
+  respuesta->longitud = cabecera_len;
+  respuesta->enviado = 0;
+
+  return 0;
+}
+
+/**
+ * @brief Contadores del servidor y estado del sensor en el formato de texto de Prometheus
+ *
+ * Cada proceso suma en su propia parte de los contadores sin locks, acá se
+ * juntan todas. Cada ruta de la tabla se identifica por su ruta.
+ */
+static int ruta_metricas(const char *datos, const http_pedido *pedido, shared_buffer *buffer, respuesta_http *respuesta)
+{
+  const char *nombres[METRICAS_RUTAS];
+  char *texto;
+  int texto_len;
+  int retval;
+
+  for (size_t i = 0; i < N_RUTAS; i++)
   {
-    sprintf(HTML,
-            "%s<p>%f grados Celsius equivale a %f grados Fahrenheit</p>",
-            encabezadoHTML, tempCelsius, tempCelsius * 1.8 + 32);
-    
-    sprintf(bufferComunic,
-    "HTTP/1.1 200 OK\n"
-    "Content-Length: %d\n"
-    "Content-Type: text/html; charset=utf-8\n"
-    "Connection: Closed\n\n%s",
-    strlen(HTML), HTML);
+    nombres[i] = rutas[i].ruta;
+  }
+  nombres[RUTA_ARCHIVOS] = "static";
+  nombres[RUTA_OTRA] = "other";
+
+  if ((texto = (char *)malloc(METRICAS_TEXTO_SIZE)) == NULL)
+  {
+    fprintf(stderr, "Error al reservar memoria para las metricas\n");
+    return -1;
   }
 
-  else if(strstr(bufferComunic, "GET /styles.css HTTP/1.1") != NULL)
+  texto_len = metricas_escribir(texto, METRICAS_TEXTO_SIZE, nombres, N_RUTAS + 2, buffer, historial_datos);
+
+  if (texto_len < 0)
+  {
+    // Sin memoria compartida para los contadores
+    free(texto);
+    return armar_respuesta(respuesta, "503 Service Unavailable", "text/html; charset=utf-8", "", 0, "");
+  }
+
+  retval = armar_respuesta(respuesta, "200 OK", "text/plain; version=0.0.4; charset=utf-8", texto, texto_len,
+                           "Cache-Control: no-cache\r\n");
+  free(texto);
+
+  return retval;
+}
+
+int server_client_enviar_respuesta(int s_aux, respuesta_http *respuesta)
+{
+  struct iovec pendientes[RESPUESTA_MAX_SEGMENTOS];
+  struct msghdr mensaje;
+  size_t segmentos_len = respuesta->longitud - respuesta->archivo_len;
+  size_t saltear;
+  ssize_t enviado;
+  off_t offset;
+
+  while (respuesta->enviado < segmentos_len)
   {
-    if (get_string_from_file(FILE_CSS_ADDR, HTML))
+    // Arma la lista de segmentos salteando lo que ya se envió
+    memset(&mensaje, 0, sizeof(mensaje));
+    mensaje.msg_iov = pendientes;
+    saltear = respuesta->enviado;
+
+    for (int i = 0; i < respuesta->n_segmentos; i++)
     {
-      fprintf(stderr, "Error buscando el archivo css\n");
+      if (saltear >= respuesta->segmentos[i].iov_len)
+      {
+        saltear -= respuesta->segmentos[i].iov_len;
+        continue;
+      }
+
+      pendientes[mensaje.msg_iovlen].iov_base = (char *)respuesta->segmentos[i].iov_base + saltear;
+      pendientes[mensaje.msg_iovlen].iov_len = respuesta->segmentos[i].iov_len - saltear;
+      mensaje.msg_iovlen++;
+      saltear = 0;
+    }
+
+    // Si sigue un archivo, MSG_MORE evita mandar la cabecera en un paquete aparte
+    enviado = sendmsg(s_aux, &mensaje, MSG_NOSIGNAL | (respuesta->archivo_len > 0 ? MSG_MORE : 0));
+
+    if (enviado < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return 0;
+      }
       return -1;
     }
 
-    sprintf(bufferComunic,
-    "HTTP/1.1 200 OK\n"
-    "Content-Length: %d\n"
-    "Content-Type: text/css; charset=utf-8\n"
-    "Connection: Closed\n\n%s",
-    strlen(HTML), HTML);
+    respuesta->enviado += enviado;
+    metricas_enviados(enviado);
   }
-  else if(strstr(bufferComunic, "GET /logo-utn-frba.png HTTP/1.1") != NULL)
+
+  while (respuesta->enviado < respuesta->longitud)
   {
-    send_png(s_aux, "public/image/logo-utn-frba.png", "image/png");
+    offset = respuesta->archivo_offset + (respuesta->enviado - segmentos_len);
+    enviado = sendfile(s_aux, respuesta->archivo_fd, &offset, respuesta->longitud - respuesta->enviado);
 
-    close(s_aux);
+    if (enviado < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        return 0;
+      }
+      return -1;
+    }
 
-    return 0;
+    if (enviado == 0)
+    {
+      // El archivo se achicó desde que se cargó, la respuesta quedaría incompleta
+      return -1;
+    }
+
+    respuesta->enviado += enviado;
+    metricas_enviados(enviado);
   }
-  else if(strstr(bufferComunic, "GET /GetData HTTP/1.1") != NULL)
-  {
-    
-    char json[1024];
-    
-    generate_json(json, temp, time, BUFFER_SIZE);
 
-    sprintf(bufferComunic, 
-    "HTTP/1.1 200 OK\n"
-    "Content-Length: %d\n"
-    "Content-Type: application/json; charset=utf-8\n"
-    "Connection: Closed\n\n%s",
-    strlen(json), json);
+  return 1;
+}
+
+void server_client_iniciar_respuesta(respuesta_http *respuesta)
+{
+  respuesta->n_segmentos = 0;
+  respuesta->longitud = 0;
+  respuesta->enviado = 0;
+  respuesta->datos = NULL;
+  respuesta->cache = NULL;
+  respuesta->archivo_fd = -1;
+  respuesta->archivo_offset = 0;
+  respuesta->archivo_len = 0;
+  respuesta->cerrar = 0;
+  respuesta->flujo = RESPUESTA_FLUJO_NINGUNO;
+  respuesta->reanudar = 0;
+  respuesta->ultimo_evento = 0;
+  respuesta->ruta = RUTA_OTRA;
+}
+
+void server_client_habilitar_flujos(void)
+{
+  flujos_habilitados = 1;
+}
+
+void server_client_usar_historial(const historial *h)
+{
+  historial_datos = h;
+}
+
+void server_client_liberar_respuesta(respuesta_http *respuesta)
+{
+  int cerrar = respuesta->cerrar;
+
+  free(respuesta->datos);
+  static_cache_liberar(respuesta->cache);
+
+  server_client_iniciar_respuesta(respuesta);
+  respuesta->cerrar = cerrar;
+}
+
+/**
+ * @brief Arma la cabecera de una respuesta, incluida la línea vacía final
+ *
+ * @param extra Cabeceras adicionales terminadas en "\r\n", "" si no hay
+ *
+ * @return int Longitud de la cabecera
+ */
+static int armar_cabecera(char *cabecera, size_t cabecera_size, const char *estado, const char *content_type, size_t cuerpo_len, const char *extra, int cerrar)
+{
+  return snprintf(cabecera, cabecera_size,
+    "HTTP/1.1 %s\r\n"
+    "Content-Length: %zu\r\n"
+    "Content-Type: %s\r\n"
+    "%s"
+    "%s\r\n",
+    estado, cuerpo_len, content_type, extra,
+    cerrar ? CABECERA_CLOSE : CABECERA_KEEPALIVE);
+}
+
+/**
+ * @brief Arma cabecera y cuerpo en un único bloque de memoria propia
+ *
+ * @return int 0 si se pudo reservar la memoria, -1 si no
+ */
+static int armar_respuesta(respuesta_http *respuesta, const char *estado, const char *content_type, const char *cuerpo, size_t cuerpo_len, const char *extra)
+{
+  char cabecera[RESPUESTA_HEADER_SIZE];
+  int cabecera_len;
+
+  cabecera_len = armar_cabecera(cabecera, sizeof(cabecera), estado, content_type, cuerpo_len, extra, respuesta->cerrar);
+
+  respuesta->datos = (char *)malloc(cabecera_len + cuerpo_len);
+
+  if (respuesta->datos == NULL)
+  {
+    fprintf(stderr, "Error al reservar memoria para la respuesta\n");
+    return -1;
   }
-  else
+
+  memcpy(respuesta->datos, cabecera, cabecera_len);
+  memcpy(respuesta->datos + cabecera_len, cuerpo, cuerpo_len);
+
+  respuesta->segmentos[0].iov_base = respuesta->datos;
+  respuesta->segmentos[0].iov_len = cabecera_len + cuerpo_len;
+  respuesta->n_segmentos = 1;
+  respuesta->longitud = cabecera_len + cuerpo_len;
+  respuesta->enviado = 0;
+
+  return 0;
+}
+
+/**
+ * @brief Responde con un archivo de la cache: cabecera ya armada y cuerpo, sin copias
+ *
+ * Se elige la variante comprimida más chica que acepte el cliente.
+ *
+ * @return int 0 si se armó la respuesta (404 si el archivo no está)
+ */
+static int responder_archivo(respuesta_http *respuesta, const char *datos, const http_pedido *pedido, const char *ruta, size_t ruta_len)
+{
+  const static_entrada *entrada;
+  const static_variante *variante;
+
+  respuesta->cache = static_cache_obtener();
+
+  if ((entrada = static_cache_buscar(respuesta->cache, ruta, ruta_len)) == NULL)
   {
-    // Mensaje de error
-    sprintf(bufferComunic,
-            "HTTP/1.1 404 Not Found\n"
-            "Content-Length: 0\n"
-            "Content-Type: text/html; charset=utf-8\n"
-            "Connection: Closed\n\n");
+    static_cache_liberar(respuesta->cache);
+    respuesta->cache = NULL;
 
     printf("Mensaje de error\n");
+
+    return armar_respuesta(respuesta, "404 Not Found", "text/html; charset=utf-8", "", 0, "");
   }
 
-  //printf("* Enviado al navegador Web %s:%d:\n%s\n",ipAddr, Port, bufferComunic);
+  variante = static_cache_variante(entrada, codificaciones_aceptadas(datos, pedido));
 
-  // Envia el mensaje al cliente
-  if (send(s_aux, bufferComunic, strlen(bufferComunic), 0) == -1)
+  if (etag_coincide(datos, pedido, variante->etag))
   {
-      fprintf(stderr, "Error en send");
-      return -1;
+    // El navegador ya tiene esta versión, solo se envía la cabecera 304
+    respuesta->segmentos[0].iov_base = (char *)variante->no_modificado[respuesta->cerrar];
+    respuesta->segmentos[0].iov_len = variante->no_modificado_len[respuesta->cerrar];
+    respuesta->n_segmentos = 1;
+    respuesta->longitud = variante->no_modificado_len[respuesta->cerrar];
+    respuesta->enviado = 0;
+
+    return 0;
   }
 
-  // Cierra la conexion con el cliente actual
-  close(s_aux);
+  respuesta->segmentos[0].iov_base = (char *)variante->cabecera[respuesta->cerrar];
+  respuesta->segmentos[0].iov_len = variante->cabecera_len[respuesta->cerrar];
+  respuesta->n_segmentos = 1;
+  respuesta->longitud = variante->cabecera_len[respuesta->cerrar] + variante->cuerpo_len;
+  respuesta->enviado = 0;
+
+  if (variante->fd >= 0)
+  {
+    // Binario grande, el cuerpo sale del page cache con sendfile
+    respuesta->archivo_fd = variante->fd;
+    respuesta->archivo_offset = 0;
+    respuesta->archivo_len = variante->cuerpo_len;
+  }
+  else
+  {
+    respuesta->segmentos[1].iov_base = variante->cuerpo;
+    respuesta->segmentos[1].iov_len = variante->cuerpo_len;
+    respuesta->n_segmentos = 2;
+  }
 
   return 0;
 }
 
+/**
+ * @brief Codificaciones que acepta el cliente según Accept-Encoding
+ *
+ * @return unsigned int Bit (1 << static_codificacion) por cada una, la identidad siempre
+ */
+static unsigned int codificaciones_aceptadas(const char *datos, const http_pedido *pedido)
+{
+  const http_segmento *accept_encoding = http_pedido_cabecera(pedido, datos, "Accept-Encoding");
+  unsigned int aceptadas = 1 << STATIC_IDENTIDAD;
+
+  if (accept_encoding == NULL)
+  {
+    return aceptadas;
+  }
+
+  if (http_segmento_acepta_codificacion(datos, *accept_encoding, "gzip"))
+  {
+    aceptadas |= 1 << STATIC_GZIP;
+  }
+
+  if (http_segmento_acepta_codificacion(datos, *accept_encoding, "br"))
+  {
+    aceptadas |= 1 << STATIC_BROTLI;
+  }
+
+  return aceptadas;
+}
+
+/**
+ * @brief Código de estado de una respuesta ya armada, de su línea de estado
+ *
+ * @return unsigned int 0 si no se puede leer
+ */
+static unsigned int codigo_respuesta(const respuesta_http *respuesta)
+{
+  const char *linea = (const char *)respuesta->segmentos[0].iov_base;
+  unsigned int codigo = 0;
+
+  if (respuesta->n_segmentos == 0 || respuesta->segmentos[0].iov_len < sizeof("HTTP/1.1 200") - 1)
+  {
+    return 0;
+  }
+
+  for (int i = sizeof("HTTP/1.1 ") - 1; i < (int)sizeof("HTTP/1.1 200") - 1; i++)
+  {
+    if (linea[i] < '0' || linea[i] > '9')
+    {
+      return 0;
+    }
+    codigo = codigo * 10 + (linea[i] - '0');
+  }
+
+  return codigo;
+}
 
-static int get_string_from_file(char *file_name, char *string)
+/**
+ * @brief Comprime el JSON con gzip y lo guarda para la secuencia indicada
+ *
+ * @return int 0 si se comprimió, -1 si no (se responde sin comprimir)
+ */
+static int comprimir_json(const char *json, size_t json_len, uint32_t arranque, uint32_t secuencia)
 {
-  FILE *file = NULL;
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
+  z_stream flujo;
+  size_t necesario;
+  char *datos_aux;
+  int ret_val;
 
-  file = fopen(file_name, "r");
+  json_comprimido.valido = 0;
+  memset(&flujo, 0, sizeof(flujo));
 
-  if (file == NULL)
+  // 15 + 16: ventana máxima con cabecera gzip en lugar de zlib
+  if (deflateInit2(&flujo, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
   {
-    fprintf(stderr, "Error al abrir el archivo %s\n", file_name);
+    fprintf(stderr, "Error en deflateInit2\n");
     return -1;
   }
 
-  while ((read = getline(&line, &len, file)) != -1)
+  necesario = deflateBound(&flujo, json_len);
+
+  if (necesario > json_comprimido.capacidad)
   {
-    strcat(string, line);
+    if ((datos_aux = (char *)realloc(json_comprimido.datos, necesario)) == NULL)
+    {
+      fprintf(stderr, "Error al reservar memoria para el JSON comprimido\n");
+      deflateEnd(&flujo);
+      return -1;
+    }
+
+    json_comprimido.datos = datos_aux;
+    json_comprimido.capacidad = necesario;
   }
 
-  fclose(file);
+  flujo.next_in = (Bytef *)json;
+  flujo.avail_in = json_len;
+  flujo.next_out = (Bytef *)json_comprimido.datos;
+  flujo.avail_out = json_comprimido.capacidad;
+
+  ret_val = deflate(&flujo, Z_FINISH);
+  deflateEnd(&flujo);
 
-  if (line)
+  if (ret_val != Z_STREAM_END)
   {
-    free(line);
+    fprintf(stderr, "Error en deflate\n");
+    return -1;
   }
 
+  json_comprimido.longitud = flujo.total_out;
+  json_comprimido.arranque = arranque;
+  json_comprimido.secuencia = secuencia;
+  json_comprimido.valido = 1;
+
   return 0;
 }
 
-static void send_png(int client_socket, const char *file_path, const char *content_type)
+/**
+ * @brief Responde /GetData?from=&to=&step= con el historial reducido a intervalos
+ *
+ * from y to son segundos desde 1970 (to es ahora si falta) y step el ancho
+ * de cada intervalo en segundos. Sin step el rango se divide en points
+ * intervalos (RANGO_PUNTOS_DEFECTO si tampoco está). Por cada intervalo con
+ * muestras se devuelve su inicio, promedio, mínimo, máximo y desvío estándar:
+ * {"from":..,"to":..,"step":..,"time":[..],"temp":[..],"min":[..],"max":[..],"std":[..]}
+ *
+ * Con q=50,95,99 se agregan los percentiles pedidos estimados con los
+ * resúmenes de cuantiles del historial, un arreglo "p50", "p95"... por cada
+ * uno. En ese caso el rango se divide en hasta RANGO_PUNTOS_CUANTILES_MAX
+ * intervalos.
+ */
+static int responder_rango(const char *datos, const http_pedido *pedido, respuesta_http *respuesta)
 {
-  FILE *file = NULL;
-  char *png_buffer = NULL;
-  int file_size = 0;
+  int64_t desde;
+  int64_t hasta = time(NULL);
+  int64_t paso = 0;
+  int64_t puntos = RANGO_PUNTOS_DEFECTO;
+  int64_t n_puntos;
+  int64_t cuantiles[RANGO_CUANTILES_MAX];
+  int n_cuantiles;
+  char clave[16];
+  unsigned int n = 0;
+  double promedio;
+  double varianza;
+  json_writer writer;
+  int json_len;
+  const char *extra = "Cache-Control: no-cache\r\nVary: Accept-Encoding\r\n";
+  const char *extra_gzip = "Cache-Control: no-cache\r\nVary: Accept-Encoding\r\nContent-Encoding: gzip\r\n";
 
-  file = fopen(file_path, "rb");
+  if (historial_datos == NULL)
+  {
+    return armar_respuesta(respuesta, "503 Service Unavailable", "text/html; charset=utf-8", "", 0, "");
+  }
 
-  if (file == NULL)
+  if (parametro_entero(datos, pedido, "from", &desde) != 1 || parametro_entero(datos, pedido, "to", &hasta) < 0 ||
+      parametro_entero(datos, pedido, "step", &paso) < 0 || parametro_entero(datos, pedido, "points", &puntos) < 0 ||
+      desde < 0 || hasta > RANGO_SEGUNDOS_MAX || desde >= hasta || paso < 0 || paso > RANGO_SEGUNDOS_MAX || puntos < 1 ||
+      (n_cuantiles = parametro_cuantiles(datos, pedido, cuantiles)) < 0)
   {
-    fprintf(stderr, "Error al abrir el archivo %s\n", file_path);
-    return;
+    return armar_respuesta(respuesta, "400 Bad Request", "text/html; charset=utf-8", "", 0, "");
   }
 
-  fseek(file, 0, SEEK_END);
-  file_size = ftell(file);
-  rewind(file);
+  if (paso == 0)
+  {
+    paso = (hasta - desde + puntos - 1) / puntos;
+  }
 
-  png_buffer = (char *)malloc(sizeof(char) * file_size);
+  n_puntos = (hasta - desde + paso - 1) / paso;
 
-  if (png_buffer == NULL)
+  if (n_puntos > ((n_cuantiles > 0) ? RANGO_PUNTOS_CUANTILES_MAX : HISTORIAL_PUNTOS_MAX) ||
+      historial_consultar(historial_datos, desde * 1000, hasta * 1000, paso * 1000, rango.puntos,
+                          (n_cuantiles > 0) ? rango.digestos : NULL, n_puntos) < 0)
   {
-    fprintf(stderr, "Error al reservar memoria para el png_buffer\n");
-    return;
+    return armar_respuesta(respuesta, "400 Bad Request", "text/html; charset=utf-8", "", 0, "");
   }
 
-  fread(png_buffer, sizeof(char), file_size, file);
+  // Los intervalos sin muestras no se envían, se reconocen por time
+  for (unsigned int k = 0; k < n_puntos; k++)
+  {
+    if (rango.puntos[k].cantidad == 0)
+    {
+      continue;
+    }
+
+    promedio = rango.puntos[k].suma / rango.puntos[k].cantidad;
+    varianza = rango.puntos[k].suma_cuadrados / rango.puntos[k].cantidad - promedio * promedio;
 
-  fclose(file);
+    rango.time[n] = desde + k * paso;
+    rango.temp[n] = promedio;
+    rango.minimo[n] = rango.puntos[k].minimo;
+    rango.maximo[n] = rango.puntos[k].maximo;
+    // Con muestras iguales el redondeo puede dar una varianza apenas negativa
+    rango.desvio[n] = (varianza > 0) ? sqrt(varianza) : 0;
 
-  send_response(client_socket, "HTTP/1.1 200 OK\n");
-  send_response(client_socket, "Content-Type: image/png\n");
-  send_response(client_socket, "Connection: Closed\n");
-  send_response(client_socket, "\n");
+    for (int j = 0; j < n_cuantiles; j++)
+    {
+      rango.cuantiles[j][n] = cuantiles_valor(&rango.digestos[k], cuantiles[j] / 100.0);
+    }
 
-  send(client_socket, png_buffer, file_size, 0);
+    n++;
+  }
 
-  free(png_buffer);
-}
+  json_writer_iniciar(&writer, rango.json, sizeof(rango.json));
+  json_writer_texto(&writer, "{\"from\":", 8);
+  json_writer_entero(&writer, desde);
+  json_writer_texto(&writer, ",\"to\":", 6);
+  json_writer_entero(&writer, hasta);
+  json_writer_texto(&writer, ",\"step\":", 8);
+  json_writer_entero(&writer, paso);
+  json_writer_texto(&writer, ",\"time\":", 8);
+  json_writer_arreglo_enteros(&writer, rango.time, n);
+  json_writer_texto(&writer, ",\"temp\":", 8);
+  json_writer_arreglo(&writer, rango.temp, n);
+  json_writer_texto(&writer, ",\"min\":", 7);
+  json_writer_arreglo(&writer, rango.minimo, n);
+  json_writer_texto(&writer, ",\"max\":", 7);
+  json_writer_arreglo(&writer, rango.maximo, n);
+  json_writer_texto(&writer, ",\"std\":", 7);
+  json_writer_arreglo(&writer, rango.desvio, n);
 
+  for (int j = 0; j < n_cuantiles; j++)
+  {
+    json_writer_texto(&writer, clave, snprintf(clave, sizeof(clave), ",\"p%d\":", (int)cuantiles[j]));
+    json_writer_arreglo(&writer, rango.cuantiles[j], n);
+  }
+
+  json_writer_texto(&writer, "}", 1);
+
+  if ((json_len = json_writer_terminar(&writer)) < 0)
+  {
+    fprintf(stderr, "Error al serializar el rango");
+    return -1;
+  }
+
+  if ((codificaciones_aceptadas(datos, pedido) & (1 << STATIC_GZIP)) && json_len >= JSON_COMPRIMIR_MIN &&
+      comprimir_json(rango.json, json_len, 0, 0) == 0)
+  {
+    // El buffer comprimido se reutiliza, pero no es la ventana de /GetData
+    json_comprimido.valido = 0;
+
+    return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8",
+                           json_comprimido.datos, json_comprimido.longitud, extra_gzip);
+  }
+
+  return armar_respuesta(respuesta, "200 OK", "application/json; charset=utf-8", rango.json, json_len, extra);
+}
 
-static void send_response(int client_socket, const char *response)
+/**
+ * @brief Lee un parámetro entero de la query
+ *
+ * @return int 1 si se leyó, 0 si no está (valor no cambia), -1 si no es un entero
+ */
+static int parametro_entero(const char *datos, const http_pedido *pedido, const char *nombre, int64_t *valor)
 {
-  send(client_socket, response, strlen(response), 0);
+  http_segmento segmento;
+
+  if (!http_query_parametro(datos, pedido->query, nombre, &segmento))
+  {
+    return 0;
+  }
+
+  return http_segmento_entero(datos, segmento, valor) ? 1 : -1;
 }
 
-static void generate_json(char *json, float * temp_data, float * time_data, int size)
+/**
+ * @brief Lee los percentiles de q=, una lista separada por comas (ej: q=50,95,99)
+ *
+ * @param cuantiles Hasta RANGO_CUANTILES_MAX percentiles entre 0 y 100
+ * @return int Cantidad de percentiles, 0 si no está, -1 si no es válido
+ */
+static int parametro_cuantiles(const char *datos, const http_pedido *pedido, int64_t *cuantiles)
 {
-  char temp[256], time[256];
-
-  // Start the JSON string
-  strcpy(json, "{\"temp\":[");
-  
-  // Add the temperature data to the JSON string
-  for (int i = 0; i < size; i++) {
-      sprintf(temp, "%.2f", temp_data[i]);
-      strcat(json, temp);
-      if (i < size - 1) {
-          strcat(json, ",");
-      }
+  http_segmento lista;
+  http_segmento elemento;
+  uint32_t fin;
+  int n = 0;
+
+  if (!http_query_parametro(datos, pedido->query, "q", &lista))
+  {
+    return 0;
   }
-  
-  // Add the time data to the JSON string
-  strcat(json, "],\"time\":[");
-  for (int i = 0; i < size; i++) {
-      sprintf(time, "%.2f", time_data[i]);
-      strcat(json, time);
-      if (i < size - 1) {
-          strcat(json, ",");
-      }
+
+  elemento.inicio = lista.inicio;
+  fin = lista.inicio + lista.longitud;
+
+  while (elemento.inicio <= fin)
+  {
+    for (elemento.longitud = 0; elemento.inicio + elemento.longitud < fin &&
+                                datos[elemento.inicio + elemento.longitud] != ',';
+         elemento.longitud++)
+    {
+    }
+
+    if (n == RANGO_CUANTILES_MAX || !http_segmento_entero(datos, elemento, &cuantiles[n]) || cuantiles[n] < 0 ||
+        cuantiles[n] > 100)
+    {
+      return -1;
+    }
+
+    n++;
+    elemento.inicio += elemento.longitud + 1;
   }
-  
-  // End the JSON string
-  strcat(json, "]}");
-}
\ No newline at end of file
+
+  return n;
+}
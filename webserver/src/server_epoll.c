@@ -0,0 +1,1314 @@
+/**
+ * @file server_epoll.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Servidor de un solo proceso basado en epoll
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#define _GNU_SOURCE /*accept4*/
+
+#include "../inc/server_epoll.h"
+#include "../inc/server_client.h"
+#include "../inc/static_cache.h"
+#include "../inc/server_sse.h"
+#include "../inc/server_websocket.h"
+#include "../inc/metricas.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+
+typedef enum estado_conexion
+{
+  CONEXION_LEYENDO,
+  CONEXION_ESCRIBIENDO,
+  CONEXION_SUSCRIPTA, // Recibe las muestras nuevas a medida que llegan (/stream)
+  CONEXION_WEBSOCKET, // Conexión actualizada a WebSocket (/ws)
+  CONEXION_CERRADA // Ya cerrada, se libera al terminar de atender los eventos
+} estado_conexion;
+
+/**
+ * @brief Mensaje que se envía igual a todas las conexiones suscriptas
+ *
+ * Cada muestra se serializa una sola vez, las conexiones solo toman una
+ * referencia y el mensaje se libera cuando la última termina de enviarlo.
+ */
+typedef struct mensaje
+{
+  unsigned int referencias;
+  size_t longitud;
+  char datos[];
+} mensaje;
+
+typedef struct conexion
+{
+  int fd;
+  estado_conexion estado;
+  uint32_t eventos; // Eventos registrados en epoll
+  char entrada[CONEXION_BUFFER_SIZE + 1];
+  size_t entrada_len;
+  http_pedido pedido; // Estado del analizador para el pedido en curso
+  unsigned int pedidos; // Pedidos atendidos en esta conexión
+  time_t ultima_actividad;
+  respuesta_http respuesta;
+  mensaje *cola[CONEXION_COLA_MENSAJES]; // Mensajes pendientes de una conexión suscripta
+  unsigned int cola_inicio;
+  unsigned int cola_len;
+  size_t cola_enviado; // Bytes ya enviados del primer mensaje de la cola
+  int cerrar_al_vaciar; // Se cierra al terminar de enviar la cola (trama de cierre)
+  unsigned int decimacion; // WebSocket: recibe solo las muestras con secuencia múltiplo de este valor
+  int ping_pendiente; // WebSocket: se envió un ping y no hubo actividad desde entonces
+  struct conexion *anterior; // Lista a la que pertenece según su estado
+  struct conexion *siguiente;
+} conexion;
+
+typedef struct lista_conexiones
+{
+  conexion *primera;
+  conexion *ultima;
+} lista_conexiones;
+
+/*Variables privadas*/
+
+/// @brief Marcas para distinguir en data.ptr los descriptores que no son conexiones
+static char marca_escucha;
+static char marca_cache;
+static char marca_aviso;
+
+/// @brief Conexiones que atienden pedidos, la primera es la que lleva más tiempo inactiva
+static lista_conexiones activas = {NULL, NULL};
+
+/// @brief Conexiones suscriptas a las muestras, no vencen por inactividad
+static lista_conexiones suscriptas = {NULL, NULL};
+
+/// @brief Conexiones WebSocket, la primera es la que lleva más tiempo sin enviar tramas
+static lista_conexiones websockets = {NULL, NULL};
+
+/// @brief Conexiones cerradas durante la vuelta actual, todavía pueden tener eventos pendientes
+static lista_conexiones cerradas = {NULL, NULL};
+
+/// @brief Secuencia de la última muestra enviada a las conexiones suscriptas
+static uint32_t ultima_difundida = 0;
+
+/*Funciones privadas*/
+
+static int set_no_bloqueante(int fd);
+static time_t segundos_monotonicos(void);
+static void lista_quitar(lista_conexiones *lista, conexion *con);
+static void lista_agregar(lista_conexiones *lista, conexion *con);
+static lista_conexiones *lista_de(conexion *con);
+static void aceptar_conexiones(int epoll_fd, int socket_id);
+static void cerrar_conexion(int epoll_fd, conexion *con);
+static void liberar_cerradas(void);
+static void cerrar_inactivas(int epoll_fd);
+static void esperar_eventos(int epoll_fd, conexion *con, uint32_t eventos);
+static void atender_lectura(int epoll_fd, conexion *con, shared_buffer *buffer);
+static void avanzar_conexion(int epoll_fd, conexion *con, shared_buffer *buffer);
+static mensaje *mensaje_nuevo(size_t longitud);
+static mensaje *mensaje_muestra(uint32_t secuencia, int64_t tiempo_ns, float temp);
+static mensaje *mensaje_websocket(ws_opcode opcode, const void *carga, size_t carga_len);
+static mensaje *mensaje_registros(const float *temp, const int64_t *tiempo_ns, uint32_t secuencia,
+                                  uint32_t desde, uint32_t hasta, unsigned int decimacion);
+static int copiar_ventana(shared_buffer *buffer, float *temp, int64_t *tiempo_ns, uint32_t *secuencia);
+static void mensaje_soltar(mensaje *msj);
+static int encolar(int epoll_fd, conexion *con, mensaje *msj);
+static int enviar_cola(int epoll_fd, conexion *con);
+static void descartar_entrada(int epoll_fd, conexion *con);
+static uint32_t primera_pendiente(uint32_t ultima_recibida, uint32_t secuencia);
+static void suscribir(int epoll_fd, conexion *con, shared_buffer *buffer);
+static void abrir_websocket(int epoll_fd, conexion *con, shared_buffer *buffer);
+static void atender_websocket(int epoll_fd, conexion *con, shared_buffer *buffer);
+static void procesar_tramas(int epoll_fd, conexion *con, shared_buffer *buffer);
+static void comando_websocket(int epoll_fd, conexion *con, shared_buffer *buffer, const char *texto, size_t longitud);
+static void cerrar_websocket(int epoll_fd, conexion *con, uint16_t codigo);
+static void revisar_websockets(int epoll_fd);
+static void difundir_muestras(int epoll_fd, shared_buffer *buffer);
+
+/*Funciones de la biblioteca*/
+
+int server_epoll_run(int socket_id, shared_buffer *buffer)
+{
+  int epoll_fd;
+  int n_eventos;
+  struct epoll_event evento;
+  struct epoll_event eventos[EPOLL_MAX_EVENTOS];
+  uint32_t arranque;
+
+  if (set_no_bloqueante(socket_id) < 0)
+  {
+    perror("Error en fcntl");
+    return -1;
+  }
+
+  if ((epoll_fd = epoll_create1(0)) < 0)
+  {
+    perror("Error en epoll_create1");
+    return -1;
+  }
+
+  evento.events = EPOLLIN;
+  evento.data.ptr = &marca_escucha;
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_id, &evento) < 0)
+  {
+    perror("Error en epoll_ctl");
+    close(epoll_fd);
+    return -1;
+  }
+
+  // Avisos de inotify cuando cambia algún archivo de la cache
+  evento.events = EPOLLIN;
+  evento.data.ptr = &marca_cache;
+
+  if (static_cache_fd() >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, static_cache_fd(), &evento) < 0)
+  {
+    perror("Error en epoll_ctl");
+  }
+
+  // Avisos del proceso que carga el buffer, para las conexiones suscriptas
+  evento.events = EPOLLIN;
+  evento.data.ptr = &marca_aviso;
+
+  if (buffer_aviso_fd() < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, buffer_aviso_fd(), &evento) < 0)
+  {
+    fprintf(stderr, "Sin avisos de muestras nuevas, /stream y /ws no disponibles\n");
+  }
+  else
+  {
+    server_client_habilitar_flujos();
+  }
+
+  if (buffer_get_secuencia(buffer, &arranque, &ultima_difundida) < 0)
+  {
+    close(epoll_fd);
+    return -1;
+  }
+
+  printf("Servidor en modo epoll\n");
+
+  while (1)
+  {
+    // El timeout permite cerrar las conexiones inactivas aunque no haya tráfico
+    n_eventos = epoll_wait(epoll_fd, eventos, EPOLL_MAX_EVENTOS, 1000);
+
+    if (n_eventos < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      perror("Error en epoll_wait");
+      close(epoll_fd);
+      return -1;
+    }
+
+    for (int i = 0; i < n_eventos; i++)
+    {
+      conexion *con = (conexion *)eventos[i].data.ptr;
+
+      if (eventos[i].data.ptr == &marca_escucha)
+      {
+        aceptar_conexiones(epoll_fd, socket_id);
+        continue;
+      }
+
+      if (eventos[i].data.ptr == &marca_cache)
+      {
+        static_cache_revisar();
+        continue;
+      }
+
+      if (eventos[i].data.ptr == &marca_aviso)
+      {
+        difundir_muestras(epoll_fd, buffer);
+        continue;
+      }
+
+      if (con->estado == CONEXION_CERRADA)
+      {
+        continue;
+      }
+
+      if (eventos[i].events & (EPOLLERR | EPOLLHUP))
+      {
+        cerrar_conexion(epoll_fd, con);
+        continue;
+      }
+
+      if (con->estado == CONEXION_SUSCRIPTA || con->estado == CONEXION_WEBSOCKET)
+      {
+        if (eventos[i].events & EPOLLOUT)
+        {
+          if (enviar_cola(epoll_fd, con) < 0)
+          {
+            continue;
+          }
+        }
+
+        if (!(eventos[i].events & EPOLLIN))
+        {
+          continue;
+        }
+
+        if (con->estado == CONEXION_WEBSOCKET)
+        {
+          atender_websocket(epoll_fd, con, buffer);
+        }
+        else
+        {
+          descartar_entrada(epoll_fd, con);
+        }
+      }
+      else if (con->estado == CONEXION_LEYENDO && (eventos[i].events & EPOLLIN))
+      {
+        atender_lectura(epoll_fd, con, buffer);
+      }
+      else if (con->estado == CONEXION_ESCRIBIENDO && (eventos[i].events & EPOLLOUT))
+      {
+        avanzar_conexion(epoll_fd, con, buffer);
+      }
+    }
+
+    cerrar_inactivas(epoll_fd);
+    revisar_websockets(epoll_fd);
+    liberar_cerradas();
+  }
+
+  close(epoll_fd);
+
+  return 0;
+}
+
+/*Funciones privadas*/
+
+static int set_no_bloqueante(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+
+  if (flags < 0)
+  {
+    return -1;
+  }
+
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static time_t segundos_monotonicos(void)
+{
+  struct timespec ahora;
+
+  clock_gettime(CLOCK_MONOTONIC, &ahora);
+
+  return ahora.tv_sec;
+}
+
+static void lista_quitar(lista_conexiones *lista, conexion *con)
+{
+  if (con->anterior != NULL)
+  {
+    con->anterior->siguiente = con->siguiente;
+  }
+  else
+  {
+    lista->primera = con->siguiente;
+  }
+
+  if (con->siguiente != NULL)
+  {
+    con->siguiente->anterior = con->anterior;
+  }
+  else
+  {
+    lista->ultima = con->anterior;
+  }
+
+  con->anterior = NULL;
+  con->siguiente = NULL;
+}
+
+/**
+ * @brief Agrega la conexión al final de la lista y renueva su última actividad
+ */
+static void lista_agregar(lista_conexiones *lista, conexion *con)
+{
+  con->ultima_actividad = segundos_monotonicos();
+  con->anterior = lista->ultima;
+  con->siguiente = NULL;
+
+  if (lista->ultima != NULL)
+  {
+    lista->ultima->siguiente = con;
+  }
+  else
+  {
+    lista->primera = con;
+  }
+
+  lista->ultima = con;
+}
+
+static lista_conexiones *lista_de(conexion *con)
+{
+  if (con->estado == CONEXION_SUSCRIPTA)
+  {
+    return &suscriptas;
+  }
+
+  if (con->estado == CONEXION_WEBSOCKET)
+  {
+    return &websockets;
+  }
+
+  if (con->estado == CONEXION_CERRADA)
+  {
+    return &cerradas;
+  }
+
+  return &activas;
+}
+
+/**
+ * @brief Acepta todas las conexiones pendientes del socket en escucha
+ */
+static void aceptar_conexiones(int epoll_fd, int socket_id)
+{
+  int s_aux;
+  conexion *con;
+  struct epoll_event evento;
+
+  while ((s_aux = accept4(socket_id, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+  {
+    con = (conexion *)malloc(sizeof(conexion));
+
+    if (con == NULL)
+    {
+      fprintf(stderr, "Error al reservar memoria para la conexion\n");
+      close(s_aux);
+      continue;
+    }
+
+    con->fd = s_aux;
+    con->estado = CONEXION_LEYENDO;
+    con->eventos = EPOLLIN;
+    con->entrada_len = 0;
+    con->entrada[0] = '\0';
+    con->pedidos = 0;
+    con->cola_inicio = 0;
+    con->cola_len = 0;
+    con->cola_enviado = 0;
+    con->cerrar_al_vaciar = 0;
+    con->decimacion = 1;
+    con->ping_pendiente = 0;
+    http_parser_iniciar(&con->pedido);
+    server_client_iniciar_respuesta(&con->respuesta);
+
+    evento.events = con->eventos;
+    evento.data.ptr = con;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s_aux, &evento) < 0)
+    {
+      perror("Error en epoll_ctl");
+      close(s_aux);
+      free(con);
+      continue;
+    }
+
+    lista_agregar(&activas, con);
+    metricas_conexion_abierta();
+  }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+  {
+    perror("Error en accept");
+  }
+}
+
+/**
+ * @brief Cierra el socket y suelta los recursos de la conexión
+ *
+ * La memoria se libera recién en liberar_cerradas: al difundir una muestra se
+ * pueden cerrar conexiones que todavía tienen eventos sin atender en la vuelta.
+ */
+static void cerrar_conexion(int epoll_fd, conexion *con)
+{
+  if (con->estado == CONEXION_CERRADA)
+  {
+    return;
+  }
+
+  lista_quitar(lista_de(con), con);
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, con->fd, NULL);
+  close(con->fd);
+  server_client_liberar_respuesta(&con->respuesta);
+
+  while (con->cola_len > 0)
+  {
+    mensaje_soltar(con->cola[con->cola_inicio]);
+    con->cola_inicio = (con->cola_inicio + 1) % CONEXION_COLA_MENSAJES;
+    con->cola_len--;
+  }
+
+  con->estado = CONEXION_CERRADA;
+  lista_agregar(&cerradas, con);
+  metricas_conexion_cerrada();
+}
+
+static void liberar_cerradas(void)
+{
+  conexion *con;
+
+  while ((con = cerradas.primera) != NULL)
+  {
+    lista_quitar(&cerradas, con);
+    free(con);
+  }
+}
+
+/**
+ * @brief Cierra las conexiones que superaron KEEPALIVE_TIMEOUT sin actividad
+ *
+ * La lista está ordenada por última actividad, solo se recorren las vencidas.
+ */
+static void cerrar_inactivas(int epoll_fd)
+{
+  time_t limite = segundos_monotonicos() - KEEPALIVE_TIMEOUT;
+
+  while (activas.primera != NULL && activas.primera->ultima_actividad <= limite)
+  {
+    cerrar_conexion(epoll_fd, activas.primera);
+  }
+}
+
+static void esperar_eventos(int epoll_fd, conexion *con, uint32_t eventos)
+{
+  struct epoll_event evento;
+
+  if (con->eventos == eventos)
+  {
+    return;
+  }
+
+  evento.events = eventos;
+  evento.data.ptr = con;
+
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, con->fd, &evento) == 0)
+  {
+    con->eventos = eventos;
+  }
+}
+
+/**
+ * @brief Lee lo disponible en el socket y atiende los pedidos completos
+ */
+static void atender_lectura(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  ssize_t recibido;
+
+  while (con->entrada_len < CONEXION_BUFFER_SIZE)
+  {
+    recibido = recv(con->fd, con->entrada + con->entrada_len,
+                    CONEXION_BUFFER_SIZE - con->entrada_len, 0);
+
+    if (recibido == 0)
+    {
+      // El cliente cerró la conexión
+      cerrar_conexion(epoll_fd, con);
+      return;
+    }
+
+    if (recibido < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        break;
+      }
+      cerrar_conexion(epoll_fd, con);
+      return;
+    }
+
+    con->entrada_len += recibido;
+  }
+
+  con->entrada[con->entrada_len] = '\0';
+
+  lista_quitar(&activas, con);
+  lista_agregar(&activas, con);
+
+  avanzar_conexion(epoll_fd, con, buffer);
+}
+
+/**
+ * @brief Máquina de estados de la conexión
+ *
+ * Envía la respuesta en curso y, mientras haya pedidos completos en la entrada
+ * (pipelining), genera y envía la siguiente. Se detiene cuando el socket no
+ * acepta más datos o cuando falta recibir el resto de un pedido.
+ */
+static void avanzar_conexion(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  ssize_t consumido;
+  int ret_val;
+
+  while (1)
+  {
+    if (con->estado == CONEXION_ESCRIBIENDO)
+    {
+      size_t enviado = con->respuesta.enviado;
+
+      ret_val = server_client_enviar_respuesta(con->fd, &con->respuesta);
+
+      if (ret_val == 0)
+      {
+        // Un cliente lento que sigue recibiendo no está inactivo: el timeout cuenta desde el último avance
+        if (con->respuesta.enviado != enviado)
+        {
+          lista_quitar(&activas, con);
+          lista_agregar(&activas, con);
+        }
+
+        esperar_eventos(epoll_fd, con, EPOLLOUT);
+        return;
+      }
+
+      if (ret_val < 0 || con->respuesta.cerrar)
+      {
+        // Error o respuesta con Connection: close
+        cerrar_conexion(epoll_fd, con);
+        return;
+      }
+
+      if (con->respuesta.flujo == RESPUESTA_FLUJO_SSE)
+      {
+        // Ya se envió la cabecera de /stream, desde ahora solo recibe muestras
+        suscribir(epoll_fd, con, buffer);
+        return;
+      }
+
+      if (con->respuesta.flujo == RESPUESTA_FLUJO_WEBSOCKET)
+      {
+        // Ya se envió el 101 Switching Protocols, desde ahora se intercambian tramas
+        abrir_websocket(epoll_fd, con, buffer);
+        return;
+      }
+
+      server_client_liberar_respuesta(&con->respuesta);
+      con->estado = CONEXION_LEYENDO;
+
+      lista_quitar(&activas, con);
+      lista_agregar(&activas, con);
+    }
+
+    consumido = server_client_atender_pedido(con->entrada, con->entrada_len, &con->pedido, con->pedidos, buffer, &con->respuesta);
+
+    if (consumido < 0)
+    {
+      fprintf(stderr, "Error en server_client_atender_pedido\n");
+      cerrar_conexion(epoll_fd, con);
+      return;
+    }
+
+    if (consumido == 0)
+    {
+      if (con->entrada_len >= CONEXION_BUFFER_SIZE)
+      {
+        // Cabecera demasiado grande, se descarta el cliente
+        cerrar_conexion(epoll_fd, con);
+        return;
+      }
+
+      esperar_eventos(epoll_fd, con, EPOLLIN);
+      return;
+    }
+
+    con->pedidos++;
+    con->entrada_len -= consumido;
+    memmove(con->entrada, con->entrada + consumido, con->entrada_len + 1);
+    con->estado = CONEXION_ESCRIBIENDO;
+  }
+}
+
+/**
+ * @brief Reserva un mensaje de la longitud indicada con una referencia tomada
+ *
+ * @return mensaje* NULL si no hay memoria
+ */
+static mensaje *mensaje_nuevo(size_t longitud)
+{
+  mensaje *msj;
+
+  if ((msj = (mensaje *)malloc(sizeof(mensaje) + longitud)) == NULL)
+  {
+    fprintf(stderr, "Error al reservar memoria para el mensaje\n");
+    return NULL;
+  }
+
+  msj->referencias = 1;
+  msj->longitud = longitud;
+
+  return msj;
+}
+
+/**
+ * @brief Crea el evento SSE de una muestra
+ */
+static mensaje *mensaje_muestra(uint32_t secuencia, int64_t tiempo_ns, float temp)
+{
+  char evento[SSE_EVENTO_SIZE];
+  int evento_len;
+  mensaje *msj;
+
+  evento_len = server_sse_evento(evento, sizeof(evento), secuencia, tiempo_ns, temp);
+
+  if ((msj = mensaje_nuevo(evento_len)) != NULL)
+  {
+    memcpy(msj->datos, evento, evento_len);
+  }
+
+  return msj;
+}
+
+/**
+ * @brief Crea una trama WebSocket completa (cabecera y carga)
+ */
+static mensaje *mensaje_websocket(ws_opcode opcode, const void *carga, size_t carga_len)
+{
+  uint8_t cabecera[WS_CABECERA_MAX];
+  size_t cabecera_len;
+  mensaje *msj;
+
+  cabecera_len = server_websocket_cabecera(cabecera, opcode, carga_len);
+
+  if ((msj = mensaje_nuevo(cabecera_len + carga_len)) != NULL)
+  {
+    memcpy(msj->datos, cabecera, cabecera_len);
+    memcpy(msj->datos + cabecera_len, carga, carga_len);
+  }
+
+  return msj;
+}
+
+/**
+ * @brief Crea una trama binaria con las muestras desde..hasta de una copia del buffer
+ *
+ * @param secuencia Secuencia de la última muestra de la copia
+ * @param decimacion Solo se incluyen las secuencias múltiplo de este valor
+ * @return mensaje* NULL si no quedó ninguna muestra o no hay memoria
+ */
+static mensaje *mensaje_registros(const float *temp, const int64_t *tiempo_ns, uint32_t secuencia,
+                                  uint32_t desde, uint32_t hasta, unsigned int decimacion)
+{
+  uint8_t carga[BUFFER_SIZE * WS_REGISTRO_SIZE];
+  size_t carga_len = 0;
+
+  for (uint32_t sec = desde; (int32_t)(hasta - sec) >= 0; sec++)
+  {
+    int posicion = BUFFER_SIZE - 1 - (int)(secuencia - sec);
+
+    if (posicion < 0 || posicion >= BUFFER_SIZE || sec % decimacion != 0)
+    {
+      continue;
+    }
+
+    server_websocket_registro(carga + carga_len, sec, tiempo_ns[posicion], temp[posicion]);
+    carga_len += WS_REGISTRO_SIZE;
+  }
+
+  if (carga_len == 0)
+  {
+    return NULL;
+  }
+
+  return mensaje_websocket(WS_BINARIO, carga, carga_len);
+}
+
+/**
+ * @brief Copia la ventana del buffer con los tiempos en ns desde su inicio,
+ * como se envían a los clientes
+ */
+static int copiar_ventana(shared_buffer *buffer, float *temp, int64_t *tiempo_ns, uint32_t *secuencia)
+{
+  if (buffer_snapshot(buffer, BUFFER_SIZE, temp, tiempo_ns, NULL, secuencia) < 0)
+  {
+    return -1;
+  }
+
+  for (int i = 0; i < BUFFER_SIZE; i++)
+  {
+    tiempo_ns[i] = buffer_desde_inicio_ns(buffer, tiempo_ns[i]);
+  }
+
+  return 0;
+}
+
+static void mensaje_soltar(mensaje *msj)
+{
+  if (--msj->referencias == 0)
+  {
+    free(msj);
+  }
+}
+
+/**
+ * @brief Agrega un mensaje a la cola de la conexión, sin enviarlo
+ *
+ * Un cliente que no lee y llena la cola se desconecta: al reconectarse con
+ * Last-Event-ID recupera lo que quede en el buffer.
+ *
+ * @return int 0 si se encoló, -1 si se cerró la conexión
+ */
+static int encolar(int epoll_fd, conexion *con, mensaje *msj)
+{
+  if (con->cola_len == CONEXION_COLA_MENSAJES)
+  {
+    cerrar_conexion(epoll_fd, con);
+    return -1;
+  }
+
+  msj->referencias++;
+  con->cola[(con->cola_inicio + con->cola_len) % CONEXION_COLA_MENSAJES] = msj;
+  con->cola_len++;
+
+  return 0;
+}
+
+/**
+ * @brief Envía los mensajes encolados con un solo sendmsg por llamada
+ *
+ * @return int 0 si la conexión sigue abierta, -1 si se cerró
+ */
+static int enviar_cola(int epoll_fd, conexion *con)
+{
+  struct iovec pendientes[CONEXION_COLA_MENSAJES];
+  struct msghdr msg;
+  ssize_t enviado;
+  mensaje *primero;
+
+  while (con->cola_len > 0)
+  {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = pendientes;
+
+    for (unsigned int i = 0; i < con->cola_len; i++)
+    {
+      mensaje *msj = con->cola[(con->cola_inicio + i) % CONEXION_COLA_MENSAJES];
+      size_t saltear = (i == 0) ? con->cola_enviado : 0;
+
+      pendientes[i].iov_base = msj->datos + saltear;
+      pendientes[i].iov_len = msj->longitud - saltear;
+    }
+
+    msg.msg_iovlen = con->cola_len;
+
+    enviado = sendmsg(con->fd, &msg, MSG_NOSIGNAL);
+
+    if (enviado < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        esperar_eventos(epoll_fd, con, EPOLLIN | EPOLLOUT);
+        return 0;
+      }
+      cerrar_conexion(epoll_fd, con);
+      return -1;
+    }
+
+    metricas_enviados(enviado);
+
+    // Suelta los mensajes enviados completos
+    while (enviado > 0)
+    {
+      primero = con->cola[con->cola_inicio];
+
+      if ((size_t)enviado < primero->longitud - con->cola_enviado)
+      {
+        con->cola_enviado += enviado;
+        break;
+      }
+
+      enviado -= primero->longitud - con->cola_enviado;
+      con->cola_enviado = 0;
+      con->cola_inicio = (con->cola_inicio + 1) % CONEXION_COLA_MENSAJES;
+      con->cola_len--;
+      mensaje_soltar(primero);
+    }
+  }
+
+  if (con->cerrar_al_vaciar)
+  {
+    // Ya salió la trama de cierre
+    cerrar_conexion(epoll_fd, con);
+    return -1;
+  }
+
+  esperar_eventos(epoll_fd, con, EPOLLIN);
+
+  return 0;
+}
+
+/**
+ * @brief Lee y descarta lo que envíe una conexión suscripta, solo interesa si se cerró
+ */
+static void descartar_entrada(int epoll_fd, conexion *con)
+{
+  ssize_t recibido;
+
+  while ((recibido = recv(con->fd, con->entrada, CONEXION_BUFFER_SIZE, 0)) > 0)
+  {
+  }
+
+  if (recibido == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+  {
+    cerrar_conexion(epoll_fd, con);
+  }
+}
+
+/**
+ * @brief Primera muestra a reenviar a un cliente que ya recibió hasta ultima_recibida
+ *
+ * @param secuencia Secuencia de la última muestra de una copia del buffer
+ */
+static uint32_t primera_pendiente(uint32_t ultima_recibida, uint32_t secuencia)
+{
+  uint32_t desde = ultima_recibida + 1;
+
+  // Las muestras más viejas que el buffer se perdieron
+  if ((int32_t)(secuencia - desde) >= BUFFER_SIZE)
+  {
+    desde = secuencia - BUFFER_SIZE + 1;
+  }
+
+  // Una secuencia posterior a la última muestra es de una ejecución anterior del servidor
+  if ((int32_t)(ultima_difundida - ultima_recibida) < 0)
+  {
+    desde = ultima_difundida + 1;
+  }
+
+  return desde;
+}
+
+/**
+ * @brief Pasa la conexión a la lista de suscriptas
+ *
+ * Si el cliente se reconecta con Last-Event-ID se le reenvían las muestras
+ * posteriores que todavía estén en el buffer, hasta la última difundida.
+ * Las siguientes le llegan con el resto de las conexiones.
+ */
+static void suscribir(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  float temp[BUFFER_SIZE];
+  int64_t tiempo_ns[BUFFER_SIZE];
+  uint32_t secuencia;
+  uint32_t desde;
+  mensaje *msj;
+  int reanudar = con->respuesta.reanudar;
+  uint32_t ultimo_evento = con->respuesta.ultimo_evento;
+
+  server_client_liberar_respuesta(&con->respuesta);
+
+  lista_quitar(&activas, con);
+  con->estado = CONEXION_SUSCRIPTA;
+  lista_agregar(&suscriptas, con);
+
+  if (reanudar && copiar_ventana(buffer, temp, tiempo_ns, &secuencia) == 0)
+  {
+    desde = primera_pendiente(ultimo_evento, secuencia);
+
+    for (uint32_t sec = desde; (int32_t)(ultima_difundida - sec) >= 0; sec++)
+    {
+      int posicion = BUFFER_SIZE - 1 - (int)(secuencia - sec);
+
+      if (posicion < 0 || (msj = mensaje_muestra(sec, tiempo_ns[posicion], temp[posicion])) == NULL)
+      {
+        continue;
+      }
+
+      if (encolar(epoll_fd, con, msj) < 0)
+      {
+        mensaje_soltar(msj);
+        return;
+      }
+
+      mensaje_soltar(msj);
+    }
+  }
+
+  enviar_cola(epoll_fd, con);
+}
+
+/**
+ * @brief Pasa la conexión a la lista de WebSocket
+ *
+ * Las tramas que el cliente haya enviado junto con el handshake ya están en
+ * la entrada y se procesan enseguida.
+ */
+static void abrir_websocket(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  server_client_liberar_respuesta(&con->respuesta);
+
+  lista_quitar(&activas, con);
+  con->estado = CONEXION_WEBSOCKET;
+  lista_agregar(&websockets, con);
+
+  esperar_eventos(epoll_fd, con, EPOLLIN);
+
+  if (con->entrada_len > 0)
+  {
+    procesar_tramas(epoll_fd, con, buffer);
+  }
+}
+
+/**
+ * @brief Lee lo disponible en el socket de una conexión WebSocket y procesa las tramas
+ */
+static void atender_websocket(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  ssize_t recibido;
+
+  while (con->entrada_len < CONEXION_BUFFER_SIZE)
+  {
+    recibido = recv(con->fd, con->entrada + con->entrada_len,
+                    CONEXION_BUFFER_SIZE - con->entrada_len, 0);
+
+    if (recibido == 0)
+    {
+      cerrar_conexion(epoll_fd, con);
+      return;
+    }
+
+    if (recibido < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        break;
+      }
+      cerrar_conexion(epoll_fd, con);
+      return;
+    }
+
+    con->entrada_len += recibido;
+  }
+
+  procesar_tramas(epoll_fd, con, buffer);
+}
+
+/**
+ * @brief Atiende las tramas completas de la entrada y deja el resto para la próxima lectura
+ *
+ * Solo se aceptan mensajes de texto sin fragmentar (los comandos), ping, pong
+ * y cierre. Cualquier trama recibida cuenta como actividad del cliente.
+ */
+static void procesar_tramas(int epoll_fd, conexion *con, shared_buffer *buffer)
+{
+  uint8_t *datos = (uint8_t *)con->entrada;
+  size_t procesado = 0;
+  ssize_t consumido;
+  ws_trama trama;
+  mensaje *msj;
+
+  // Después de enviar el cierre se ignora lo que siga llegando
+  while (!con->cerrar_al_vaciar && con->estado == CONEXION_WEBSOCKET)
+  {
+    trama.carga_len = 0;
+    consumido = server_websocket_decodificar(datos + procesado, con->entrada_len - procesado, &trama);
+
+    if (consumido == 0)
+    {
+      break;
+    }
+
+    if (consumido < 0)
+    {
+      cerrar_websocket(epoll_fd, con, trama.carga_len > WS_MENSAJE_MAX ? WS_CIERRE_DEMASIADO_GRANDE : WS_CIERRE_PROTOCOLO);
+      break;
+    }
+
+    lista_quitar(&websockets, con);
+    lista_agregar(&websockets, con);
+    con->ping_pendiente = 0;
+
+    if (trama.opcode == WS_PING)
+    {
+      if ((msj = mensaje_websocket(WS_PONG, datos + procesado + trama.carga_inicio, trama.carga_len)) != NULL)
+      {
+        encolar(epoll_fd, con, msj);
+        mensaje_soltar(msj);
+      }
+    }
+    else if (trama.opcode == WS_CIERRE)
+    {
+      // Se responde con el mismo código de estado, si el cliente envió uno
+      if ((msj = mensaje_websocket(WS_CIERRE, datos + procesado + trama.carga_inicio, trama.carga_len >= 2 ? 2 : 0)) == NULL ||
+          encolar(epoll_fd, con, msj) == 0)
+      {
+        con->cerrar_al_vaciar = 1;
+      }
+
+      if (msj != NULL)
+      {
+        mensaje_soltar(msj);
+      }
+    }
+    else if (trama.opcode == WS_TEXTO && trama.fin)
+    {
+      comando_websocket(epoll_fd, con, buffer, (const char *)datos + procesado + trama.carga_inicio, trama.carga_len);
+    }
+    else if (trama.opcode != WS_PONG)
+    {
+      // Binarios, fragmentados u opcodes desconocidos
+      cerrar_websocket(epoll_fd, con, WS_CIERRE_NO_SOPORTADO);
+      break;
+    }
+
+    procesado += consumido;
+  }
+
+  if (con->estado == CONEXION_CERRADA)
+  {
+    return;
+  }
+
+  if (con->cerrar_al_vaciar)
+  {
+    con->entrada_len = 0;
+  }
+  else
+  {
+    con->entrada_len -= procesado;
+    memmove(con->entrada, con->entrada + procesado, con->entrada_len);
+  }
+
+  enviar_cola(epoll_fd, con);
+}
+
+/**
+ * @brief Atiende un comando de texto del cliente
+ *
+ * "decimar N": desde ahora recibe solo las muestras con secuencia múltiplo de N.
+ * "desde N": recibe en una trama las muestras posteriores a la secuencia N que
+ * sigan en el buffer. Los comandos desconocidos se ignoran.
+ */
+static void comando_websocket(int epoll_fd, conexion *con, shared_buffer *buffer, const char *texto, size_t longitud)
+{
+  char comando[32];
+  char *fin;
+  unsigned long valor;
+  float temp[BUFFER_SIZE];
+  int64_t tiempo_ns[BUFFER_SIZE];
+  uint32_t secuencia;
+  mensaje *msj;
+
+  if (longitud >= sizeof(comando))
+  {
+    return;
+  }
+
+  memcpy(comando, texto, longitud);
+  comando[longitud] = '\0';
+
+  if (strncmp(comando, "decimar ", 8) == 0)
+  {
+    valor = strtoul(comando + 8, &fin, 10);
+
+    if (fin != comando + 8 && *fin == '\0' && valor > 0 && valor <= UINT_MAX)
+    {
+      con->decimacion = valor;
+    }
+  }
+  else if (strncmp(comando, "desde ", 6) == 0)
+  {
+    valor = strtoul(comando + 6, &fin, 10);
+
+    if (fin == comando + 6 || *fin != '\0' || copiar_ventana(buffer, temp, tiempo_ns, &secuencia) < 0)
+    {
+      return;
+    }
+
+    msj = mensaje_registros(temp, tiempo_ns, secuencia, primera_pendiente((uint32_t)valor, secuencia),
+                            ultima_difundida, con->decimacion);
+
+    if (msj != NULL)
+    {
+      encolar(epoll_fd, con, msj);
+      mensaje_soltar(msj);
+    }
+  }
+}
+
+/**
+ * @brief Encola una trama de cierre con el código indicado y deja de procesar la entrada
+ *
+ * La conexión se cierra cuando termina de enviar lo que tenga encolado.
+ */
+static void cerrar_websocket(int epoll_fd, conexion *con, uint16_t codigo)
+{
+  uint8_t carga[2] = {codigo >> 8, codigo & 0xFF};
+  mensaje *msj;
+
+  if ((msj = mensaje_websocket(WS_CIERRE, carga, sizeof(carga))) == NULL)
+  {
+    cerrar_conexion(epoll_fd, con);
+    return;
+  }
+
+  if (encolar(epoll_fd, con, msj) == 0)
+  {
+    con->cerrar_al_vaciar = 1;
+  }
+
+  mensaje_soltar(msj);
+}
+
+/**
+ * @brief Envía un ping a las conexiones WebSocket sin actividad por WS_PING_INTERVALO
+ * y cierra las que tampoco respondieron al ping anterior
+ *
+ * La lista está ordenada por última actividad, solo se recorren las vencidas.
+ */
+static void revisar_websockets(int epoll_fd)
+{
+  time_t limite = segundos_monotonicos() - WS_PING_INTERVALO;
+  conexion *con;
+  mensaje *ping;
+
+  while ((con = websockets.primera) != NULL && con->ultima_actividad <= limite)
+  {
+    if (con->ping_pendiente || con->cerrar_al_vaciar)
+    {
+      cerrar_conexion(epoll_fd, con);
+      continue;
+    }
+
+    lista_quitar(&websockets, con);
+    lista_agregar(&websockets, con);
+    con->ping_pendiente = 1;
+
+    if ((ping = mensaje_websocket(WS_PING, "", 0)) == NULL)
+    {
+      return;
+    }
+
+    if (encolar(epoll_fd, con, ping) == 0)
+    {
+      enviar_cola(epoll_fd, con);
+    }
+
+    mensaje_soltar(ping);
+  }
+}
+
+/**
+ * @brief Envía a todas las conexiones suscriptas las muestras nuevas del buffer
+ *
+ * Cada muestra se serializa una sola vez por protocolo (evento SSE y trama
+ * binaria WebSocket) sin importar cuántas conexiones haya.
+ */
+static void difundir_muestras(int epoll_fd, shared_buffer *buffer)
+{
+  float temp[BUFFER_SIZE];
+  int64_t tiempo_ns[BUFFER_SIZE];
+  uint32_t secuencia;
+  uint32_t desde;
+  uint64_t avisos;
+  mensaje *msj;
+  mensaje *trama;
+  conexion *con;
+  conexion *siguiente;
+
+  // Varios avisos juntos se atienden con una sola copia del buffer
+  while (read(buffer_aviso_fd(), &avisos, sizeof(avisos)) > 0)
+  {
+  }
+
+  if (copiar_ventana(buffer, temp, tiempo_ns, &secuencia) < 0 || secuencia == ultima_difundida)
+  {
+    return;
+  }
+
+  desde = ultima_difundida + 1;
+
+  if ((int32_t)(secuencia - desde) >= BUFFER_SIZE)
+  {
+    desde = secuencia - BUFFER_SIZE + 1;
+  }
+
+  for (uint32_t sec = desde; (int32_t)(secuencia - sec) >= 0; sec++)
+  {
+    int posicion = BUFFER_SIZE - 1 - (int)(secuencia - sec);
+
+    if (suscriptas.primera != NULL && (msj = mensaje_muestra(sec, tiempo_ns[posicion], temp[posicion])) != NULL)
+    {
+      for (con = suscriptas.primera; con != NULL; con = siguiente)
+      {
+        siguiente = con->siguiente;
+        encolar(epoll_fd, con, msj);
+      }
+
+      mensaje_soltar(msj);
+    }
+
+    // La trama se arma recién cuando alguna conexión la recibe
+    trama = NULL;
+
+    for (con = websockets.primera; con != NULL; con = siguiente)
+    {
+      siguiente = con->siguiente;
+
+      if (con->cerrar_al_vaciar || sec % con->decimacion != 0)
+      {
+        continue;
+      }
+
+      if (trama == NULL && (trama = mensaje_registros(temp, tiempo_ns, secuencia, sec, sec, 1)) == NULL)
+      {
+        break;
+      }
+
+      encolar(epoll_fd, con, trama);
+    }
+
+    if (trama != NULL)
+    {
+      mensaje_soltar(trama);
+    }
+  }
+
+  ultima_difundida = secuencia;
+
+  for (con = suscriptas.primera; con != NULL; con = siguiente)
+  {
+    siguiente = con->siguiente;
+    enviar_cola(epoll_fd, con);
+  }
+
+  for (con = websockets.primera; con != NULL; con = siguiente)
+  {
+    siguiente = con->siguiente;
+    enviar_cola(epoll_fd, con);
+  }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file server_sse.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Eventos Server-Sent Events (text/event-stream) de /stream
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/server_sse.h"
+
+#include <stdio.h>
+
+/*Funciones de la biblioteca*/
+
+int server_sse_evento(char *destino, size_t destino_size, uint32_t secuencia, int64_t tiempo_ns, float temp)
+{
+    // Los tiempos son desde el inicio, no negativos: alcanza con dividir en enteros
+    int64_t milisegundos = (tiempo_ns + 500000) / 1000000;
+
+    return snprintf(destino, destino_size, "id: %u\ndata: {\"time\":%lld.%03d,\"temp\":%.2f}\n\n",
+                    secuencia, (long long)(milisegundos / 1000), (int)(milisegundos % 1000), temp);
+}
+
+int server_sse_ultimo_id(const char *datos, const http_pedido *pedido, uint32_t *id)
+{
+    const http_segmento *ultimo_id = http_pedido_cabecera(pedido, datos, "Last-Event-ID");
+    uint64_t valor = 0;
+
+    if (ultimo_id == NULL || ultimo_id->longitud == 0 || ultimo_id->longitud > 10)
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ultimo_id->longitud; i++)
+    {
+        char c = datos[ultimo_id->inicio + i];
+
+        if (c < '0' || c > '9')
+        {
+            return -1;
+        }
+
+        valor = valor * 10 + (c - '0');
+    }
+
+    if (valor > UINT32_MAX)
+    {
+        return -1;
+    }
+
+    *id = (uint32_t)valor;
+
+    return 0;
+}
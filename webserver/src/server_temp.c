@@ -9,65 +9,316 @@
  * 
  */
 
-#define FILE_TEMP "/dev/bmp280_sitara"
-#define MAX_SIZE 30
+#include "../inc/server_temp.h"
 
-#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
 #include <stdio.h>
-#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+/*Funciones privadas*/
+
+static int abrir_dispositivo(sensor *s);
+static int esperar_timer(sensor *s);
+static int esperar_dispositivo(sensor *s);
+static int leer_dispositivo(sensor *s, float *temp);
+static int64_t diferencia_ns(const struct timespec *a, const struct timespec *b);
+static void sumar_ns(struct timespec *t, int64_t ns);
 
-float get_temp(void)
+/*Funciones de la biblioteca*/
+
+int sensor_abrir(sensor *s, int periodo_ms)
 {
-    float temp = 0;
-    FILE *fp;
-    int i = 0;
-    char *line = NULL;
+    struct itimerspec timer;
+
+    if(s == NULL || (periodo_ms < SENSOR_PERIODO_MIN_MS && periodo_ms != SENSOR_PERIODO_DRIVER))
+    {
+        fprintf(stderr, "Error en sensor_abrir\n");
+        return -1;
+    }
 
-    // Get space for line
-    line = (char *)malloc(sizeof(char) * MAX_SIZE);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    s->timer_fd = -1;
+    s->periodo_ns = periodo_ms * 1000000LL;
+    s->muestreo.periodo_us = periodo_ms * 1000;
 
-    if(line == NULL)
+    if(abrir_dispositivo(s) < 0)
     {
-        printf("ERROR: No se pudo reservar memoria para la linea\n");
+        fprintf(stderr, "ERROR: No se pudo abrir el archivo %s: %s\n", SENSOR_ARCHIVO, strerror(errno));
+    }
+
+    // Sin timer el período lo marca el driver, muestreo.periodo_us se mide entre muestras
+    if(periodo_ms == SENSOR_PERIODO_DRIVER)
+    {
+        return 0;
+    }
+
+    s->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    if(s->timer_fd < 0)
+    {
+        perror("Error en timerfd_create");
+        sensor_cerrar(s);
         return -1;
     }
-    if((fp = fopen(FILE_TEMP, "r")) == NULL)
+
+    // Vencimientos absolutos: el n-ésimo es siempre inicio + n * período
+    clock_gettime(CLOCK_MONOTONIC, &s->proximo);
+    sumar_ns(&s->proximo, s->periodo_ns);
+
+    timer.it_value = s->proximo;
+    timer.it_interval.tv_sec = s->periodo_ns / 1000000000;
+    timer.it_interval.tv_nsec = s->periodo_ns % 1000000000;
+
+    if(timerfd_settime(s->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL) < 0)
     {
-        printf("ERROR: No se pudo abrir el archivo %s\n", FILE_TEMP);
+        perror("Error en timerfd_settime");
+        sensor_cerrar(s);
         return -1;
     }
 
-    // Read until /n
+    return 0;
+}
+
+int sensor_muestrear(sensor *s, float *temp)
+{
+    buffer_muestreo *muestreo = &s->muestreo;
+    struct timespec despierto;
+    struct timespec leido;
+    int64_t anterior_ns = s->muestra_ns;
+    int64_t despierto_ns;
+    double retraso;
+    double lectura;
+    double media_anterior;
+    int retval;
+
+    if(s->timer_fd >= 0 && esperar_timer(s) < 0)
+    {
+        return -1;
+    }
+
+    if(s->timer_fd < 0)
+    {
+        esperar_dispositivo(s);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &despierto);
+    despierto_ns = despierto.tv_sec * 1000000000LL + despierto.tv_nsec;
+    s->tiempo_ns = despierto_ns;
+
+    retval = leer_dispositivo(s, temp);
+
+    clock_gettime(CLOCK_MONOTONIC, &leido);
+
+    if(retval > 0)
+    {
+        s->tiempo_ns = s->muestra_ns;
+    }
+
+    // Sin timer solo se lee cuando poll avisó o venció SENSOR_ESPERA_MS: que no haya nada es un error
+    if(retval == 0 && s->timer_fd < 0)
+    {
+        retval = -1;
+    }
 
-    while(i < MAX_SIZE)
+    if(s->timer_fd >= 0)
     {
-        if(fread(&line[i], sizeof(char), 1, fp) == 0)
+        s->retraso_ns = diferencia_ns(&despierto, &s->proximo);
+        sumar_ns(&s->proximo, s->periodo_ns);
+    }
+    else
+    {
+        // Sin timer el retraso es desde que el driver tomó la muestra hasta que se despertó el poll
+        s->retraso_ns = (retval > 0) ? despierto_ns - s->tiempo_ns : 0;
+
+        if(retval > 0 && anterior_ns > 0)
         {
-            printf("ERROR: No se pudo leer el archivo %s\n", FILE_TEMP);
+            muestreo->periodo_us = (s->tiempo_ns - anterior_ns) / 1000;
         }
-        if(line[i] == '\n')
+
+        // Si llegó más de una juntas solo se guarda la última
+        if(retval > 1)
+        {
+            muestreo->perdidas += retval - 1;
+        }
+    }
+
+    s->lectura_ns = diferencia_ns(&leido, &despierto);
+    retraso = s->retraso_ns / 1000.0;
+    lectura = s->lectura_ns / 1000.0;
+
+    muestreo->muestras++;
+    media_anterior = muestreo->retraso_medio_us;
+    muestreo->retraso_medio_us += (retraso - media_anterior) / muestreo->muestras;
+    s->m2_retraso += (retraso - media_anterior) * (retraso - muestreo->retraso_medio_us);
+    muestreo->retraso_desvio_us = sqrt(s->m2_retraso / muestreo->muestras);
+    muestreo->retraso_max_us = fmax(muestreo->retraso_max_us, retraso);
+    muestreo->lectura_media_us += (lectura - muestreo->lectura_media_us) / muestreo->muestras;
+    muestreo->lectura_max_us = fmax(muestreo->lectura_max_us, lectura);
+
+    if(retval < 0)
+    {
+        muestreo->errores++;
+    }
+
+    return (retval > 0) ? 0 : -1;
+}
+
+void sensor_cerrar(sensor *s)
+{
+    if(s->fd >= 0)
+    {
+        close(s->fd);
+        s->fd = -1;
+    }
+
+    if(s->timer_fd >= 0)
+    {
+        close(s->timer_fd);
+        s->timer_fd = -1;
+    }
+}
+
+/*Funciones privadas*/
+
+static int abrir_dispositivo(sensor *s)
+{
+    // Sin bloquear: si el driver no encoló nada desde el vencimiento anterior no se espera
+    s->fd = open(SENSOR_ARCHIVO, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+
+    return s->fd;
+}
+
+/**
+ * @brief Espera el próximo vencimiento del timer y cuenta los que se perdieron
+ */
+static int esperar_timer(sensor *s)
+{
+    uint64_t vencimientos;
+
+    while(read(s->timer_fd, &vencimientos, sizeof(vencimientos)) != sizeof(vencimientos))
+    {
+        if(errno != EINTR)
         {
-            break;
+            perror("Error al leer el timer");
+            return -1;
         }
-        i++;
     }
 
-    printf("Line: %s\n", line);
+    // Si la lectura anterior tardó más de un período se perdieron vencimientos
+    sumar_ns(&s->proximo, (vencimientos - 1) * s->periodo_ns);
+    s->muestreo.perdidas += vencimientos - 1;
+
+    return 0;
+}
+
+/**
+ * @brief Espera hasta SENSOR_ESPERA_MS a que el driver encole una muestra
+ * 
+ * Si el dispositivo no está abierto poll ignora el fd negativo y solo espera,
+ * así los reintentos de abrirlo no giran en vacío.
+ * 
+ * @return int 1 si es legible, 0 si venció la espera, -1 si hubo un error
+ */
+static int esperar_dispositivo(sensor *s)
+{
+    struct pollfd pfd = {.fd = s->fd, .events = POLLIN};
+    int listos;
+
+    while((listos = poll(&pfd, 1, SENSOR_ESPERA_MS)) < 0 && errno == EINTR)
+    {
+        continue;
+    }
+
+    return listos;
+}
+
+/**
+ * @brief Vacía la cola del driver con un solo read y se queda con la muestra más reciente
+ * 
+ * El driver devuelve una línea "tiempo_ns centésimas\n" por muestra, en orden,
+ * sin I/O con el bus. Si no hay ninguna nueva (EAGAIN) no es un error: el
+ * período del timer puede ser menor que el del driver o caer justo antes.
+ * 
+ * @return int Cantidad de muestras leídas, 0 si no había ninguna nueva, -1 si hubo un error
+ */
+static int leer_dispositivo(sensor *s, float *temp)
+{
+    ssize_t leidos;
+    char *linea;
+    char *salto;
+    char *fin;
+    long long tiempo_ns;
+    long centesimas;
+    int validas = 0;
+
+    *temp = -1;
+
+    if(s->fd < 0 && abrir_dispositivo(s) < 0)
+    {
+        return -1;
+    }
+
+    leidos = read(s->fd, s->lectura, sizeof(s->lectura) - 1);
 
-    if(fgets(line, MAX_SIZE, fp) == NULL)
+    if(leidos < 0 && (errno == EAGAIN || errno == EINTR))
     {
-        printf("ERROR: No se pudo leer el archivo %s\n", FILE_TEMP);
+        return 0;
+    }
+
+    if(leidos <= 0)
+    {
+        if(s->muestreo.errores == 0)
+        {
+            fprintf(stderr, "ERROR: No se pudo leer el archivo %s\n", SENSOR_ARCHIVO);
+        }
+
+        // Se reabre en la próxima lectura por si el driver se recargó
+        close(s->fd);
+        s->fd = -1;
         return -1;
     }
 
-    temp = atof(line)/100;
+    s->lectura[leidos] = '\0';
 
-    // Free memory
+    for(linea = s->lectura; (salto = strchr(linea, '\n')) != NULL; linea = salto + 1)
+    {
+        tiempo_ns = strtoll(linea, &fin, 10);
 
-    free(line);
+        if(fin == linea || *fin != ' ')
+        {
+            continue;
+        }
 
-    fclose(fp);
+        centesimas = strtol(fin + 1, &fin, 10);
+
+        if(fin != salto)
+        {
+            continue;
+        }
 
-    return temp;
-}
\ No newline at end of file
+        s->muestra_ns = tiempo_ns;
+        *temp = centesimas / 100.0f;
+        validas++;
+    }
+
+    return (validas > 0) ? validas : -1;
+}
+
+static int64_t diferencia_ns(const struct timespec *a, const struct timespec *b)
+{
+    return (a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static void sumar_ns(struct timespec *t, int64_t ns)
+{
+    ns += t->tv_nsec;
+    t->tv_sec += ns / 1000000000;
+    t->tv_nsec = ns % 1000000000;
+}
@@ -0,0 +1,306 @@
+/**
+ * @file server_websocket.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Protocolo WebSocket (RFC 6455) de /ws: handshake y tramas
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/server_websocket.h"
+
+#include <string.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define SHA1_SIZE 20
+
+/*Funciones privadas*/
+
+static void sha1(const uint8_t *datos, size_t longitud, uint8_t *resumen);
+static void sha1_bloque(uint32_t *estado, const uint8_t *bloque);
+static void base64(const uint8_t *datos, size_t longitud, char *destino);
+static void escribir_u32(uint8_t *destino, uint32_t valor);
+
+/*Funciones de la biblioteca*/
+
+void server_websocket_aceptar(const char *clave, size_t clave_len, char *aceptar)
+{
+    uint8_t concatenado[WS_CLAVE_LEN + sizeof(WS_GUID)];
+    uint8_t resumen[SHA1_SIZE];
+
+    if (clave_len > WS_CLAVE_LEN)
+    {
+        clave_len = WS_CLAVE_LEN;
+    }
+
+    memcpy(concatenado, clave, clave_len);
+    memcpy(concatenado + clave_len, WS_GUID, sizeof(WS_GUID) - 1);
+
+    sha1(concatenado, clave_len + sizeof(WS_GUID) - 1, resumen);
+    base64(resumen, SHA1_SIZE, aceptar);
+}
+
+size_t server_websocket_cabecera(uint8_t *destino, ws_opcode opcode, size_t carga_len)
+{
+    destino[0] = 0x80 | opcode;
+
+    if (carga_len < 126)
+    {
+        destino[1] = carga_len;
+        return 2;
+    }
+
+    if (carga_len <= 0xFFFF)
+    {
+        destino[1] = 126;
+        destino[2] = carga_len >> 8;
+        destino[3] = carga_len;
+        return 4;
+    }
+
+    destino[1] = 127;
+
+    for (int i = 0; i < 8; i++)
+    {
+        destino[2 + i] = (uint64_t)carga_len >> (56 - 8 * i);
+    }
+
+    return 10;
+}
+
+void server_websocket_registro(uint8_t *destino, uint32_t secuencia, int64_t tiempo_ns, float temp)
+{
+    uint32_t bits;
+
+    escribir_u32(destino, secuencia);
+
+    memcpy(&bits, &temp, sizeof(bits));
+    escribir_u32(destino + 4, bits);
+
+    escribir_u32(destino + 8, (uint64_t)tiempo_ns);
+    escribir_u32(destino + 12, (uint64_t)tiempo_ns >> 32);
+}
+
+ssize_t server_websocket_decodificar(uint8_t *datos, size_t longitud, ws_trama *trama)
+{
+    size_t posicion = 2;
+    uint64_t carga_len;
+    uint8_t mascara[4];
+
+    if (longitud < 2)
+    {
+        return 0;
+    }
+
+    // Los bits reservados deben ser 0 y el cliente siempre enmascara
+    if ((datos[0] & 0x70) != 0 || (datos[1] & 0x80) == 0)
+    {
+        return -1;
+    }
+
+    trama->fin = (datos[0] & 0x80) != 0;
+    trama->opcode = datos[0] & 0x0F;
+    carga_len = datos[1] & 0x7F;
+
+    if (carga_len == 126)
+    {
+        if (longitud < 4)
+        {
+            return 0;
+        }
+        carga_len = ((uint64_t)datos[2] << 8) | datos[3];
+        posicion = 4;
+    }
+    else if (carga_len == 127)
+    {
+        if (longitud < 10)
+        {
+            return 0;
+        }
+        carga_len = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            carga_len = (carga_len << 8) | datos[2 + i];
+        }
+        posicion = 10;
+    }
+
+    // Las tramas de control no se fragmentan ni superan los 125 bytes
+    if ((trama->opcode & 0x08) && (!trama->fin || carga_len > WS_CONTROL_MAX))
+    {
+        return -1;
+    }
+
+    if (carga_len > WS_MENSAJE_MAX)
+    {
+        // Se informa el tamaño para responder con WS_CIERRE_DEMASIADO_GRANDE
+        trama->carga_len = carga_len;
+        return -1;
+    }
+
+    if (longitud < posicion + 4 + carga_len)
+    {
+        return 0;
+    }
+
+    memcpy(mascara, datos + posicion, 4);
+    posicion += 4;
+
+    for (size_t i = 0; i < carga_len; i++)
+    {
+        datos[posicion + i] ^= mascara[i % 4];
+    }
+
+    trama->carga_inicio = posicion;
+    trama->carga_len = carga_len;
+
+    return posicion + carga_len;
+}
+
+/*Funciones privadas*/
+
+static void escribir_u32(uint8_t *destino, uint32_t valor)
+{
+    destino[0] = valor;
+    destino[1] = valor >> 8;
+    destino[2] = valor >> 16;
+    destino[3] = valor >> 24;
+}
+
+#define ROTAR(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/**
+ * @brief SHA-1 (RFC 3174), solo se usa para el handshake
+ */
+static void sha1(const uint8_t *datos, size_t longitud, uint8_t *resumen)
+{
+    uint32_t estado[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t bloque[64];
+    size_t resto;
+    uint64_t bits = (uint64_t)longitud * 8;
+
+    for (; longitud >= 64; datos += 64, longitud -= 64)
+    {
+        sha1_bloque(estado, datos);
+    }
+
+    // Relleno: 0x80, ceros y la longitud en bits al final del último bloque
+    resto = longitud;
+    memcpy(bloque, datos, resto);
+    bloque[resto++] = 0x80;
+
+    if (resto > 56)
+    {
+        memset(bloque + resto, 0, 64 - resto);
+        sha1_bloque(estado, bloque);
+        resto = 0;
+    }
+
+    memset(bloque + resto, 0, 56 - resto);
+
+    for (int i = 0; i < 8; i++)
+    {
+        bloque[56 + i] = bits >> (56 - 8 * i);
+    }
+
+    sha1_bloque(estado, bloque);
+
+    for (int i = 0; i < 5; i++)
+    {
+        resumen[4 * i] = estado[i] >> 24;
+        resumen[4 * i + 1] = estado[i] >> 16;
+        resumen[4 * i + 2] = estado[i] >> 8;
+        resumen[4 * i + 3] = estado[i];
+    }
+}
+
+static void sha1_bloque(uint32_t *estado, const uint8_t *bloque)
+{
+    uint32_t w[80];
+    uint32_t a = estado[0], b = estado[1], c = estado[2], d = estado[3], e = estado[4];
+    uint32_t f, k, temp;
+
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)bloque[4 * i] << 24) | ((uint32_t)bloque[4 * i + 1] << 16) |
+               ((uint32_t)bloque[4 * i + 2] << 8) | bloque[4 * i + 3];
+    }
+
+    for (int i = 16; i < 80; i++)
+    {
+        w[i] = ROTAR(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    for (int i = 0; i < 80; i++)
+    {
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        temp = ROTAR(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROTAR(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    estado[0] += a;
+    estado[1] += b;
+    estado[2] += c;
+    estado[3] += d;
+    estado[4] += e;
+}
+
+static void base64(const uint8_t *datos, size_t longitud, char *destino)
+{
+    static const char alfabeto[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+
+    for (i = 0; i + 2 < longitud; i += 3)
+    {
+        *destino++ = alfabeto[datos[i] >> 2];
+        *destino++ = alfabeto[((datos[i] & 0x03) << 4) | (datos[i + 1] >> 4)];
+        *destino++ = alfabeto[((datos[i + 1] & 0x0F) << 2) | (datos[i + 2] >> 6)];
+        *destino++ = alfabeto[datos[i + 2] & 0x3F];
+    }
+
+    if (i < longitud)
+    {
+        *destino++ = alfabeto[datos[i] >> 2];
+
+        if (i + 1 < longitud)
+        {
+            *destino++ = alfabeto[((datos[i] & 0x03) << 4) | (datos[i + 1] >> 4)];
+            *destino++ = alfabeto[(datos[i + 1] & 0x0F) << 2];
+        }
+        else
+        {
+            *destino++ = alfabeto[(datos[i] & 0x03) << 4];
+            *destino++ = '=';
+        }
+
+        *destino++ = '=';
+    }
+
+    *destino = '\0';
+}
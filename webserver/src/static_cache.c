@@ -0,0 +1,611 @@
+/**
+ * @file static_cache.c
+ * @author Juan Costa Suárez (jcostasurez@frba.utn.edu.ar)
+ * @brief Cache en memoria de los archivos estáticos de public/
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "../inc/static_cache.h"
+#include "../inc/server_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define INOTIFY_EVENTOS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+#define INOTIFY_BUFFER_SIZE 4096
+#define HASH_BLOQUE_SIZE 16384
+#define FNV1A_INICIAL 0xcbf29ce484222325ULL
+
+/*Variables privadas*/
+
+/// @brief Extensión de los archivos de cada variante y su cabecera Content-Encoding
+static const struct
+{
+    const char *extension;
+    const char *cabecera;
+} codificaciones[STATIC_CODIFICACIONES] =
+{
+    [STATIC_IDENTIDAD] = {"", ""},
+    [STATIC_GZIP] = {".gz", "Content-Encoding: gzip\r\n"},
+    [STATIC_BROTLI] = {".br", "Content-Encoding: br\r\n"},
+};
+
+static char directorio_base[STATIC_CACHE_RUTA_SIZE];
+static static_cache *cache_actual = NULL;
+static int inotify_fd = -1;
+
+/*Funciones privadas*/
+
+static static_cache *cargar_cache(void);
+static int cargar_directorio(static_cache *cache, const char *ruta_relativa);
+static int cargar_archivo(static_entrada *entrada, const char *ruta_completa);
+static int cargar_variante(static_variante *variante, const char *ruta_completa, const char *content_type, struct stat *info);
+static void armar_cabeceras(static_entrada *entrada, static_codificacion codificacion);
+static int es_variante(const char *nombre);
+static const char *tipo_de_contenido(const char *ruta);
+static int leer_completo(int fd, char *destino, size_t longitud, off_t offset);
+static int hash_de_archivo(int fd, size_t longitud, char *etag);
+static uint64_t fnv1a(uint64_t hash, const char *datos, size_t longitud);
+static void liberar_cache(static_cache *cache);
+
+/*Funciones de la biblioteca*/
+
+int static_cache_iniciar(const char *directorio)
+{
+    snprintf(directorio_base, sizeof(directorio_base), "%s", directorio);
+
+    if ((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+    {
+        perror("Error en inotify_init1");
+        return -1;
+    }
+
+    if ((cache_actual = cargar_cache()) == NULL)
+    {
+        close(inotify_fd);
+        inotify_fd = -1;
+        return -1;
+    }
+
+    printf("Cache de archivos estaticos: %u archivos de %s\n", cache_actual->n_entradas, directorio_base);
+
+    return 0;
+}
+
+int static_cache_fd(void)
+{
+    return inotify_fd;
+}
+
+void static_cache_revisar(void)
+{
+    char eventos[INOTIFY_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int cambios = 0;
+    static_cache *nueva;
+
+    if (inotify_fd < 0)
+    {
+        return;
+    }
+
+    // Se vacía la cola de eventos, con uno solo alcanza para recargar
+    while (read(inotify_fd, eventos, sizeof(eventos)) > 0)
+    {
+        cambios = 1;
+    }
+
+    if (!cambios)
+    {
+        return;
+    }
+
+    if ((nueva = cargar_cache()) == NULL)
+    {
+        fprintf(stderr, "Error al recargar la cache, se mantiene la anterior\n");
+        return;
+    }
+
+    static_cache_liberar(cache_actual);
+    cache_actual = nueva;
+
+    printf("Cache de archivos estaticos recargada: %u archivos\n", cache_actual->n_entradas);
+}
+
+static_cache *static_cache_obtener(void)
+{
+    if (cache_actual != NULL)
+    {
+        cache_actual->referencias++;
+    }
+
+    return cache_actual;
+}
+
+void static_cache_liberar(static_cache *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    if (--cache->referencias == 0)
+    {
+        liberar_cache(cache);
+    }
+}
+
+const static_entrada *static_cache_buscar(const static_cache *cache, const char *ruta, size_t ruta_len)
+{
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < cache->n_entradas; i++)
+    {
+        if (strncmp(cache->entradas[i].ruta, ruta, ruta_len) == 0 && cache->entradas[i].ruta[ruta_len] == '\0')
+        {
+            return &cache->entradas[i];
+        }
+    }
+
+    return NULL;
+}
+
+const static_variante *static_cache_variante(const static_entrada *entrada, unsigned int aceptadas)
+{
+    const static_variante *elegida = &entrada->variantes[STATIC_IDENTIDAD];
+
+    for (int i = STATIC_GZIP; i < STATIC_CODIFICACIONES; i++)
+    {
+        if ((entrada->codificaciones & aceptadas & (1 << i)) && entrada->variantes[i].cuerpo_len < elegida->cuerpo_len)
+        {
+            elegida = &entrada->variantes[i];
+        }
+    }
+
+    return elegida;
+}
+
+/*Funciones privadas*/
+
+/**
+ * @brief Carga una generación nueva con todos los archivos del directorio base
+ *
+ * @return static_cache* La cache con una referencia tomada, o NULL si hubo un error
+ */
+static static_cache *cargar_cache(void)
+{
+    static_cache *cache = (static_cache *)calloc(1, sizeof(static_cache));
+
+    if (cache == NULL)
+    {
+        fprintf(stderr, "Error al reservar memoria para la cache\n");
+        return NULL;
+    }
+
+    cache->referencias = 1;
+
+    if (cargar_directorio(cache, "") < 0)
+    {
+        liberar_cache(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+/**
+ * @brief Carga recursivamente un subdirectorio y lo agrega a inotify
+ *
+ * @param ruta_relativa "" para el directorio base, "/css" para un subdirectorio
+ */
+static int cargar_directorio(static_cache *cache, const char *ruta_relativa)
+{
+    char ruta_completa[2 * STATIC_CACHE_RUTA_SIZE];
+    char ruta_hijo[STATIC_CACHE_RUTA_SIZE];
+    struct dirent *entrada;
+    struct stat info;
+    DIR *dir;
+
+    snprintf(ruta_completa, sizeof(ruta_completa), "%s%s", directorio_base, ruta_relativa);
+
+    if ((dir = opendir(ruta_completa)) == NULL)
+    {
+        fprintf(stderr, "Error al abrir el directorio %s\n", ruta_completa);
+        return -1;
+    }
+
+    // Agregar un directorio ya vigilado no tiene efecto
+    if (inotify_add_watch(inotify_fd, ruta_completa, INOTIFY_EVENTOS) < 0)
+    {
+        fprintf(stderr, "Error en inotify_add_watch para %s\n", ruta_completa);
+    }
+
+    while ((entrada = readdir(dir)) != NULL)
+    {
+        // Se ignoran ".", ".." y los archivos ocultos o temporales de los editores
+        if (entrada->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        if (snprintf(ruta_hijo, sizeof(ruta_hijo), "%s/%s", ruta_relativa, entrada->d_name) >= (int)sizeof(ruta_hijo))
+        {
+            continue;
+        }
+
+        snprintf(ruta_completa, sizeof(ruta_completa), "%s%s", directorio_base, ruta_hijo);
+
+        if (stat(ruta_completa, &info) < 0)
+        {
+            continue;
+        }
+
+        if (S_ISDIR(info.st_mode))
+        {
+            if (cargar_directorio(cache, ruta_hijo) < 0)
+            {
+                closedir(dir);
+                return -1;
+            }
+            continue;
+        }
+
+        // Las variantes comprimidas se cargan junto a su original
+        if (!S_ISREG(info.st_mode) || es_variante(entrada->d_name))
+        {
+            continue;
+        }
+
+        if (cache->n_entradas >= STATIC_CACHE_MAX_ENTRADAS)
+        {
+            fprintf(stderr, "Cache llena, se ignora %s\n", ruta_completa);
+            continue;
+        }
+
+        strcpy(cache->entradas[cache->n_entradas].ruta, ruta_hijo);
+
+        if (cargar_archivo(&cache->entradas[cache->n_entradas], ruta_completa) == 0)
+        {
+            cache->n_entradas++;
+        }
+    }
+
+    closedir(dir);
+
+    return 0;
+}
+
+/**
+ * @brief Carga el archivo con sus variantes comprimidas y arma las cabeceras
+ */
+static int cargar_archivo(static_entrada *entrada, const char *ruta_completa)
+{
+    char ruta_variante[2 * STATIC_CACHE_RUTA_SIZE + 4];
+    struct stat original;
+    struct stat info;
+    static_variante *variante;
+
+    entrada->content_type = tipo_de_contenido(entrada->ruta);
+    entrada->codificaciones = 0;
+
+    for (int i = 0; i < STATIC_CODIFICACIONES; i++)
+    {
+        entrada->variantes[i].cuerpo = NULL;
+        entrada->variantes[i].fd = -1;
+    }
+
+    if (cargar_variante(&entrada->variantes[STATIC_IDENTIDAD], ruta_completa, entrada->content_type, &original) < 0)
+    {
+        return -1;
+    }
+
+    entrada->codificaciones = 1 << STATIC_IDENTIDAD;
+
+    for (int i = STATIC_GZIP; i < STATIC_CODIFICACIONES; i++)
+    {
+        snprintf(ruta_variante, sizeof(ruta_variante), "%s%s", ruta_completa, codificaciones[i].extension);
+
+        // Una variante más vieja que el original quedó de una versión anterior
+        if (stat(ruta_variante, &info) < 0 || info.st_mtime < original.st_mtime)
+        {
+            continue;
+        }
+
+        variante = &entrada->variantes[i];
+
+        if (cargar_variante(variante, ruta_variante, NULL, &info) < 0)
+        {
+            continue;
+        }
+
+        // Si no se gana nada no vale la pena negociar
+        if (variante->cuerpo_len >= entrada->variantes[STATIC_IDENTIDAD].cuerpo_len)
+        {
+            free(variante->cuerpo);
+            variante->cuerpo = NULL;
+            continue;
+        }
+
+        // Mismo hash con sufijo: cada representación necesita su propio ETag fuerte
+        snprintf(variante->etag, sizeof(variante->etag), "%.17s-%s\"",
+                 entrada->variantes[STATIC_IDENTIDAD].etag, codificaciones[i].extension + 1);
+
+        entrada->codificaciones |= 1 << i;
+    }
+
+    for (int i = 0; i < STATIC_CODIFICACIONES; i++)
+    {
+        if (entrada->codificaciones & (1 << i))
+        {
+            armar_cabeceras(entrada, i);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Lee el archivo completo, o lo deja abierto para sendfile, y calcula su ETag
+ *
+ * @param content_type Tipo del original o NULL para las variantes comprimidas, que siempre se leen
+ * @param info Se completa con los datos del archivo
+ */
+static int cargar_variante(static_variante *variante, const char *ruta_completa, const char *content_type, struct stat *info)
+{
+    int fd;
+
+    variante->cuerpo = NULL;
+    variante->fd = -1;
+
+    if ((fd = open(ruta_completa, O_RDONLY | O_CLOEXEC)) < 0 || fstat(fd, info) < 0)
+    {
+        fprintf(stderr, "Error al abrir el archivo %s\n", ruta_completa);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    variante->cuerpo_len = info->st_size;
+
+    if (content_type != NULL && variante->cuerpo_len >= STATIC_CACHE_SENDFILE_MIN && strncmp(content_type, "text/", 5) != 0)
+    {
+        // Binario grande: queda abierto y el hash se calcula leyendo por partes
+        variante->fd = fd;
+
+        if (hash_de_archivo(fd, variante->cuerpo_len, variante->etag) < 0)
+        {
+            fprintf(stderr, "Error al leer el archivo %s\n", ruta_completa);
+            close(fd);
+            variante->fd = -1;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    variante->cuerpo = (char *)malloc(variante->cuerpo_len > 0 ? variante->cuerpo_len : 1);
+
+    if (variante->cuerpo == NULL)
+    {
+        fprintf(stderr, "Error al reservar memoria para %s\n", ruta_completa);
+        close(fd);
+        return -1;
+    }
+
+    if (leer_completo(fd, variante->cuerpo, variante->cuerpo_len, 0) < 0)
+    {
+        // El archivo se achicó o hubo un error mientras se leía
+        fprintf(stderr, "Error al leer el archivo %s\n", ruta_completa);
+        free(variante->cuerpo);
+        variante->cuerpo = NULL;
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+
+    snprintf(variante->etag, sizeof(variante->etag), "\"%016llx\"",
+             (unsigned long long)fnv1a(FNV1A_INICIAL, variante->cuerpo, variante->cuerpo_len));
+
+    return 0;
+}
+
+/**
+ * @brief Arma las respuestas 200 y 304 de una variante
+ *
+ * Si el archivo tiene variantes comprimidas todas las respuestas llevan
+ * Vary, para que los caches intermedios no mezclen las representaciones.
+ */
+static void armar_cabeceras(static_entrada *entrada, static_codificacion codificacion)
+{
+    static_variante *variante = &entrada->variantes[codificacion];
+    const char *vary = (entrada->codificaciones != (1 << STATIC_IDENTIDAD)) ? "Vary: Accept-Encoding\r\n" : "";
+    char etag[STATIC_CACHE_ETAG_SIZE];
+
+    memcpy(etag, variante->etag, sizeof(etag));
+
+    for (int cerrar = 0; cerrar < 2; cerrar++)
+    {
+        variante->cabecera_len[cerrar] = snprintf(variante->cabecera[cerrar], STATIC_CACHE_CABECERA_SIZE,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Length: %zu\r\n"
+            "Content-Type: %s\r\n"
+            "%s"
+            "ETag: %s\r\n"
+            "Cache-Control: public, max-age=%d\r\n"
+            "%s"
+            "%s\r\n",
+            variante->cuerpo_len, entrada->content_type, codificaciones[codificacion].cabecera,
+            etag, STATIC_CACHE_MAX_AGE, vary,
+            cerrar ? CABECERA_CLOSE : CABECERA_KEEPALIVE);
+
+        variante->no_modificado_len[cerrar] = snprintf(variante->no_modificado[cerrar], STATIC_CACHE_CABECERA_SIZE,
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: public, max-age=%d\r\n"
+            "%s"
+            "%s\r\n",
+            etag, STATIC_CACHE_MAX_AGE, vary,
+            cerrar ? CABECERA_CLOSE : CABECERA_KEEPALIVE);
+    }
+}
+
+/**
+ * @brief Lee longitud bytes desde offset con pread
+ *
+ * @return int 0 si se leyó todo, -1 si hubo un error o el archivo es más corto
+ */
+static int leer_completo(int fd, char *destino, size_t longitud, off_t offset)
+{
+    size_t leido = 0;
+    ssize_t ret_val;
+
+    while (leido < longitud)
+    {
+        ret_val = pread(fd, destino + leido, longitud - leido, offset + leido);
+
+        if (ret_val < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ret_val <= 0)
+        {
+            return -1;
+        }
+
+        leido += ret_val;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Calcula el ETag de un archivo que no se carga en memoria
+ */
+static int hash_de_archivo(int fd, size_t longitud, char *etag)
+{
+    char bloque[HASH_BLOQUE_SIZE];
+    uint64_t hash = FNV1A_INICIAL;
+    size_t parte;
+
+    for (size_t offset = 0; offset < longitud; offset += parte)
+    {
+        parte = longitud - offset < sizeof(bloque) ? longitud - offset : sizeof(bloque);
+
+        if (leer_completo(fd, bloque, parte, offset) < 0)
+        {
+            return -1;
+        }
+
+        hash = fnv1a(hash, bloque, parte);
+    }
+
+    snprintf(etag, STATIC_CACHE_ETAG_SIZE, "\"%016llx\"", (unsigned long long)hash);
+
+    return 0;
+}
+
+static const char *tipo_de_contenido(const char *ruta)
+{
+    static const struct
+    {
+        const char *extension;
+        const char *tipo;
+    } tipos[] =
+    {
+        {".html", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"},
+        {".json", "application/json; charset=utf-8"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".svg", "image/svg+xml"},
+        {".ico", "image/x-icon"},
+    };
+    const char *extension = strrchr(ruta, '.');
+
+    if (extension != NULL)
+    {
+        for (size_t i = 0; i < sizeof(tipos) / sizeof(tipos[0]); i++)
+        {
+            if (strcmp(extension, tipos[i].extension) == 0)
+            {
+                return tipos[i].tipo;
+            }
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+/**
+ * @brief Hash FNV-1a de 64 bits, se usa como ETag del contenido
+ *
+ * @param hash FNV1A_INICIAL o el resultado del bloque anterior
+ */
+static uint64_t fnv1a(uint64_t hash, const char *datos, size_t longitud)
+{
+    for (size_t i = 0; i < longitud; i++)
+    {
+        hash ^= (unsigned char)datos[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Indica si el nombre corresponde a una variante comprimida (.gz o .br)
+ */
+static int es_variante(const char *nombre)
+{
+    size_t nombre_len = strlen(nombre);
+
+    for (int i = STATIC_GZIP; i < STATIC_CODIFICACIONES; i++)
+    {
+        size_t extension_len = strlen(codificaciones[i].extension);
+
+        if (nombre_len > extension_len && strcmp(nombre + nombre_len - extension_len, codificaciones[i].extension) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void liberar_cache(static_cache *cache)
+{
+    for (unsigned int i = 0; i < cache->n_entradas; i++)
+    {
+        for (int j = 0; j < STATIC_CODIFICACIONES; j++)
+        {
+            free(cache->entradas[i].variantes[j].cuerpo);
+
+            if (cache->entradas[i].variantes[j].fd >= 0)
+            {
+                close(cache->entradas[i].variantes[j].fd);
+            }
+        }
+    }
+
+    free(cache);
+}